@@ -11,6 +11,9 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "vast/batch.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/detail/byte_swap.hpp"
@@ -20,6 +23,265 @@
 
 namespace vast {
 
+namespace {
+
+// -- columnar encoding -------------------------------------------------------
+
+// A column stores the values of one node in the tree of a type, visiting the
+// nodes in pre-order. Columns of records only track whether the record
+// exists. Each column comes with a null bitmap and densely packed values.
+struct column {
+  std::vector<bool> present;
+  std::vector<data> values;
+  size_t next = 0; // The next value to hand out while reading.
+  bool selected = true;
+};
+
+// The representation of the values in an encoded column.
+enum class column_kind : uint8_t {
+  generic,
+  boolean,
+  integer,
+  count,
+  real,
+  timespan,
+  timestamp,
+  string
+};
+
+// Computes the number of columns that a type occupies.
+size_t width(const type& t) {
+  auto r = get_if<record_type>(t);
+  if (!r)
+    return 1;
+  auto result = size_t{1};
+  for (auto& f : r->fields)
+    result += width(f.type);
+  return result;
+}
+
+// Checks whether data has the record structure of a type.
+bool conforms(const type& t, const data& x) {
+  auto r = get_if<record_type>(t);
+  if (!r || is<none>(x))
+    return true;
+  auto v = get_if<vector>(x);
+  if (!v || v->size() != r->fields.size())
+    return false;
+  for (auto i = 0u; i < v->size(); ++i)
+    if (!conforms(r->fields[i].type, (*v)[i]))
+      return false;
+  return true;
+}
+
+// Appends a value to the columns of a type.
+// @pre `conforms(t, x)`
+void shred(const type& t, const data& x, column*& col) {
+  auto& c = *col++;
+  auto exists = !is<none>(x);
+  c.present.push_back(exists);
+  auto r = get_if<record_type>(t);
+  if (!r) {
+    if (exists)
+      c.values.push_back(x);
+    return;
+  }
+  auto v = get_if<vector>(x);
+  for (auto i = 0u; i < r->fields.size(); ++i)
+    shred(r->fields[i].type, v ? (*v)[i] : data{}, col);
+}
+
+// Marks the columns of a type that a projection selects.
+void project_columns(const type& event_type, const type& t,
+            const batch::reader::projection& project, offset& off,
+            column*& col) {
+  auto& c = *col++;
+  auto r = get_if<record_type>(t);
+  if (!r) {
+    c.selected = !project || project(event_type, off);
+    return;
+  }
+  off.push_back(0);
+  for (auto i = 0u; i < r->fields.size(); ++i) {
+    off.back() = i;
+    project_columns(event_type, r->fields[i].type, project, off, col);
+  }
+  off.pop_back();
+}
+
+// Reassembles the value of a type from its columns.
+data assemble(const type& t, column*& col, size_t row) {
+  auto& c = *col++;
+  auto r = get_if<record_type>(t);
+  if (!r) {
+    if (!c.selected || !c.present[row])
+      return {};
+    return std::move(c.values[c.next++]);
+  }
+  if (!c.present[row]) {
+    col += width(t) - 1;
+    return {};
+  }
+  vector result;
+  result.reserve(r->fields.size());
+  for (auto& f : r->fields)
+    result.push_back(assemble(f.type, col, row));
+  return result;
+}
+
+template <class T>
+bool all_are(const std::vector<data>& xs) {
+  return std::all_of(xs.begin(), xs.end(),
+                     [](auto& x) { return is<T>(x); });
+}
+
+template <class T>
+std::vector<T> unpack(const std::vector<data>& xs) {
+  std::vector<T> result;
+  result.reserve(xs.size());
+  for (auto& x : xs)
+    result.push_back(get<T>(x));
+  return result;
+}
+
+template <class T>
+void pack(std::vector<T>& xs, std::vector<data>& result) {
+  result.reserve(xs.size());
+  for (auto& x : xs)
+    result.emplace_back(std::move(x));
+}
+
+template <class Serializer, class T>
+void encode(Serializer& sink, column_kind kind, const column& c,
+            const std::vector<T>& xs) {
+  sink << static_cast<uint8_t>(kind) << c.present << xs;
+}
+
+// Serializes a column. Picks a typed representation if all values of the
+// column have the same type, since this saves the per-value type tag and
+// puts values of the same type next to each other for the compressor.
+void encode_column(std::vector<char>& buf, const column& c) {
+  caf::vectorbuf sb{buf};
+  caf::stream_serializer<caf::vectorbuf&> sink{sb};
+  auto& xs = c.values;
+  if (xs.empty()) {
+    encode(sink, column_kind::generic, c, std::vector<data>{});
+  } else if (all_are<boolean>(xs)) {
+    encode(sink, column_kind::boolean, c, unpack<boolean>(xs));
+  } else if (all_are<integer>(xs)) {
+    encode(sink, column_kind::integer, c, unpack<integer>(xs));
+  } else if (all_are<count>(xs)) {
+    encode(sink, column_kind::count, c, unpack<count>(xs));
+  } else if (all_are<real>(xs)) {
+    encode(sink, column_kind::real, c, unpack<real>(xs));
+  } else if (all_are<timespan>(xs)) {
+    encode(sink, column_kind::timespan, c, unpack<timespan>(xs));
+  } else if (all_are<timestamp>(xs)) {
+    encode(sink, column_kind::timestamp, c, unpack<timestamp>(xs));
+  } else if (all_are<std::string>(xs)) {
+    // Dictionary-encode strings, assigning codes in order of appearance.
+    std::unordered_map<std::string, uint32_t> codes;
+    std::vector<std::string> dictionary;
+    std::vector<uint32_t> ys;
+    ys.reserve(xs.size());
+    for (auto& x : xs) {
+      auto& str = get<std::string>(x);
+      auto i = codes.find(str);
+      if (i == codes.end()) {
+        i = codes.emplace(str, static_cast<uint32_t>(dictionary.size())).first;
+        dictionary.push_back(str);
+      }
+      ys.push_back(i->second);
+    }
+    sink << static_cast<uint8_t>(column_kind::string) << c.present
+         << dictionary << ys;
+  } else {
+    encode(sink, column_kind::generic, c, xs);
+  }
+}
+
+// Deserializes a column.
+void decode_column(const std::vector<char>& buf, column& c) {
+  caf::charbuf sb{const_cast<char*>(buf.data()), buf.size()};
+  caf::stream_deserializer<caf::charbuf&> source{sb};
+  uint8_t kind;
+  source >> kind >> c.present;
+  auto unpack = [&](auto ys) {
+    source >> ys;
+    pack(ys, c.values);
+  };
+  switch (static_cast<column_kind>(kind)) {
+    default:
+      throw std::runtime_error("invalid column kind");
+    case column_kind::generic:
+      source >> c.values;
+      break;
+    case column_kind::boolean: {
+      std::vector<bool> ys;
+      source >> ys;
+      c.values.reserve(ys.size());
+      for (auto y : ys)
+        c.values.emplace_back(boolean{y});
+      break;
+    }
+    case column_kind::integer:
+      unpack(std::vector<integer>{});
+      break;
+    case column_kind::count:
+      unpack(std::vector<count>{});
+      break;
+    case column_kind::real:
+      unpack(std::vector<real>{});
+      break;
+    case column_kind::timespan:
+      unpack(std::vector<timespan>{});
+      break;
+    case column_kind::timestamp:
+      unpack(std::vector<timestamp>{});
+      break;
+    case column_kind::string: {
+      std::vector<std::string> dictionary;
+      std::vector<uint32_t> codes;
+      source >> dictionary >> codes;
+      c.values.reserve(codes.size());
+      for (auto code : codes) {
+        if (code >= dictionary.size())
+          throw std::runtime_error("invalid dictionary code");
+        c.values.emplace_back(dictionary[code]);
+      }
+      break;
+    }
+  }
+}
+
+} // namespace <anonymous>
+
+// The events of a columnar batch, grouped by type.
+struct batch::writer::column_state {
+  struct block {
+    std::vector<timestamp> timestamps;
+    std::vector<column> columns;
+  };
+
+  std::vector<type> types;
+  std::vector<uint32_t> rows; // The type of each event.
+  std::vector<block> blocks;  // The events of each type.
+};
+
+struct batch::reader::column_state {
+  struct block {
+    std::vector<timestamp> timestamps;
+    std::vector<std::vector<char>> encoded;
+    std::vector<column> columns;
+    size_t row = 0;
+  };
+
+  std::vector<type> types;
+  std::vector<uint32_t> rows;
+  std::vector<block> blocks;
+  size_t position = 0;
+};
+
 bool batch::ids(event_id begin, event_id end) {
   if (end - begin != events())
     return false;
@@ -27,6 +289,9 @@ bool batch::ids(event_id begin, event_id end) {
   bm.append_bits(false, begin);
   bm.append_bits(true, end - begin);
   ids_ = std::move(bm);
+  first_id_ = begin == end ? invalid_event_id : begin;
+  last_id_ = begin == end ? invalid_event_id : end - 1;
+  id_directory_ = {};
   return true;
 }
 
@@ -34,6 +299,7 @@ bool batch::ids(bitmap bm) {
   if (rank(bm) != events())
     return false;
   ids_ = std::move(bm);
+  index_ids();
   return true;
 }
 
@@ -41,28 +307,87 @@ const bitmap& batch::ids() const {
   return ids_;
 }
 
+event_id batch::first_id() const {
+  return first_id_;
+}
+
+event_id batch::last_id() const {
+  return last_id_;
+}
+
 batch::size_type batch::events() const {
   return events_;
 }
 
+void batch::index_ids() {
+  id_directory_ = {};
+  auto ewah = get_if<ewah_bitmap>(ids_);
+  if (!ewah) {
+    first_id_ = select(ids_, 1);
+    last_id_ = select(ids_, -1);
+    return;
+  }
+  rank_select_directory directory{*ewah};
+  first_id_ = directory.select(*ewah, 1);
+  last_id_ = directory.select(*ewah, -1);
+  // The reader computes contiguous IDs without a directory.
+  if (first_id_ != invalid_event_id && last_id_ - first_id_ + 1 != events_)
+    id_directory_ = std::move(directory);
+}
+
 uint64_t bytes(const batch& b) {
   return sizeof(b.method_) + sizeof(b.first_) + sizeof(b.last_) +
     sizeof(b.events_) + sizeof(b.ids_) + sizeof(b.data_) + b.data_.size();
 }
 
-batch::writer::writer(compression method)
+batch::writer::writer(compression method, encoding layout)
   : vectorbuf_{batch_.data_},
     compressedbuf_{vectorbuf_, method},
     serializer_{compressedbuf_} {
   batch_.method_ = method;
+  batch_.encoding_ = layout;
+  if (layout == encoding::columnar)
+    columns_ = std::make_unique<column_state>();
+}
+
+batch::writer::~writer() {
+  // nop
 }
 
 bool batch::writer::write(const event& e) {
+  if (columns_ && !conforms(e.type(), e.data()))
+    return false;
   // Write meta data.
   if (e.timestamp() < batch_.first_)
     batch_.first_ = e.timestamp();
   if (e.timestamp() > batch_.last_)
     batch_.last_ = e.timestamp();
+  // Buffer columns until sealing the batch.
+  if (columns_) {
+    auto t = type_cache_.find(e.type());
+    if (t == type_cache_.end()) {
+      auto type_id = static_cast<uint32_t>(type_cache_.size());
+      t = type_cache_.emplace(e.type(), type_id).first;
+      columns_->types.push_back(e.type());
+      columns_->blocks.emplace_back();
+      columns_->blocks.back().columns.resize(width(e.type()));
+    }
+    columns_->rows.push_back(t->second);
+    auto& blk = columns_->blocks[t->second];
+    blk.timestamps.push_back(e.timestamp());
+    auto col = blk.columns.data();
+    shred(e.type(), e.data(), col);
+    ++batch_.events_;
+    return true;
+  }
+  // Start a new compressed block at each seek point. Since a reader may
+  // begin decoding at a seek point, we must repeat all type definitions.
+  if (batch_.events_ > 0 && batch_.events_ % seek_interval == 0) {
+    if (compressedbuf_.pubsync() < 0)
+      return false;
+    batch_.seek_points_.push_back({batch_.events_, batch_.data_.size()});
+    type_cache_.clear();
+  }
   // Write type.
   auto t = type_cache_.find(e.type());
   if (t == type_cache_.end()) {
@@ -78,23 +403,42 @@ bool batch::writer::write(const event& e) {
 }
 
 batch batch::writer::seal() {
+  if (columns_) {
+    serializer_ << columns_->types << columns_->rows;
+    for (auto& blk : columns_->blocks) {
+      std::vector<std::vector<char>> encoded(blk.columns.size());
+      for (auto i = 0u; i < blk.columns.size(); ++i)
+        encode_column(encoded[i], blk.columns[i]);
+      serializer_ << blk.timestamps << encoded;
+    }
+    *columns_ = {};
+    type_cache_.clear();
+  }
   auto n = compressedbuf_.pubsync();
   VAST_ASSERT(n >= 0);
   auto result = std::move(batch_);
   // Prepare for the next batch.
   batch_ = batch{};
   batch_.method_ = result.method_;
+  batch_.encoding_ = result.encoding_;
   vectorbuf_ = caf::vectorbuf{batch_.data_};
   return result;
 }
 
 batch::reader::reader(const batch& b)
-  : data_{b.data_},
+  : batch_{b},
+    data_{b.data_},
     id_range_{bit_range(b.ids_)},
     available_{b.events()},
     charbuf_{const_cast<char*>(data_.data()), data_.size()},
     compressedbuf_{charbuf_, b.method_},
     deserializer_{compressedbuf_} {
+  if (b.encoding_ == encoding::columnar)
+    columns_ = std::make_unique<column_state>();
+}
+
+batch::reader::~reader() {
+  // nop
 }
 
 expected<std::vector<event>> batch::reader::read() {
@@ -108,6 +452,12 @@ expected<std::vector<event>> batch::reader::read() {
   return result;
 }
 
+expected<std::vector<event>>
+batch::reader::read(const bitmap& ids, projection project) {
+  project_ = std::move(project);
+  return read(ids);
+}
+
 expected<std::vector<event>> batch::reader::read(const bitmap& ids) {
   using word = typename bitmap::word_type;
   auto result = std::vector<event>{};
@@ -140,6 +490,7 @@ expected<std::vector<event>> batch::reader::read(const bitmap& ids) {
       }
     }
     while (id != word::npos) {
+      seek(id);
       // Materialize events until have the one we want.
       do {
         e = materialize();
@@ -169,7 +520,15 @@ expected<std::vector<event>> batch::reader::read(const bitmap& ids) {
 expected<event> batch::reader::materialize() {
   if (available_ == 0)
     return make_error(ec::end_of_input);
+  auto position = batch_.events_ - available_;
   --available_;
+  if (columns_)
+    return materialize_columns();
+  // The writer repeats all type definitions after each seek point, so we
+  // must forget ours when reading past one.
+  if (!batch_.seek_points_.empty() && position > 0
+      && position % seek_interval == 0)
+    type_cache_.clear();
   try {
     // Read type.
     uint32_t type_id;
@@ -197,4 +556,83 @@ expected<event> batch::reader::materialize() {
   }
 }
 
+void batch::reader::seek(event_id id) {
+  auto& points = batch_.seek_points_;
+  if (points.empty() || columns_ || id_range_.done() || id <= id_range_.get())
+    return;
+  // Find the last seek point with an event ID not exceeding the given one.
+  // Contiguous IDs let us compute the ID of an event, and the directory
+  // locates other IDs without a scan of the entire bitmap.
+  auto contiguous = batch_.first_id_ != invalid_event_id
+    && batch_.last_id_ - batch_.first_id_ + 1 == batch_.events_;
+  auto ewah = get_if<ewah_bitmap>(batch_.ids_);
+  auto id_of = [&](auto& x) {
+    if (contiguous)
+      return batch_.first_id_ + x.event;
+    if (ewah)
+      return batch_.id_directory_.select(*ewah, x.event + 1);
+    return select(batch_.ids_, x.event + 1);
+  };
+  auto i = std::upper_bound(points.begin(), points.end(), id,
+                            [&](auto x, auto& y) { return x < id_of(y); });
+  if (i == points.begin())
+    return;
+  --i;
+  // Only jump forward.
+  auto position = batch_.events_ - available_;
+  if (i->event <= position)
+    return;
+  auto pos = compressedbuf_.pubseekpos(i->offset, std::ios_base::in);
+  if (pos == std::streampos(std::streamoff(-1)))
+    return;
+  type_cache_.clear();
+  id_range_.skip(id_of(*i) - id_range_.get());
+  available_ = batch_.events_ - i->event;
+}
+
+expected<event> batch::reader::materialize_columns() {
+  auto& st = *columns_;
+  try {
+    // Read the column directory upon first access.
+    if (st.position == 0) {
+      deserializer_ >> st.types >> st.rows;
+      st.blocks.resize(st.types.size());
+      for (auto& blk : st.blocks)
+        deserializer_ >> blk.timestamps >> blk.encoded;
+    }
+    if (st.position >= st.rows.size())
+      return make_error(ec::format_error, "truncated columnar batch");
+    auto type_id = st.rows[st.position++];
+    if (type_id >= st.blocks.size())
+      return make_error(ec::format_error, "invalid type in columnar batch");
+    auto& t = st.types[type_id];
+    auto& blk = st.blocks[type_id];
+    // Decode the selected columns of a type upon first access.
+    if (blk.row == 0) {
+      blk.columns.resize(width(t));
+      if (blk.encoded.size() != blk.columns.size())
+        return make_error(ec::format_error, "column mismatch");
+      auto col = blk.columns.data();
+      offset off;
+      project_columns(t, t, project_, off, col);
+      for (auto i = 0u; i < blk.columns.size(); ++i)
+        if (blk.columns[i].selected)
+          decode_column(blk.encoded[i], blk.columns[i]);
+      blk.encoded.clear();
+    }
+    auto row = blk.row++;
+    auto col = blk.columns.data();
+    event e{{assemble(t, col, row), t}};
+    // Assign an event ID.
+    if (!id_range_.done()) {
+      e.id(id_range_.get());
+      id_range_.next();
+    }
+    e.timestamp(blk.timestamps[row]);
+    return e;
+  } catch (const std::runtime_error& e) {
+    return make_error(ec::unspecified, e.what());
+  }
+}
+
 } // namespace vast
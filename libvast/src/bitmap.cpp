@@ -30,6 +30,14 @@ bitmap::size_type bitmap::size() const {
   return visit([](auto& bm) { return bm.size(); }, bitmap_);
 }
 
+size_t bitmap::memusage() const {
+  return visit([](auto& bm) { return bm.memusage(); }, bitmap_);
+}
+
+bool bitmap::operator[](size_type i) const {
+  return visit([=](auto& bm) { return bm[i]; }, bitmap_);
+}
+
 void bitmap::append_bit(bool bit) {
   visit([=](auto& bm) { bm.append_bit(bit); }, bitmap_);
 }
@@ -76,4 +84,54 @@ bitmap_bit_range bit_range(const bitmap& bm) {
   return bitmap_bit_range{bm};
 }
 
+namespace {
+
+template <bool FillLHS, bool FillRHS, class Operation, class Specialized>
+bitmap eval(const bitmap& lhs, const bitmap& rhs, Operation op,
+            Specialized f) {
+  if (auto x = get_if<ewah_bitmap>(lhs))
+    if (auto y = get_if<ewah_bitmap>(rhs))
+      return f(*x, *y);
+  if (auto x = get_if<roaring_bitmap>(lhs))
+    if (auto y = get_if<roaring_bitmap>(rhs))
+      return f(*x, *y);
+  return binary_eval<FillLHS, FillRHS>(lhs, rhs, op);
+}
+
+} // namespace <anonymous>
+
+bitmap binary_and(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto& x, auto& y) { return binary_and(x, y); };
+  return eval<false, false>(lhs, rhs, detail::and_op{}, f);
+}
+
+bitmap binary_or(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto& x, auto& y) { return binary_or(x, y); };
+  return eval<true, true>(lhs, rhs, detail::or_op{}, f);
+}
+
+bitmap binary_xor(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto& x, auto& y) { return binary_xor(x, y); };
+  return eval<true, true>(lhs, rhs, detail::xor_op{}, f);
+}
+
+bitmap binary_nand(const bitmap& lhs, const bitmap& rhs) {
+  auto f = [](auto& x, auto& y) { return binary_nand(x, y); };
+  return eval<true, false>(lhs, rhs, detail::nand_op{}, f);
+}
+
+bitmap nary_or(const std::vector<bitmap>& xs) {
+  if (xs.empty())
+    return {};
+  std::vector<const ewah_bitmap*> ewahs;
+  ewahs.reserve(xs.size());
+  for (auto& x : xs) {
+    auto ptr = get_if<ewah_bitmap>(x);
+    if (!ptr || ptr->size() != xs.front().size())
+      return nary_or(xs.begin(), xs.end());
+    ewahs.push_back(ptr);
+  }
+  return nary_or(ewahs);
+}
+
 } // namespace vast
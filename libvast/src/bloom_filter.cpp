@@ -0,0 +1,69 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/bloom_filter.hpp"
+#include "vast/detail/assert.hpp"
+
+namespace vast {
+
+bloom_filter::bloom_filter(size_type num_bits, size_type num_hashes)
+  : num_hashes_{num_hashes},
+    bits_(num_bits, false) {
+  VAST_ASSERT(num_bits > 0);
+  VAST_ASSERT(num_hashes > 0);
+}
+
+void bloom_filter::add(digest_type x) {
+  VAST_ASSERT(!empty());
+  for (auto i = size_type{0}; i < num_hashes_; ++i)
+    bits_[position(x, i)] = true;
+}
+
+bool bloom_filter::lookup(digest_type x) const {
+  if (empty())
+    return false;
+  for (auto i = size_type{0}; i < num_hashes_; ++i)
+    if (!bits_[position(x, i)])
+      return false;
+  return true;
+}
+
+bloom_filter::size_type bloom_filter::size() const {
+  return bits_.size();
+}
+
+bloom_filter::size_type bloom_filter::num_hashes() const {
+  return num_hashes_;
+}
+
+bool bloom_filter::empty() const {
+  return bits_.empty();
+}
+
+size_t bloom_filter::memusage() const {
+  return sizeof(*this) + bits_.capacity() / 8;
+}
+
+bool operator==(const bloom_filter& x, const bloom_filter& y) {
+  return x.num_hashes_ == y.num_hashes_ && x.bits_ == y.bits_;
+}
+
+bloom_filter::size_type bloom_filter::position(digest_type x,
+                                               size_type i) const {
+  auto h1 = x & 0xffffffff;
+  auto h2 = x >> 32;
+  return (h1 + i * h2) % bits_.size();
+}
+
+} // namespace vast
@@ -0,0 +1,52 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/detail/block_arena.hpp"
+
+#include "vast/detail/assert.hpp"
+
+namespace vast::detail {
+
+block_arena::block_arena(chunk_ptr chk, const block_type* blocks, size_t size)
+  : chunk_{std::move(chk)},
+    blocks_{blocks},
+    size_{size} {
+  VAST_ASSERT(reinterpret_cast<uintptr_t>(blocks) % alignof(block_type) == 0);
+}
+
+uint64_t block_arena::append(block_view xs) {
+  VAST_ASSERT(!chunk_); // Readable arenas are immutable.
+  auto offset = buffer_.size();
+  buffer_.insert(buffer_.end(), xs.begin(), xs.end());
+  return offset;
+}
+
+const block_arena::block_type*
+block_arena::get(uint64_t offset, uint64_t size) const {
+  if (offset > size_ || size > size_ - offset)
+    return nullptr;
+  return blocks_ + offset;
+}
+
+const chunk_ptr& block_arena::chunk() const {
+  return chunk_;
+}
+
+block_view block_arena::blocks() const {
+  if (chunk_)
+    return {blocks_, size_};
+  return {buffer_.data(), buffer_.size()};
+}
+
+} // namespace vast::detail
@@ -0,0 +1,254 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/detail/block_kernels.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define VAST_BLOCK_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace vast::detail {
+
+namespace {
+
+using binary_kernel = void (*)(const uint64_t*, const uint64_t*, uint64_t*,
+                               size_t);
+using unary_kernel = void (*)(const uint64_t*, uint64_t*, size_t);
+using count_kernel = uint64_t (*)(const uint64_t*, size_t);
+
+struct kernels {
+  binary_kernel and_;
+  binary_kernel or_;
+  binary_kernel xor_;
+  binary_kernel nand_;
+  unary_kernel not_;
+  count_kernel popcount;
+  const char* isa;
+};
+
+// -- scalar -----------------------------------------------------------------
+
+template <class Operation>
+void scalar_binary(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                   size_t n, Operation op) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = op(x[i], y[i]);
+}
+
+void scalar_and(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                size_t n) {
+  scalar_binary(x, y, out, n, [](auto a, auto b) { return a & b; });
+}
+
+void scalar_or(const uint64_t* x, const uint64_t* y, uint64_t* out,
+               size_t n) {
+  scalar_binary(x, y, out, n, [](auto a, auto b) { return a | b; });
+}
+
+void scalar_xor(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                size_t n) {
+  scalar_binary(x, y, out, n, [](auto a, auto b) { return a ^ b; });
+}
+
+void scalar_nand(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                 size_t n) {
+  scalar_binary(x, y, out, n, [](auto a, auto b) { return a & ~b; });
+}
+
+void scalar_not(const uint64_t* x, uint64_t* out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = ~x[i];
+}
+
+uint64_t scalar_popcount(const uint64_t* xs, size_t n) {
+  uint64_t result = 0;
+  for (size_t i = 0; i < n; ++i)
+    result += __builtin_popcountll(xs[i]);
+  return result;
+}
+
+#ifdef VAST_BLOCK_KERNELS_X86
+
+// -- SSE4.2 -----------------------------------------------------------------
+
+// Processes the remainder of a sequence that doesn't fill a vector register.
+
+inline uint64_t and_tail(uint64_t a, uint64_t b) {
+  return a & b;
+}
+
+inline uint64_t or_tail(uint64_t a, uint64_t b) {
+  return a | b;
+}
+
+inline uint64_t xor_tail(uint64_t a, uint64_t b) {
+  return a ^ b;
+}
+
+inline uint64_t nand_tail(uint64_t a, uint64_t b) {
+  return a & ~b;
+}
+
+#define VAST_SSE_BINARY(name, expr, tail)                                      \
+  __attribute__((target("sse4.2")))                                           \
+  void name(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n) {  \
+    size_t i = 0;                                                              \
+    for (; i + 2 <= n; i += 2) {                                               \
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));       \
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));       \
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), expr);             \
+    }                                                                          \
+    for (; i < n; ++i)                                                         \
+      out[i] = tail(x[i], y[i]);                                               \
+  }
+
+VAST_SSE_BINARY(sse_and, _mm_and_si128(a, b), and_tail)
+VAST_SSE_BINARY(sse_or, _mm_or_si128(a, b), or_tail)
+VAST_SSE_BINARY(sse_xor, _mm_xor_si128(a, b), xor_tail)
+VAST_SSE_BINARY(sse_nand, _mm_andnot_si128(b, a), nand_tail)
+
+#undef VAST_SSE_BINARY
+
+__attribute__((target("sse4.2,popcnt")))
+uint64_t sse_popcount(const uint64_t* xs, size_t n) {
+  // Four independent accumulators keep the popcnt units busy.
+  uint64_t r0 = 0, r1 = 0, r2 = 0, r3 = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    r0 += _mm_popcnt_u64(xs[i]);
+    r1 += _mm_popcnt_u64(xs[i + 1]);
+    r2 += _mm_popcnt_u64(xs[i + 2]);
+    r3 += _mm_popcnt_u64(xs[i + 3]);
+  }
+  for (; i < n; ++i)
+    r0 += _mm_popcnt_u64(xs[i]);
+  return r0 + r1 + r2 + r3;
+}
+
+// -- AVX2 -------------------------------------------------------------------
+
+#define VAST_AVX2_BINARY(name, expr, tail)                                     \
+  __attribute__((target("avx2")))                                             \
+  void name(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n) {  \
+    size_t i = 0;                                                              \
+    for (; i + 4 <= n; i += 4) {                                               \
+      auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));    \
+      auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i));    \
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), expr);          \
+    }                                                                          \
+    for (; i < n; ++i)                                                         \
+      out[i] = tail(x[i], y[i]);                                               \
+  }
+
+VAST_AVX2_BINARY(avx2_and, _mm256_and_si256(a, b), and_tail)
+VAST_AVX2_BINARY(avx2_or, _mm256_or_si256(a, b), or_tail)
+VAST_AVX2_BINARY(avx2_xor, _mm256_xor_si256(a, b), xor_tail)
+VAST_AVX2_BINARY(avx2_nand, _mm256_andnot_si256(b, a), nand_tail)
+
+#undef VAST_AVX2_BINARY
+
+__attribute__((target("avx2")))
+void avx2_not(const uint64_t* x, uint64_t* out, size_t n) {
+  auto ones = _mm256_set1_epi64x(-1);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_xor_si256(a, ones));
+  }
+  for (; i < n; ++i)
+    out[i] = ~x[i];
+}
+
+// Counts bits per nibble with a shuffle-based lookup table and sums the
+// bytes of each 64-bit lane with SAD (Mula, Kurz, and Lemire, 2016).
+__attribute__((target("avx2,popcnt")))
+uint64_t avx2_popcount(const uint64_t* xs, size_t n) {
+  auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  auto low = _mm256_set1_epi8(0x0f);
+  auto zero = _mm256_setzero_si256();
+  auto acc = zero;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+    auto lo = _mm256_and_si256(v, low);
+    auto hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+    auto counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo),
+                                  _mm256_shuffle_epi8(table, hi));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, zero));
+  }
+  uint64_t result = static_cast<uint64_t>(_mm256_extract_epi64(acc, 0))
+                    + static_cast<uint64_t>(_mm256_extract_epi64(acc, 1))
+                    + static_cast<uint64_t>(_mm256_extract_epi64(acc, 2))
+                    + static_cast<uint64_t>(_mm256_extract_epi64(acc, 3));
+  for (; i < n; ++i)
+    result += _mm_popcnt_u64(xs[i]);
+  return result;
+}
+
+#endif // VAST_BLOCK_KERNELS_X86
+
+const kernels& select_kernels() {
+  static const kernels instance = [] {
+#ifdef VAST_BLOCK_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+      return kernels{avx2_and, avx2_or, avx2_xor, avx2_nand, avx2_not,
+                     avx2_popcount, "avx2"};
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+      return kernels{sse_and, sse_or, sse_xor, sse_nand, scalar_not,
+                     sse_popcount, "sse4.2"};
+#endif
+    return kernels{scalar_and, scalar_or, scalar_xor, scalar_nand, scalar_not,
+                   scalar_popcount, "scalar"};
+  }();
+  return instance;
+}
+
+} // namespace <anonymous>
+
+void and_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                size_t n) {
+  select_kernels().and_(x, y, out, n);
+}
+
+void or_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n) {
+  select_kernels().or_(x, y, out, n);
+}
+
+void xor_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                size_t n) {
+  select_kernels().xor_(x, y, out, n);
+}
+
+void nand_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                 size_t n) {
+  select_kernels().nand_(x, y, out, n);
+}
+
+void not_blocks(const uint64_t* x, uint64_t* out, size_t n) {
+  select_kernels().not_(x, out, n);
+}
+
+uint64_t popcount_blocks(const uint64_t* xs, size_t n) {
+  return select_kernels().popcount(xs, n);
+}
+
+const char* block_kernels_isa() {
+  return select_kernels().isa;
+}
+
+} // namespace vast::detail
@@ -32,6 +32,16 @@ compressedbuf::compressedbuf(std::streambuf& sb, compression method,
   setp(uncompressed_.data(), uncompressed_.data() + uncompressed_.size());
 }
 
+compressedbuf::pos_type
+compressedbuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+  if (which != std::ios_base::in)
+    return pos_type(off_type(-1));
+  auto result = streambuf_.pubseekpos(pos, which);
+  if (result != pos_type(off_type(-1)))
+    setg(nullptr, nullptr, nullptr);
+  return result;
+}
+
 int compressedbuf::sync() {
   if (pbase() == nullptr)
     return -1;
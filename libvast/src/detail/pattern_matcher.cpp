@@ -0,0 +1,390 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+
+#include "vast/detail/pattern_matcher.hpp"
+
+namespace vast::detail {
+
+namespace {
+
+// The wildcard tokens of a simple expression. All other tokens are
+// characters, i.e., non-negative.
+enum token : int {
+  any = -1,  // `.`: any character but a newline
+  star = -2, // `.*`: a sequence of characters without a newline
+  gap = -3,  // An arbitrary sequence of characters.
+};
+
+bool is_gap(int x) {
+  return x == star || x == gap;
+}
+
+// Tokenizes a simple expression. Returns false if the expression requires
+// the regex engine.
+bool tokenize(const std::string& rx, std::vector<int>& tokens,
+              bool& anchor_begin, bool& anchor_end) {
+  auto first = size_t{0};
+  auto last = rx.size();
+  if (first < last && rx[first] == '^') {
+    anchor_begin = true;
+    ++first;
+  }
+  if (last > first && rx[last - 1] == '$') {
+    // Only an unescaped dollar sign is an anchor.
+    auto escapes = size_t{0};
+    for (auto i = last - 1; i > first && rx[i - 1] == '\\'; --i)
+      ++escapes;
+    if (escapes % 2 == 0) {
+      anchor_end = true;
+      --last;
+    }
+  }
+  for (auto i = first; i < last; ++i) {
+    auto c = rx[i];
+    switch (c) {
+      default:
+        tokens.push_back(static_cast<unsigned char>(c));
+        break;
+      case '\\':
+        // Escaped letters and digits denote character classes, control
+        // characters, or back references.
+        if (i + 1 == last || std::isalnum(static_cast<unsigned char>(rx[i + 1])))
+          return false;
+        tokens.push_back(static_cast<unsigned char>(rx[++i]));
+        break;
+      case '.':
+        if (i + 1 < last && rx[i + 1] == '*') {
+          tokens.push_back(star);
+          ++i;
+        } else {
+          tokens.push_back(any);
+        }
+        break;
+      case '[':
+      case ']':
+      case '(':
+      case ')':
+      case '{':
+      case '}':
+      case '|':
+      case '+':
+      case '?':
+      case '*':
+      case '^':
+      case '$':
+        return false;
+    }
+  }
+  return true;
+}
+
+// Advances past a group or character class that begins at position i and
+// returns the position of its closing delimiter, or the end of the string.
+size_t skip_nested(const std::string& rx, size_t i) {
+  auto depth = 0;
+  auto in_class = false;
+  for (; i < rx.size(); ++i) {
+    auto c = rx[i];
+    if (c == '\\')
+      ++i;
+    else if (in_class)
+      in_class = c != ']';
+    else if (c == '[')
+      in_class = true;
+    else if (c == '(')
+      ++depth;
+    else if (c == ')' && --depth == 0)
+      return i;
+    if (depth == 0 && !in_class)
+      return i;
+  }
+  return rx.size();
+}
+
+// Collects the literal runs of an arbitrary expression at the top level.
+void derive_regex_constraints(const std::string& rx, bool full,
+                              pattern_constraints& result) {
+  // A top-level alternative could bypass any literal.
+  for (auto i = size_t{0}; i < rx.size(); ++i) {
+    if (rx[i] == '\\')
+      ++i;
+    else if (rx[i] == '[' || rx[i] == '(')
+      i = skip_nested(rx, i);
+    else if (rx[i] == '|')
+      return;
+  }
+  std::string run;
+  auto anchored = full;
+  auto i = size_t{0};
+  if (i < rx.size() && rx[i] == '^') {
+    anchored = true;
+    ++i;
+  }
+  auto flush = [&] {
+    if (!run.empty()) {
+      if (anchored && result.prefix.empty())
+        result.prefix = run;
+      else
+        result.substrings.push_back(run);
+      run.clear();
+    }
+    anchored = false;
+  };
+  while (i < rx.size()) {
+    // Determine the next atom.
+    std::optional<char> atom;
+    auto c = rx[i];
+    switch (c) {
+      default:
+        atom = c;
+        ++i;
+        break;
+      case '\\': {
+        if (i + 1 == rx.size()) {
+          ++i;
+          break;
+        }
+        auto e = rx[i + 1];
+        i += 2;
+        if (!std::isalnum(static_cast<unsigned char>(e)))
+          atom = e;
+        else if (e == 'x')
+          i += 2;
+        else if (e == 'u')
+          i += 4;
+        else if (e == 'c')
+          i += 1;
+        else
+          while (std::isdigit(static_cast<unsigned char>(e)) && i < rx.size()
+                 && std::isdigit(static_cast<unsigned char>(rx[i])))
+            ++i;
+        break;
+      }
+      case '[':
+      case '(':
+        i = skip_nested(rx, i) + 1;
+        break;
+      case '.':
+      case '^':
+      case '$':
+      case ')':
+      case ']':
+      case '}':
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        ++i;
+        break;
+    }
+    // Determine whether the atom must occur at least once and whether a
+    // quantifier ends the run after it.
+    auto required = true;
+    auto repeated = false;
+    if (i < rx.size()) {
+      switch (rx[i]) {
+        case '*':
+        case '?':
+          required = false;
+          ++i;
+          break;
+        case '+':
+          repeated = true;
+          ++i;
+          break;
+        case '{': {
+          auto j = i + 1;
+          while (j < rx.size()
+                 && std::isdigit(static_cast<unsigned char>(rx[j])))
+            ++j;
+          auto min = rx.substr(i + 1, j - i - 1);
+          required = min.find_first_not_of('0') != std::string::npos;
+          repeated = true;
+          i = std::min(rx.find('}', i), rx.size() - 1) + 1;
+          break;
+        }
+      }
+      // Skip the marker of a lazy quantifier.
+      if ((!required || repeated) && i < rx.size() && rx[i] == '?')
+        ++i;
+    }
+    if (atom && required)
+      run.push_back(*atom);
+    if (!atom || !required || repeated)
+      flush();
+  }
+  flush();
+}
+
+} // namespace <anonymous>
+
+pattern_constraints derive_constraints(const std::string& rx, bool full) {
+  pattern_constraints result;
+  std::vector<int> tokens;
+  auto anchor_begin = full;
+  auto anchor_end = full;
+  if (!tokenize(rx, tokens, anchor_begin, anchor_end)) {
+    derive_regex_constraints(rx, full, result);
+    return result;
+  }
+  std::string run;
+  auto anchored = anchor_begin;
+  for (auto x : tokens) {
+    if (x >= 0) {
+      run.push_back(static_cast<char>(x));
+      continue;
+    }
+    if (!run.empty()) {
+      if (anchored)
+        result.prefix = std::move(run);
+      else
+        result.substrings.push_back(std::move(run));
+      run.clear();
+    }
+    anchored = false;
+  }
+  if (anchored && anchor_end)
+    result.literal = run;
+  if (anchored)
+    result.prefix = std::move(run);
+  else if (!run.empty())
+    result.substrings.push_back(std::move(run));
+  return result;
+}
+
+pattern_matcher::pattern_matcher(const std::string& rx) {
+  std::vector<int> tokens;
+  auto anchor_begin = false;
+  auto anchor_end = false;
+  simple_ = tokenize(rx, tokens, anchor_begin, anchor_end);
+  if (simple_) {
+    restricted_ = std::any_of(tokens.begin(), tokens.end(),
+                              [](int x) { return x < 0; });
+    match_ = make_program(tokens);
+    if (!anchor_begin)
+      tokens.insert(tokens.begin(), gap);
+    if (!anchor_end)
+      tokens.push_back(gap);
+    search_ = make_program(std::move(tokens));
+  }
+  // Wildcards match neither '\n' nor '\r', which the fast path does not
+  // model. We keep the regex engine around for strings that contain either.
+  if (!simple_ || restricted_)
+    regex_ = std::regex{rx, std::regex::ECMAScript | std::regex::optimize};
+}
+
+bool pattern_matcher::match(std::string_view str) const {
+  if (bypass(str))
+    return eval(match_, str);
+  return std::regex_match(str.begin(), str.end(), regex_);
+}
+
+bool pattern_matcher::search(std::string_view str) const {
+  if (bypass(str))
+    return eval(search_, str);
+  return std::regex_search(str.begin(), str.end(), regex_);
+}
+
+bool pattern_matcher::simple() const {
+  return simple_;
+}
+
+pattern_matcher::program
+pattern_matcher::make_program(std::vector<int> tokens) {
+  program result;
+  auto literal = [](auto first, auto last) {
+    std::string str;
+    for (auto i = first; i != last; ++i) {
+      if (*i < 0)
+        return std::optional<std::string>{};
+      str.push_back(static_cast<char>(*i));
+    }
+    return std::optional<std::string>{std::move(str)};
+  };
+  auto n = tokens.size();
+  auto leading = n > 0 && is_gap(tokens.front());
+  auto trailing = n > 1 && is_gap(tokens.back());
+  auto first = tokens.begin() + (leading ? 1 : 0);
+  auto last = tokens.end() - (trailing ? 1 : 0);
+  if (auto str = literal(first, last)) {
+    result.literal = std::move(*str);
+    if (leading && trailing)
+      result.op = program::substring;
+    else if (leading)
+      result.op = program::suffix;
+    else if (trailing)
+      result.op = program::prefix;
+    else
+      result.op = program::exact;
+  } else {
+    result.op = program::wildcard;
+  }
+  result.tokens = std::move(tokens);
+  return result;
+}
+
+bool pattern_matcher::eval(const program& p, std::string_view str) {
+  auto& lit = p.literal;
+  switch (p.op) {
+    case program::exact:
+      return str == lit;
+    case program::prefix:
+      return str.size() >= lit.size() && str.compare(0, lit.size(), lit) == 0;
+    case program::suffix:
+      return str.size() >= lit.size()
+             && str.compare(str.size() - lit.size(), lit.size(), lit) == 0;
+    case program::substring:
+      return str.find(lit) != std::string_view::npos;
+    case program::wildcard:
+      break;
+  }
+  // Greedy wildcard matching: advance as long as characters match and, upon
+  // a mismatch, let the most recent gap absorb one more character.
+  auto& xs = p.tokens;
+  auto i = size_t{0};
+  auto j = size_t{0};
+  auto gap_token = xs.size();
+  auto gap_begin = size_t{0};
+  while (i < str.size()) {
+    if (j < xs.size() && is_gap(xs[j])) {
+      gap_token = j++;
+      gap_begin = i;
+    } else if (j < xs.size()
+               && (xs[j] == any
+                   || xs[j] == static_cast<unsigned char>(str[i]))) {
+      ++i;
+      ++j;
+    } else if (gap_token < xs.size()) {
+      j = gap_token + 1;
+      i = ++gap_begin;
+    } else {
+      return false;
+    }
+  }
+  while (j < xs.size() && is_gap(xs[j]))
+    ++j;
+  return j == xs.size();
+}
+
+bool pattern_matcher::bypass(std::string_view str) const {
+  if (!simple_)
+    return false;
+  return !restricted_ || str.find_first_of("\r\n") == std::string_view::npos;
+}
+
+} // namespace vast::detail
@@ -246,5 +246,13 @@ bool seek(int fd, size_t bytes) {
   return ::lseek(fd, bytes, SEEK_CUR) != -1;
 }
 
+bool fsync(int fd) {
+  int result;
+  do {
+    result = ::fsync(fd);
+  } while (result < 0 && errno == EINTR);
+  return result == 0;
+}
+
 } // namespace detail
 } // namespace vast
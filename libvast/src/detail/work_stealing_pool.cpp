@@ -0,0 +1,162 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+
+#include "vast/detail/assert.hpp"
+#include "vast/detail/work_stealing_pool.hpp"
+
+namespace vast::detail {
+
+namespace {
+
+// The pool and queue index of the current thread, if it is a worker.
+thread_local work_stealing_pool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace <anonymous>
+
+work_stealing_pool::strand::strand(work_stealing_pool& pool) : pool_{pool} {
+  // nop
+}
+
+void work_stealing_pool::strand::submit(task f) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  tasks_.push_back(std::move(f));
+  if (running_)
+    return;
+  running_ = true;
+  lock.unlock();
+  pool_.submit([self = shared_from_this()] { self->run(); });
+}
+
+void work_stealing_pool::strand::run() {
+  for (;;) {
+    task f;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (tasks_.empty()) {
+        running_ = false;
+        return;
+      }
+      f = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    f();
+  }
+}
+
+work_stealing_pool::work_stealing_pool(size_t workers) {
+  if (workers == 0)
+    workers = std::max(std::thread::hardware_concurrency(), 1u);
+  for (auto i = 0u; i < workers; ++i)
+    queues_.push_back(std::make_unique<task_queue>());
+  for (auto i = 0u; i < workers; ++i)
+    threads_.emplace_back([=] { work(i); });
+}
+
+work_stealing_pool::~work_stealing_pool() {
+  VAST_ASSERT(current_pool != this);
+  done_ = true;
+  for (auto& q : queues_) {
+    // Locking ensures that a worker either sees the flag before it goes to
+    // sleep or receives the notification.
+    std::lock_guard<std::mutex> lock{q->mutex};
+    q->cv.notify_one();
+  }
+  for (auto& t : threads_)
+    t.join();
+}
+
+void work_stealing_pool::submit(task f) {
+  auto i = current_pool == this ? current_worker
+                                : next_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock{queues_[i]->mutex};
+    queues_[i]->tasks.push_back(std::move(f));
+  }
+  // Counting only after the task became visible means that a worker never
+  // waits for a counted task to show up.
+  ++pending_;
+  wake(i);
+}
+
+std::shared_ptr<work_stealing_pool::strand> work_stealing_pool::make_strand() {
+  return std::make_shared<strand>(*this);
+}
+
+size_t work_stealing_pool::workers() const {
+  return threads_.size();
+}
+
+bool work_stealing_pool::try_pop(size_t worker, task& f) {
+  // Work LIFO on the own queue to benefit from warm caches...
+  {
+    auto& q = *queues_[worker];
+    std::lock_guard<std::mutex> lock{q.mutex};
+    if (!q.tasks.empty()) {
+      f = std::move(q.tasks.back());
+      q.tasks.pop_back();
+      return true;
+    }
+  }
+  // ...and steal the oldest tasks from the others.
+  for (auto i = 1u; i < queues_.size(); ++i) {
+    auto& q = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock{q.mutex};
+    if (!q.tasks.empty()) {
+      f = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void work_stealing_pool::wake(size_t worker) {
+  for (auto i = 0u; i < queues_.size(); ++i) {
+    auto& q = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock{q.mutex};
+    if (q.sleeping) {
+      q.sleeping = false;
+      q.cv.notify_one();
+      return;
+    }
+  }
+  // All workers are busy and look for tasks before going to sleep.
+}
+
+void work_stealing_pool::work(size_t worker) {
+  current_pool = this;
+  current_worker = worker;
+  auto& q = *queues_[worker];
+  for (;;) {
+    task f;
+    if (try_pop(worker, f)) {
+      --pending_;
+      f();
+      continue;
+    }
+    if (done_ && pending_ == 0)
+      return;
+    // A submitter increments the counter before it checks whether we sleep
+    // under our lock, so we either see the task here or get notified.
+    std::unique_lock<std::mutex> lock{q.mutex};
+    q.sleeping = true;
+    q.cv.wait(lock, [&] { return !q.sleeping || pending_ > 0 || done_; });
+    q.sleeping = false;
+  }
+}
+
+} // namespace vast::detail
@@ -11,8 +11,14 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 #include "vast/ewah_bitmap.hpp"
 
+#include "vast/detail/block_kernels.hpp"
+
 namespace vast {
 
 ewah_bitmap::ewah_bitmap(size_type n, bool bit) {
@@ -27,11 +33,20 @@ ewah_bitmap::size_type ewah_bitmap::size() const {
   return num_bits_;
 }
 
-const ewah_bitmap::block_vector& ewah_bitmap::blocks() const {
-  return blocks_;
+size_t ewah_bitmap::memusage() const {
+  return sizeof(*this) + blocks_.capacity() * sizeof(block_type);
+}
+
+ewah_bitmap::block_view ewah_bitmap::blocks() const {
+  return mapped() ? mapped_ : block_view{blocks_.data(), blocks_.size()};
+}
+
+bool ewah_bitmap::mapped() const {
+  return chunk_ != nullptr;
 }
 
 void ewah_bitmap::append_bit(bool bit) {
+  unmap();
   auto partial = num_bits_ % word_type::width;
   if (blocks_.empty()) {
     blocks_.push_back(0); // Always begin with an empty marker.
@@ -47,6 +62,7 @@ void ewah_bitmap::append_bit(bool bit) {
 }
 
 void ewah_bitmap::append_bits(bool bit, size_type n) {
+  unmap();
   if (n == 0)
     return;
   if (blocks_.empty()) {
@@ -121,6 +137,7 @@ void ewah_bitmap::append_bits(bool bit, size_type n) {
 }
 
 void ewah_bitmap::append_block(block_type value, size_type bits) {
+  unmap();
   VAST_ASSERT(bits > 0);
   VAST_ASSERT(bits <= word_type::width);
   if (blocks_.empty())
@@ -149,6 +166,7 @@ void ewah_bitmap::append_block(block_type value, size_type bits) {
 }
 
 void ewah_bitmap::flip() {
+  unmap();
   if (blocks_.empty())
     return;
   VAST_ASSERT(blocks_.size() >= 2);
@@ -168,6 +186,14 @@ void ewah_bitmap::flip() {
   blocks_.back() ^= word_type::lsb_mask(partial);
 }
 
+void ewah_bitmap::unmap() {
+  if (!mapped())
+    return;
+  blocks_.assign(mapped_.begin(), mapped_.end());
+  chunk_ = nullptr;
+  mapped_ = {};
+}
+
 void ewah_bitmap::integrate_last_block() {
   VAST_ASSERT(num_bits_ % word_type::width == 0);
   VAST_ASSERT(last_marker_ != blocks_.size() - 1);
@@ -230,7 +256,10 @@ void ewah_bitmap::bump_dirty_count() {
 bool operator==(const ewah_bitmap& x, const ewah_bitmap& y) {
   // If the block vector and the number of bits are equal, so must be the
   // marker by construction.
-  return x.blocks_ == y.blocks_ && x.num_bits_ == y.num_bits_;
+  auto xs = x.blocks();
+  auto ys = y.blocks();
+  return x.num_bits_ == y.num_bits_
+         && std::equal(xs.begin(), xs.end(), ys.begin(), ys.end());
 }
 
 ewah_bitmap_range::ewah_bitmap_range(const ewah_bitmap& bm)
@@ -293,4 +322,264 @@ ewah_bitmap_range bit_range(const ewah_bitmap& bm) {
   return ewah_bitmap_range{bm};
 }
 
+namespace {
+
+using block_type = ewah_bitmap::block_type;
+using word_type = ewah_bitmap::word_type;
+
+// Walks the blocks of an EWAH bitmap as a sequence of runs, each consisting
+// of clean blocks followed by dirty blocks. The final block forms a run of
+// a single dirty block.
+struct run_cursor {
+  explicit run_cursor(const ewah_bitmap& bm)
+    : blocks{bm.blocks().data()},
+      size{bm.blocks().size()} {
+  }
+
+  // Moves to the next run once the current one is exhausted.
+  void load() {
+    while (clean == 0 && dirty == 0 && next < size) {
+      if (next + 1 == size) {
+        literals = blocks + next;
+        dirty = 1;
+        ++next;
+      } else {
+        auto marker = blocks[next++];
+        clean = word_type::marker_num_clean(marker);
+        fill = word_type::marker_type(marker) ? word_type::all : word_type::none;
+        dirty = word_type::marker_num_dirty(marker);
+        literals = blocks + next;
+        next += dirty;
+      }
+    }
+  }
+
+  const block_type* blocks;
+  size_t size;
+  size_t next = 0;
+  uint64_t clean = 0;
+  block_type fill = word_type::none;
+  uint64_t dirty = 0;
+  const block_type* literals = nullptr;
+};
+
+// Applies a bitwise operation to two EWAH bitmaps of the same size. The
+// operation exists in two forms: *op* combines two blocks and *bulk*
+// combines two arrays of dirty blocks.
+template <class Operation, class Bulk>
+ewah_bitmap eval(const ewah_bitmap& lhs, const ewah_bitmap& rhs,
+                 Operation op, Bulk bulk) {
+  VAST_ASSERT(lhs.size() == rhs.size());
+  ewah_bitmap result;
+  auto remaining = (lhs.size() + word_type::width - 1) / word_type::width;
+  auto partial = lhs.size() % word_type::width;
+  // Only the very last block of the result may be incomplete.
+  auto append = [&](const block_type* xs, uint64_t n) {
+    for (auto i = 0u; i < n; ++i) {
+      auto last = remaining == n - i && partial > 0;
+      result.append_block(xs[i], last ? partial : word_type::width);
+    }
+    remaining -= n;
+  };
+  // A clean run turns the operation into a function of the other operand
+  // alone, which is either constant, the identity, or the complement.
+  std::array<block_type, 256> buffer;
+  auto apply_fill = [&](const block_type* xs, uint64_t n, auto f) {
+    auto zero = f(word_type::none);
+    auto one = f(word_type::all);
+    if (zero == one) {
+      result.append_bits(zero != word_type::none, n * word_type::width);
+      remaining -= n;
+    } else if (zero == word_type::none) {
+      append(xs, n);
+    } else {
+      for (auto i = uint64_t{0}; i < n; i += buffer.size()) {
+        auto k = std::min<uint64_t>(n - i, buffer.size());
+        detail::not_blocks(xs + i, buffer.data(), k);
+        append(buffer.data(), k);
+      }
+    }
+  };
+  run_cursor x{lhs};
+  run_cursor y{rhs};
+  while (remaining > 0) {
+    x.load();
+    y.load();
+    if (x.clean > 0 && y.clean > 0) {
+      auto n = std::min(x.clean, y.clean);
+      auto block = op(x.fill, y.fill);
+      VAST_ASSERT(word_type::all_or_none(block));
+      result.append_bits(block != word_type::none, n * word_type::width);
+      remaining -= n;
+      x.clean -= n;
+      y.clean -= n;
+    } else if (x.clean > 0) {
+      auto n = std::min(x.clean, y.dirty);
+      apply_fill(y.literals, n, [&](auto b) { return op(x.fill, b); });
+      x.clean -= n;
+      y.dirty -= n;
+      y.literals += n;
+    } else if (y.clean > 0) {
+      auto n = std::min(x.dirty, y.clean);
+      apply_fill(x.literals, n, [&](auto b) { return op(b, y.fill); });
+      x.dirty -= n;
+      x.literals += n;
+      y.clean -= n;
+    } else {
+      auto n = std::min<uint64_t>({x.dirty, y.dirty, buffer.size()});
+      bulk(x.literals, y.literals, buffer.data(), n);
+      append(buffer.data(), n);
+      x.dirty -= n;
+      x.literals += n;
+      y.dirty -= n;
+      y.literals += n;
+    }
+  }
+  return result;
+}
+
+} // namespace <anonymous>
+
+ewah_bitmap binary_and(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<false, false>(lhs, rhs, detail::and_op{});
+  return eval(lhs, rhs, detail::and_op{}, detail::and_blocks);
+}
+
+ewah_bitmap binary_or(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, true>(lhs, rhs, detail::or_op{});
+  return eval(lhs, rhs, detail::or_op{}, detail::or_blocks);
+}
+
+ewah_bitmap binary_xor(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, true>(lhs, rhs, detail::xor_op{});
+  return eval(lhs, rhs, detail::xor_op{}, detail::xor_blocks);
+}
+
+ewah_bitmap binary_nand(const ewah_bitmap& lhs, const ewah_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, false>(lhs, rhs, detail::nand_op{});
+  return eval(lhs, rhs, detail::nand_op{}, detail::nand_blocks);
+}
+
+ewah_bitmap nary_or(const std::vector<const ewah_bitmap*>& xs) {
+  ewah_bitmap result;
+  if (xs.empty())
+    return result;
+  auto size = xs.front()->size();
+  auto n = (size + word_type::width - 1) / word_type::width;
+  // Index bitmaps use global event IDs and thus often begin with a long run
+  // of 0s. We only materialize the span of blocks [first, last) that has 1s
+  // in any input.
+  auto first = n;
+  auto last = size_t{0};
+  auto dirty = size_t{0};
+  for (auto x : xs) {
+    VAST_ASSERT(x->size() == size);
+    run_cursor c{*x};
+    auto i = size_t{0};
+    for (c.load(); c.clean > 0 || c.dirty > 0; c.load()) {
+      if (c.clean > 0 && c.fill != word_type::none) {
+        first = std::min(first, i);
+        last = std::max(last, i + c.clean);
+      }
+      i += c.clean;
+      // We only need to scan literals that can move the bounds outward.
+      auto l = c.literals;
+      if (i < first) {
+        auto j = size_t{0};
+        while (j < c.dirty && l[j] == word_type::none)
+          ++j;
+        if (j < c.dirty)
+          first = i + j;
+      }
+      if (i + c.dirty > last) {
+        auto j = c.dirty;
+        while (j > 0 && l[j - 1] == word_type::none)
+          --j;
+        if (j > 0)
+          last = i + j;
+      }
+      i += c.dirty;
+      dirty += c.dirty;
+      c.clean = 0;
+      c.dirty = 0;
+    }
+  }
+  if (first >= last) {
+    result.append_bits(false, size);
+    return result;
+  }
+  // When the inputs consist mostly of runs, a buffer would be much larger
+  // than the inputs, whereas pairwise evaluation operates on runs directly.
+  auto span = last - first;
+  if (span > 16 * dirty) {
+    result = *xs.front();
+    for (auto i = 1u; i < xs.size(); ++i)
+      result = binary_or(result, *xs[i]);
+    return result;
+  }
+  std::vector<block_type> buffer(span, word_type::none);
+  for (auto x : xs) {
+    run_cursor c{*x};
+    auto i = size_t{0};
+    for (c.load(); c.clean > 0 || c.dirty > 0; c.load()) {
+      if (c.clean > 0 && c.fill != word_type::none)
+        std::fill_n(buffer.begin() + (i - first), c.clean, word_type::all);
+      i += c.clean;
+      // Skip the 0s before and after the span.
+      auto begin = std::max(i, first);
+      auto end = std::min(i + c.dirty, last);
+      if (begin < end)
+        detail::or_blocks(buffer.data() + (begin - first),
+                          c.literals + (begin - i),
+                          buffer.data() + (begin - first), end - begin);
+      i += c.dirty;
+      c.clean = 0;
+      c.dirty = 0;
+    }
+  }
+  // Compress the buffer, turning consecutive clean blocks into a single run.
+  // The last block of the bitmap may be incomplete and always goes in as
+  // dirty block.
+  result.append_bits(false, first * word_type::width);
+  auto partial = size % word_type::width;
+  for (auto i = first; i < last; ) {
+    auto block = buffer[i - first];
+    if (i + 1 < n && word_type::all_or_none(block)) {
+      auto j = i + 1;
+      while (j < last && j + 1 < n && buffer[j - first] == block)
+        ++j;
+      result.append_bits(block != word_type::none, (j - i) * word_type::width);
+      i = j;
+    } else {
+      auto last_block = i + 1 == n && partial > 0;
+      result.append_block(block, last_block ? partial : word_type::width);
+      ++i;
+    }
+  }
+  result.append_bits(false, size - result.size());
+  return result;
+}
+
+namespace detail {
+
+ewah_bitmap::size_type count_ones(const ewah_bitmap& bm) {
+  auto result = ewah_bitmap::size_type{0};
+  run_cursor x{bm};
+  for (x.load(); x.clean > 0 || x.dirty > 0; x.load()) {
+    if (x.fill != word_type::none)
+      result += x.clean * word_type::width;
+    // Bits beyond the size of the bitmap are always 0 in the last block.
+    result += popcount_blocks(x.literals, x.dirty);
+    x.clean = 0;
+    x.dirty = 0;
+  }
+  return result;
+}
+
+} // namespace detail
+
 } // namespace vast
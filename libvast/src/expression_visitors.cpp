@@ -598,12 +598,13 @@ bool matcher::operator()(const negation& n) {
 }
 
 bool matcher::operator()(const predicate& p) {
+  op_ = p.op;
   return visit(*this, p.lhs, p.rhs);
 }
 
 bool matcher::operator()(const attribute_extractor& e, const data& d) {
   if (e.attr == "type")
-    return type_.name() == get<std::string>(d);
+    return evaluate(data{type_.name()}, op_, d);
   return e.attr == "time"; // Every event has a timestamp.
 }
 
@@ -0,0 +1,191 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/incremental_evaluator.hpp"
+
+#include "vast/detail/assert.hpp"
+#include "vast/detail/overload.hpp"
+
+namespace vast {
+
+incremental_evaluator::incremental_evaluator()
+  : incremental_evaluator{expression{}} {
+  // nop
+}
+
+incremental_evaluator::incremental_evaluator(const expression& expr) {
+  root_ = compile(expr);
+  // Expressions without predicates are complete right away.
+  if (nodes_[root_].complete)
+    hits_ = nodes_[root_].hits;
+}
+
+ids incremental_evaluator::add(const predicate& pred, ids hits) {
+  auto i = predicates_.find(pred);
+  if (i == predicates_.end())
+    return {};
+  auto& leaf = nodes_[i->second];
+  VAST_ASSERT(!leaf.complete);
+  if (leaf.complete)
+    return {};
+  leaf.hits = std::move(hits);
+  leaf.complete = true;
+  ++completed_;
+  dirty_ = i->second == root_;
+  for (auto parent : leaf.parents)
+    update(parent, i->second, true);
+  if (!dirty_)
+    return {};
+  dirty_ = false;
+  auto delta = nodes_[root_].hits - hits_;
+  if (!any<1>(delta))
+    return {};
+  hits_ |= delta;
+  return delta;
+}
+
+const ids& incremental_evaluator::hits() const {
+  return hits_;
+}
+
+size_t incremental_evaluator::completed() const {
+  return completed_;
+}
+
+size_t incremental_evaluator::predicates() const {
+  return predicates_.size();
+}
+
+bool incremental_evaluator::done() const {
+  return completed_ == predicates_.size();
+}
+
+size_t incremental_evaluator::compile(const expression& expr) {
+  if (auto i = index_.find(expr); i != index_.end())
+    return i->second;
+  auto compile_operands = [&](const auto& xs) {
+    std::vector<size_t> result;
+    result.reserve(xs.size());
+    for (auto& x : xs)
+      result.push_back(compile(x));
+    return result;
+  };
+  auto n = visit(detail::overload(
+    [&](none) {
+      return make_node(expr, kind::disjunction, {});
+    },
+    [&](const conjunction& c) {
+      return make_node(expr, kind::conjunction, compile_operands(c));
+    },
+    [&](const disjunction& d) {
+      return make_node(expr, kind::disjunction, compile_operands(d));
+    },
+    [&](const negation& x) {
+      return make_node(expr, kind::negation, {compile(x.expr())});
+    },
+    [&](const predicate& x) {
+      auto result = make_node(expr, kind::predicate, {});
+      predicates_.emplace(x, result);
+      return result;
+    }
+  ), expr);
+  index_.emplace(expr, n);
+  return n;
+}
+
+size_t incremental_evaluator::make_node(const expression& expr, kind k,
+                                        std::vector<size_t> operands) {
+  auto n = nodes_.size();
+  for (auto x : operands)
+    nodes_[x].parents.push_back(n);
+  nodes_.emplace_back();
+  auto& x = nodes_.back();
+  x.k = k;
+  x.pending = k == kind::predicate ? 1 : operands.size();
+  x.operands = std::move(operands);
+  // Empty conjunctions and disjunctions have no hits and never change.
+  x.complete = x.pending == 0;
+  return n;
+}
+
+void incremental_evaluator::update(size_t parent, size_t operand,
+                                   bool completed) {
+  auto& x = nodes_[parent];
+  VAST_ASSERT(x.k != kind::predicate);
+  if (x.complete)
+    return;
+  auto& y = nodes_[operand];
+  auto changed = false;
+  if (completed)
+    --x.pending;
+  switch (x.k) {
+    case kind::predicate:
+      break;
+    case kind::disjunction:
+      if (!y.hits.empty() && any<1>(y.hits)) {
+        x.hits |= y.hits;
+        changed = true;
+      }
+      break;
+    case kind::conjunction: {
+      // A single empty operand decides the conjunction.
+      if (completed && (y.hits.empty() || all<0>(y.hits))) {
+        x.hits = {};
+        x.pending = 0;
+        break;
+      }
+      if (x.pending > 0)
+        break;
+      // Intersect the operands with the fewest hits first, so that the
+      // intersection shrinks as early as possible.
+      std::vector<std::pair<uint64_t, size_t>> xs;
+      xs.reserve(x.operands.size());
+      for (auto i : x.operands)
+        xs.emplace_back(rank(nodes_[i].hits), i);
+      std::sort(xs.begin(), xs.end());
+      x.hits = nodes_[xs[0].second].hits;
+      for (auto i = 1u; i < xs.size(); ++i) {
+        x.hits &= nodes_[xs[i].second].hits;
+        if (x.hits.empty() || all<0>(x.hits)) {
+          x.hits = {};
+          break;
+        }
+      }
+      changed = true;
+      break;
+    }
+    case kind::negation:
+      // Negations wait for their operand to complete, because the
+      // complement of partial hits would yield false positives.
+      if (x.pending > 0)
+        break;
+      x.hits = y.hits;
+      x.hits.flip();
+      changed = true;
+      break;
+  }
+  auto now_complete = x.pending == 0;
+  if (!changed && !now_complete)
+    return;
+  x.complete = now_complete;
+  if (parent == root_)
+    dirty_ = true;
+  for (auto p : x.parents)
+    update(p, parent, now_complete);
+}
+
+} // namespace vast
@@ -0,0 +1,187 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "vast/error.hpp"
+#include "vast/journal.hpp"
+#include "vast/logger.hpp"
+
+#include "vast/concept/hashable/crc.hpp"
+#include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/filesystem.hpp"
+#include "vast/detail/byte_swap.hpp"
+#include "vast/detail/posix.hpp"
+
+namespace vast {
+
+namespace {
+
+// The number of bytes preceding each payload.
+constexpr size_t frame_header_size = 4 + 4;
+
+uint32_t checksum(const char* data, size_t size) {
+  crc32 crc;
+  crc(data, size);
+  return crc;
+}
+
+// Appends a payload along with its frame header to a file and forces both to
+// stable storage. Creates the directory of the file if necessary.
+expected<void> write_frame(const path& filename, const std::vector<char>& x) {
+  uint32_t header[2] = {
+    detail::to_network_order(static_cast<uint32_t>(x.size())),
+    detail::to_network_order(checksum(x.data(), x.size())),
+  };
+  file f{filename};
+  if (auto result = f.open(file::write_only, true); !result)
+    return result.error();
+  auto ok = f.write(header, sizeof(header))
+            && f.write(x.data(), x.size())
+            && detail::fsync(f.handle());
+  if (!f.close() || !ok)
+    return make_error(ec::filesystem_error, "failed to write", filename);
+  return no_error;
+}
+
+// Forces the entries of a directory to stable storage, which makes a rename
+// or removal within it durable.
+expected<void> sync_directory(const path& dir) {
+  file f{dir};
+  if (auto result = f.open(file::read_only); !result)
+    return result.error();
+  auto ok = detail::fsync(f.handle());
+  if (!f.close() || !ok)
+    return make_error(ec::filesystem_error, "failed to sync directory", dir);
+  return no_error;
+}
+
+// Reads the payload of the frame that begins at a given offset.
+// @returns The offset past the frame, or 0 if the frame is incomplete or
+//          its checksum does not match.
+size_t read_frame(const std::string& buf, size_t offset,
+                  std::vector<char>& payload) {
+  if (buf.size() - offset < frame_header_size)
+    return 0;
+  uint32_t header[2];
+  std::memcpy(header, buf.data() + offset, sizeof(header));
+  auto size = detail::to_host_order(header[0]);
+  auto crc = detail::to_host_order(header[1]);
+  offset += frame_header_size;
+  if (buf.size() - offset < size)
+    return 0;
+  auto data = buf.data() + offset;
+  if (checksum(data, size) != crc)
+    return 0;
+  payload.assign(data, data + size);
+  return offset + size;
+}
+
+} // namespace <anonymous>
+
+journal::journal(path dir) : dir_{std::move(dir)} {
+  // nop
+}
+
+expected<void> journal::replay(handler snapshot, handler record) {
+  std::vector<char> payload;
+  if (exists(dir_ / "snapshot")) {
+    auto contents = load_contents(dir_ / "snapshot");
+    if (!contents)
+      return contents.error();
+    if (read_frame(*contents, 0, payload) == 0)
+      return make_error(ec::format_error, "corrupted journal snapshot",
+                        dir_ / "snapshot");
+    if (auto result = snapshot(payload); !result)
+      return result.error();
+    snapshot_bytes_ = contents->size();
+  }
+  records_ = 0;
+  log_bytes_ = 0;
+  if (!exists(dir_ / "log"))
+    return no_error;
+  auto contents = load_contents(dir_ / "log");
+  if (!contents)
+    return contents.error();
+  auto offset = size_t{0};
+  while (offset < contents->size()) {
+    auto next = read_frame(*contents, offset, payload);
+    if (next == 0)
+      break;
+    if (auto result = record(payload); !result)
+      return result.error();
+    offset = next;
+    ++records_;
+  }
+  log_bytes_ = offset;
+  if (offset < contents->size()) {
+    VAST_WARNING("discards", contents->size() - offset,
+                 "trailing bytes of journal", dir_);
+    std::ofstream log{(dir_ / "log").str(),
+                      std::ios::binary | std::ios::trunc};
+    log.write(contents->data(), offset);
+    if (!log)
+      return make_error(ec::filesystem_error, "failed to truncate journal",
+                        dir_ / "log");
+  }
+  return no_error;
+}
+
+expected<void> journal::append(const std::vector<char>& x) {
+  if (auto result = write_frame(dir_ / "log", x); !result)
+    return result.error();
+  ++records_;
+  log_bytes_ += frame_header_size + x.size();
+  return no_error;
+}
+
+expected<void> journal::compact(const std::vector<char>& x) {
+  // Replace the snapshot atomically, so that a crash leaves either the old
+  // or the new one behind.
+  auto tmp = dir_ / "snapshot.tmp";
+  if (exists(tmp) && !rm(tmp))
+    return make_error(ec::filesystem_error, "failed to remove", tmp);
+  if (auto result = write_frame(tmp, x); !result)
+    return result.error();
+  auto snapshot = dir_ / "snapshot";
+  if (std::rename(tmp.str().c_str(), snapshot.str().c_str()) != 0)
+    return make_error(ec::filesystem_error, "failed to rename snapshot",
+                      snapshot);
+  // The log must not vanish before the new snapshot is durable.
+  if (auto result = sync_directory(dir_); !result)
+    return result.error();
+  if (exists(dir_ / "log") && !rm(dir_ / "log"))
+    return make_error(ec::filesystem_error, "failed to truncate journal",
+                      dir_ / "log");
+  records_ = 0;
+  log_bytes_ = 0;
+  snapshot_bytes_ = frame_header_size + x.size();
+  VAST_DEBUG("compacted journal", dir_);
+  return no_error;
+}
+
+bool journal::needs_compaction() const {
+  return log_bytes_ > snapshot_bytes_;
+}
+
+size_t journal::records() const {
+  return records_;
+}
+
+const path& journal::dir() const {
+  return dir_;
+}
+
+} // namespace vast
@@ -0,0 +1,143 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "vast/mapped_serialization.hpp"
+
+#include "vast/detail/byte_swap.hpp"
+
+namespace vast::detail {
+
+namespace {
+
+using format = mapped_file_format;
+using block_type = block_arena::block_type;
+
+template <class T>
+void write_integral(std::ostream& out, T x) {
+  x = to_network_order(x);
+  out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <class T>
+T read_integral(const char*& ptr) {
+  T x;
+  std::memcpy(&x, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return to_host_order(x);
+}
+
+// Converts a block between host order and the little-endian arena order.
+block_type to_arena_order(block_type x) {
+#if defined(VAST_LITTLE_ENDIAN)
+  return x;
+#elif defined(VAST_BIG_ENDIAN)
+  return byte_swap(x);
+#endif
+}
+
+} // namespace <anonymous>
+
+expected<void> write_mapped_file(const path& filename,
+                                 const std::vector<char>& state,
+                                 block_view blocks) {
+  auto state_size = static_cast<uint64_t>(state.size());
+  auto arena_offset = format::header_size + state_size;
+  auto padding = (sizeof(block_type) - arena_offset % sizeof(block_type))
+                 % sizeof(block_type);
+  arena_offset += padding;
+  auto tmp = path{filename.str() + ".tmp"};
+  {
+    std::ofstream out{tmp.str(), std::ios::binary | std::ios::trunc};
+    write_integral(out, format::magic);
+    write_integral(out, format::version);
+    write_integral(out, state_size);
+    write_integral(out, arena_offset);
+    write_integral(out, static_cast<uint64_t>(blocks.size()));
+    out.write(state.data(), state.size());
+    char zeros[sizeof(block_type)] = {};
+    out.write(zeros, padding);
+#if defined(VAST_LITTLE_ENDIAN)
+    out.write(reinterpret_cast<const char*>(blocks.data()),
+              blocks.size() * sizeof(block_type));
+#else
+    for (auto x : blocks) {
+      x = to_arena_order(x);
+      out.write(reinterpret_cast<const char*>(&x), sizeof(block_type));
+    }
+#endif
+    out.flush();
+    if (!out)
+      return make_error(ec::filesystem_error, "failed to write mapped file",
+                        tmp);
+  }
+  // Renaming leaves existing mappings of the previous file valid.
+  if (std::rename(tmp.str().c_str(), filename.str().c_str()) != 0)
+    return make_error(ec::filesystem_error, "failed to rename mapped file",
+                      filename);
+  return no_error;
+}
+
+expected<mapped_file> read_mapped_file(const path& filename) {
+  auto chk = chunk::mmap(filename);
+  if (!chk)
+    return make_error(ec::filesystem_error, "failed to mmap file", filename);
+  if (chk->size() < format::header_size)
+    return make_error(ec::format_error, "truncated mapped file header");
+  auto ptr = chk->data();
+  if (read_integral<format::magic_type>(ptr) != format::magic)
+    return make_error(ec::format_error, "mapped file magic error");
+  auto v = read_integral<format::version_type>(ptr);
+  if (v != format::version)
+    return make_error(ec::version_error, v, format::version);
+  auto state_size = read_integral<uint64_t>(ptr);
+  auto arena_offset = read_integral<uint64_t>(ptr);
+  auto arena_size = read_integral<uint64_t>(ptr);
+  if (state_size > chk->size() - format::header_size
+      || arena_offset < format::header_size + state_size
+      || arena_offset % sizeof(block_type) != 0
+      || arena_offset > chk->size()
+      || arena_size > (chk->size() - arena_offset) / sizeof(block_type))
+    return make_error(ec::format_error, "mapped file exceeds file bounds");
+  auto arena_bytes = arena_size * sizeof(block_type);
+  auto arena = chk->data() + arena_offset;
+  mapped_file result;
+  result.state = chk->data() + format::header_size;
+  result.state_size = state_size;
+#if defined(VAST_LITTLE_ENDIAN)
+  // Mappings start at a page boundary, which makes the arena aligned.
+  if (reinterpret_cast<uintptr_t>(arena) % alignof(block_type) == 0) {
+    result.arena = block_arena{chk, reinterpret_cast<const block_type*>(arena),
+                               arena_size};
+    result.chunk = std::move(chk);
+    return result;
+  }
+#endif
+  // Fall back to a converted copy of the arena on the heap.
+  auto copy = chunk::make(arena_bytes > 0 ? arena_bytes : sizeof(block_type));
+  auto blocks = reinterpret_cast<block_type*>(const_cast<char*>(copy->data()));
+  for (auto i = 0u; i < arena_size; ++i) {
+    block_type x;
+    std::memcpy(&x, arena + i * sizeof(block_type), sizeof(block_type));
+    blocks[i] = to_arena_order(x);
+  }
+  result.arena = block_arena{std::move(copy), blocks, arena_size};
+  result.chunk = std::move(chk);
+  return result;
+}
+
+} // namespace vast::detail
@@ -11,10 +11,12 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <atomic>
 #include <regex>
 
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/pattern.hpp"
+#include "vast/detail/pattern_matcher.hpp"
 #include "vast/json.hpp"
 #include "vast/pattern.hpp"
 
@@ -29,18 +31,42 @@ pattern pattern::glob(const std::string& str) {
 pattern::pattern(std::string str) : str_(std::move(str)) {
 }
 
+pattern::pattern(const pattern& other)
+  : str_{other.str_},
+    matcher_{std::atomic_load(&other.matcher_)} {
+}
+
+pattern& pattern::operator=(const pattern& other) {
+  str_ = other.str_;
+  std::atomic_store(&matcher_, std::atomic_load(&other.matcher_));
+  return *this;
+}
+
 bool pattern::match(const std::string& str) const {
-  return std::regex_match(str.begin(), str.end(), std::regex{str_});
+  return matcher()->match(str);
 }
 
 bool pattern::search(const std::string& str) const {
-  return std::regex_search(str.begin(), str.end(), std::regex{str_});
+  return matcher()->search(str);
 }
 
 const std::string& pattern::string() const {
   return str_;
 }
 
+std::shared_ptr<const detail::pattern_matcher> pattern::matcher() const {
+  // Several threads may evaluate the same pattern concurrently. If they race
+  // to compile it, the first one to finish wins.
+  auto result = std::atomic_load(&matcher_);
+  if (result)
+    return result;
+  auto compiled = std::shared_ptr<const detail::pattern_matcher>{
+    std::make_shared<detail::pattern_matcher>(str_)};
+  if (std::atomic_compare_exchange_strong(&matcher_, &result, compiled))
+    return compiled;
+  return result;
+}
+
 bool operator==(const pattern& lhs, const pattern& rhs) {
   return lhs.str_ == rhs.str_;
 }
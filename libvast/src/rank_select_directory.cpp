@@ -0,0 +1,48 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/rank_select_directory.hpp"
+
+namespace vast {
+
+rank_select_directory::rank_select_directory(const ewah_bitmap& bm)
+  : size_{bm.size()} {
+  samples_.push_back({0, 0, 0});
+  auto sample_at = size_type{sample_rate};
+  auto on_marker = [&](const sample& x) {
+    if (x.block < sample_at)
+      return;
+    samples_.push_back(x);
+    sample_at = x.block + sample_rate;
+  };
+  scan(bm, samples_.front(), [&](auto& cursor, auto& b) {
+    auto n = vast::rank<1>(b);
+    if (n > 0)
+      last_[1] = cursor.position + vast::find_last<1>(b);
+    if (n < b.size())
+      last_[0] = cursor.position + vast::find_last<0>(b);
+    ones_ += n;
+    return false;
+  }, on_marker);
+  samples_.shrink_to_fit();
+}
+
+rank_select_directory::size_type rank_select_directory::size() const {
+  return size_;
+}
+
+size_t rank_select_directory::memusage() const {
+  return sizeof(*this) + samples_.capacity() * sizeof(sample);
+}
+
+} // namespace vast
@@ -0,0 +1,586 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+
+#include "vast/roaring_bitmap.hpp"
+#include "vast/detail/block_kernels.hpp"
+
+namespace vast {
+
+namespace {
+
+using block_type = roaring_bitmap::block_type;
+using size_type = roaring_bitmap::size_type;
+using word_type = roaring_bitmap::word_type;
+using chunk = roaring_bitmap::chunk;
+using container = roaring_bitmap::container;
+
+constexpr auto chunk_size = roaring_bitmap::chunk_size;
+constexpr auto bitset_blocks = roaring_bitmap::bitset_blocks;
+
+// Sets the bits *[first, first + n)* of a bitset to 1.
+void set_range(block_type* xs, size_t first, size_t n) {
+  while (n > 0) {
+    auto offset = first % word_type::width;
+    auto k = std::min(n, word_type::width - offset);
+    xs[first / word_type::width] |= word_type::lsb_fill(k) << offset;
+    first += k;
+    n -= k;
+  }
+}
+
+// Finds the first bit with a given value at or after position *i* in a
+// bitset, or returns the chunk size if no such bit exists.
+size_t find_from(const block_type* xs, size_t i, bool bit) {
+  auto n = i / word_type::width;
+  auto x = (bit ? xs[n] : ~xs[n]) & (word_type::all << (i % word_type::width));
+  while (x == 0) {
+    if (++n == bitset_blocks)
+      return chunk_size;
+    x = bit ? xs[n] : ~xs[n];
+  }
+  return n * word_type::width + word_type::count_trailing_zeros(x);
+}
+
+// Expands a chunk of any container type into a bitset.
+void decode(const chunk& x, block_type* out) {
+  if (x.type == container::bitset) {
+    std::copy(x.blocks.begin(), x.blocks.end(), out);
+    return;
+  }
+  std::fill_n(out, bitset_blocks, block_type{0});
+  if (x.type == container::array)
+    for (auto i : x.values)
+      out[i / word_type::width] |= word_type::lsb1 << (i % word_type::width);
+  else
+    for (auto i = 0u; i < x.values.size(); i += 2)
+      set_range(out, x.values[i], size_t{x.values[i + 1]} + 1);
+}
+
+// Turns the bitset *xs* into a container of the given type.
+void encode(chunk& x, const block_type* xs, container type) {
+  std::vector<uint16_t> values;
+  std::vector<block_type> blocks;
+  switch (type) {
+    case container::array:
+      for (auto i = 0u; i < bitset_blocks; ++i)
+        for (auto block = xs[i]; block != 0; block &= block - 1) {
+          auto j = word_type::count_trailing_zeros(block);
+          values.push_back(i * word_type::width + j);
+        }
+      break;
+    case container::bitset:
+      blocks.assign(xs, xs + bitset_blocks);
+      break;
+    case container::run:
+      for (auto i = find_from(xs, 0, true); i < chunk_size; ) {
+        auto j = find_from(xs, i, false);
+        values.push_back(i);
+        values.push_back(j - i - 1);
+        i = j < chunk_size ? find_from(xs, j, true) : chunk_size;
+      }
+      break;
+  }
+  x.type = type;
+  x.values = std::move(values);
+  x.blocks = std::move(blocks);
+}
+
+size_t cardinality(const chunk& x) {
+  switch (x.type) {
+    default:
+    case container::array:
+      return x.values.size();
+    case container::bitset:
+      return detail::popcount_blocks(x.blocks.data(), bitset_blocks);
+    case container::run: {
+      auto result = size_t{0};
+      for (auto i = 1u; i < x.values.size(); i += 2)
+        result += size_t{x.values[i]} + 1;
+      return result;
+    }
+  }
+}
+
+size_t count_runs(const chunk& x) {
+  switch (x.type) {
+    default:
+    case container::array: {
+      auto result = x.values.empty() ? 0 : size_t{1};
+      for (auto i = 1u; i < x.values.size(); ++i)
+        if (x.values[i] != x.values[i - 1] + 1)
+          ++result;
+      return result;
+    }
+    case container::bitset: {
+      // A run begins at every 1-bit whose predecessor is a 0-bit.
+      auto result = size_t{0};
+      auto carry = block_type{0};
+      for (auto block : x.blocks) {
+        auto starts = block & ~((block << 1) | carry);
+        result += word_type::popcount(starts);
+        carry = block >> (word_type::width - 1);
+      }
+      return result;
+    }
+    case container::run:
+      return x.values.size() / 2;
+  }
+}
+
+// Switches a chunk to the container with the smallest footprint, preferring
+// arrays over runs over bitsets when they occupy the same space. Since the
+// choice depends only on the contents, optimized chunks have a canonical
+// representation.
+void optimize(chunk& x) {
+  auto array_bytes = cardinality(x) * sizeof(uint16_t);
+  auto run_bytes = count_runs(x) * 2 * sizeof(uint16_t);
+  auto bitset_bytes = bitset_blocks * sizeof(block_type);
+  auto type = container::bitset;
+  if (array_bytes <= run_bytes && array_bytes <= bitset_bytes)
+    type = container::array;
+  else if (run_bytes <= bitset_bytes)
+    type = container::run;
+  if (type == x.type)
+    return;
+  if (x.type == container::bitset) {
+    auto blocks = std::move(x.blocks);
+    encode(x, blocks.data(), type);
+  } else {
+    std::vector<block_type> blocks(bitset_blocks);
+    decode(x, blocks.data());
+    encode(x, blocks.data(), type);
+  }
+}
+
+// Creates an optimized chunk from a bitset.
+// @returns `false` iff the bitset has no 1-bits.
+bool compress(size_type key, const block_type* xs, chunk& x) {
+  if (detail::popcount_blocks(xs, bitset_blocks) == 0)
+    return false;
+  x.key = key;
+  encode(x, xs, container::bitset);
+  optimize(x);
+  return true;
+}
+
+bool contains(const chunk& x, uint16_t i) {
+  switch (x.type) {
+    default:
+    case container::array:
+      return std::binary_search(x.values.begin(), x.values.end(), i);
+    case container::bitset:
+      return word_type::test(x.blocks[i / word_type::width],
+                             i % word_type::width);
+    case container::run: {
+      // Find the last run that begins at or before *i*.
+      auto first = size_t{0};
+      auto last = x.values.size() / 2;
+      while (first < last) {
+        auto mid = first + (last - first) / 2;
+        if (x.values[2 * mid] <= i)
+          first = mid + 1;
+        else
+          last = mid;
+      }
+      if (first == 0)
+        return false;
+      auto start = size_t{x.values[2 * (first - 1)]};
+      return i <= start + x.values[2 * (first - 1) + 1];
+    }
+  }
+}
+
+bool equal(const chunk& x, const chunk& y) {
+  if (x.type == y.type)
+    return x.values == y.values && x.blocks == y.blocks;
+  // The last chunk of a bitmap may not have been optimized yet.
+  std::vector<block_type> xs(bitset_blocks);
+  std::vector<block_type> ys(bitset_blocks);
+  decode(x, xs.data());
+  decode(y, ys.data());
+  return xs == ys;
+}
+
+using kernel = void (*)(const block_type*, const block_type*, block_type*,
+                        size_t);
+
+// Combines two chunk sequences of equal-size bitmaps. Chunks that exist only
+// on one side either pass through unchanged or vanish, depending on the
+// operation.
+roaring_bitmap::chunk_vector
+combine(const roaring_bitmap::chunk_vector& xs,
+        const roaring_bitmap::chunk_vector& ys, kernel f, bool keep_lhs,
+        bool keep_rhs) {
+  roaring_bitmap::chunk_vector result;
+  std::vector<block_type> lhs(bitset_blocks);
+  std::vector<block_type> rhs(bitset_blocks);
+  auto x = xs.begin();
+  auto y = ys.begin();
+  while (x != xs.end() && y != ys.end()) {
+    if (x->key < y->key) {
+      if (keep_lhs)
+        result.push_back(*x);
+      ++x;
+    } else if (y->key < x->key) {
+      if (keep_rhs)
+        result.push_back(*y);
+      ++y;
+    } else {
+      // Only intersections drop unmatched chunks on both sides. When one of
+      // the two chunks is an array, probing the other one for each entry
+      // beats expanding both into bitsets.
+      auto intersect = !keep_lhs && !keep_rhs;
+      if (intersect && (x->type == container::array
+                        || y->type == container::array)) {
+        auto& array = x->type == container::array ? *x : *y;
+        auto& other = x->type == container::array ? *y : *x;
+        chunk z{x->key, container::array, {}, {}};
+        for (auto i : array.values)
+          if (contains(other, i))
+            z.values.push_back(i);
+        if (!z.values.empty()) {
+          optimize(z);
+          result.push_back(std::move(z));
+        }
+      } else {
+        decode(*x, lhs.data());
+        decode(*y, rhs.data());
+        f(lhs.data(), rhs.data(), lhs.data(), bitset_blocks);
+        chunk z;
+        if (compress(x->key, lhs.data(), z))
+          result.push_back(std::move(z));
+      }
+      ++x;
+      ++y;
+    }
+  }
+  if (keep_lhs)
+    result.insert(result.end(), x, xs.end());
+  if (keep_rhs)
+    result.insert(result.end(), y, ys.end());
+  return result;
+}
+
+} // namespace <anonymous>
+
+roaring_bitmap::roaring_bitmap(size_type n, bool bit) {
+  append_bits(bit, n);
+}
+
+bool roaring_bitmap::empty() const {
+  return num_bits_ == 0;
+}
+
+roaring_bitmap::size_type roaring_bitmap::size() const {
+  return num_bits_;
+}
+
+size_t roaring_bitmap::memusage() const {
+  auto result = sizeof(*this) + chunks_.capacity() * sizeof(chunk);
+  for (auto& x : chunks_)
+    result += x.values.capacity() * sizeof(uint16_t)
+              + x.blocks.capacity() * sizeof(block_type);
+  return result;
+}
+
+const roaring_bitmap::chunk_vector& roaring_bitmap::chunks() const {
+  return chunks_;
+}
+
+bool roaring_bitmap::operator[](size_type i) const {
+  VAST_ASSERT(i < num_bits_);
+  auto key = i / chunk_size;
+  auto pred = [](const chunk& x, size_type k) { return x.key < k; };
+  auto x = std::lower_bound(chunks_.begin(), chunks_.end(), key, pred);
+  return x != chunks_.end() && x->key == key && contains(*x, i % chunk_size);
+}
+
+void roaring_bitmap::append_bit(bool bit) {
+  VAST_ASSERT(num_bits_ < max_size);
+  if (bit)
+    set_ones(num_bits_, 1);
+  seal(num_bits_++);
+}
+
+void roaring_bitmap::append_bits(bool bit, size_type n) {
+  VAST_ASSERT(max_size - num_bits_ >= n);
+  auto old_size = num_bits_;
+  if (bit)
+    while (n > 0) {
+      auto k = std::min(n, chunk_size - num_bits_ % chunk_size);
+      set_ones(num_bits_, k);
+      num_bits_ += k;
+      n -= k;
+    }
+  else
+    num_bits_ += n;
+  seal(old_size);
+}
+
+void roaring_bitmap::append_block(block_type value, size_type n) {
+  VAST_ASSERT(n > 0);
+  VAST_ASSERT(n <= word_type::width);
+  VAST_ASSERT(max_size - num_bits_ >= n);
+  // Add the 1-bits run by run, splitting runs that cross a chunk boundary.
+  value &= word_type::lsb_fill(n);
+  while (value != 0) {
+    auto first = word_type::count_trailing_zeros(value);
+    auto length = word_type::count_trailing_ones(value >> first);
+    auto i = num_bits_ + first;
+    auto k = std::min<size_type>(length, chunk_size - i % chunk_size);
+    set_ones(i, k);
+    if (k < length)
+      set_ones(i + k, length - k);
+    value &= ~word_type::lsb_fill(first + length);
+  }
+  auto old_size = num_bits_;
+  num_bits_ += n;
+  seal(old_size);
+}
+
+void roaring_bitmap::flip() {
+  chunk_vector result;
+  std::vector<block_type> blocks(bitset_blocks);
+  auto x = chunks_.begin();
+  for (auto key = size_type{0}; key * chunk_size < num_bits_; ++key) {
+    auto n = std::min(chunk_size, num_bits_ - key * chunk_size);
+    if (x != chunks_.end() && x->key == key) {
+      decode(*x++, blocks.data());
+      detail::not_blocks(blocks.data(), blocks.data(), bitset_blocks);
+      // Keep the bits past the end of the bitmap at 0.
+      if (n < chunk_size) {
+        auto i = n / word_type::width;
+        if (n % word_type::width != 0)
+          blocks[i++] &= word_type::lsb_fill(n % word_type::width);
+        std::fill(blocks.begin() + i, blocks.end(), block_type{0});
+      }
+      chunk y;
+      if (compress(key, blocks.data(), y))
+        result.push_back(std::move(y));
+    } else {
+      chunk y{key, container::run, {0, static_cast<uint16_t>(n - 1)}, {}};
+      optimize(y);
+      result.push_back(std::move(y));
+    }
+  }
+  chunks_ = std::move(result);
+}
+
+bool operator==(const roaring_bitmap& x, const roaring_bitmap& y) {
+  if (x.num_bits_ != y.num_bits_ || x.chunks_.size() != y.chunks_.size())
+    return false;
+  for (auto i = 0u; i < x.chunks_.size(); ++i)
+    if (x.chunks_[i].key != y.chunks_[i].key
+        || !equal(x.chunks_[i], y.chunks_[i]))
+      return false;
+  return true;
+}
+
+void roaring_bitmap::set_ones(size_type i, size_type n) {
+  VAST_ASSERT(n > 0);
+  VAST_ASSERT(i >= num_bits_);
+  auto key = i / chunk_size;
+  auto offset = i % chunk_size;
+  VAST_ASSERT(offset + n <= chunk_size);
+  if (chunks_.empty() || chunks_.back().key != key) {
+    // The previous chunk will never change again.
+    if (!chunks_.empty())
+      optimize(chunks_.back());
+    auto type = n > 1 ? container::run : container::array;
+    chunks_.push_back(chunk{key, type, {}, {}});
+  }
+  auto& x = chunks_.back();
+  if (x.type == container::array) {
+    if (x.values.size() + n <= max_array_size) {
+      for (auto j = offset; j < offset + n; ++j)
+        x.values.push_back(j);
+      return;
+    }
+  } else if (x.type == container::run) {
+    auto& runs = x.values;
+    auto last = runs.size();
+    if (last > 0 && size_t{runs[last - 2]} + runs[last - 1] + 1 == offset)
+      runs[last - 1] += n;
+    else {
+      runs.push_back(offset);
+      runs.push_back(n - 1);
+    }
+    if (runs.size() <= max_array_size)
+      return;
+  }
+  if (x.type != container::bitset) {
+    std::vector<block_type> blocks(bitset_blocks);
+    decode(x, blocks.data());
+    x.type = container::bitset;
+    x.values = {};
+    x.blocks = std::move(blocks);
+  }
+  // A run container that just overflowed already contains the new bits.
+  set_range(x.blocks.data(), offset, n);
+}
+
+void roaring_bitmap::seal(size_type old_size) {
+  if (chunks_.empty())
+    return;
+  auto end = (chunks_.back().key + 1) * chunk_size;
+  if (old_size < end && num_bits_ >= end)
+    optimize(chunks_.back());
+}
+
+
+roaring_bitmap_range::roaring_bitmap_range(const roaring_bitmap& bm)
+  : bm_{&bm} {
+  if (!done())
+    scan();
+}
+
+void roaring_bitmap_range::next() {
+  VAST_ASSERT(!done());
+  position_ += bits_.size();
+  if (!done())
+    scan();
+}
+
+bool roaring_bitmap_range::done() const {
+  return bm_ == nullptr || position_ == bm_->num_bits_;
+}
+
+void roaring_bitmap_range::scan() {
+  // Like EWAH, we produce fills spanning multiple entire blocks, individual
+  // literal blocks, and a final partial block.
+  auto partial = bm_->num_bits_ % word_type::width;
+  auto complete = bm_->num_bits_ - partial;
+  if (position_ >= complete) {
+    bits_ = {block_at(position_), partial};
+    return;
+  }
+  auto block = block_at(position_);
+  if (!word_type::all_or_none(block)) {
+    bits_ = {block, word_type::width};
+    return;
+  }
+  auto& chunks = bm_->chunks_;
+  auto end = position_ + word_type::width;
+  while (end < complete) {
+    if (end % chunk_size == 0) {
+      auto key = end / chunk_size;
+      while (chunk_ < chunks.size() && chunks[chunk_].key < key)
+        ++chunk_;
+      auto present = chunk_ < chunks.size() && chunks[chunk_].key == key;
+      if (block == word_type::none && !present) {
+        // Skip all absent chunks at once.
+        end = chunk_ < chunks.size() ? chunks[chunk_].key * chunk_size
+                                     : complete;
+        end = std::min(end, complete);
+        continue;
+      }
+      if (block == word_type::all && present) {
+        auto& x = chunks[chunk_];
+        if (x.type == container::run && x.values.size() == 2
+            && x.values[0] == 0 && x.values[1] == chunk_size - 1) {
+          // Skip a chunk consisting of a single run.
+          end += chunk_size;
+          continue;
+        }
+      }
+    }
+    if (block_at(end) != block)
+      break;
+    end += word_type::width;
+  }
+  bits_ = {block, end - position_};
+}
+
+roaring_bitmap::block_type
+roaring_bitmap_range::block_at(roaring_bitmap::size_type i) {
+  auto& chunks = bm_->chunks_;
+  auto key = i / roaring_bitmap::chunk_size;
+  while (chunk_ < chunks.size() && chunks[chunk_].key < key)
+    ++chunk_;
+  if (chunk_ == chunks.size() || chunks[chunk_].key != key)
+    return word_type::none;
+  auto& x = chunks[chunk_];
+  auto n = i % roaring_bitmap::chunk_size / word_type::width;
+  if (x.type == container::bitset)
+    return x.blocks[n];
+  if (decoded_ != chunk_) {
+    buffer_.resize(bitset_blocks);
+    decode(x, buffer_.data());
+    decoded_ = chunk_;
+  }
+  return buffer_[n];
+}
+
+roaring_bitmap_range bit_range(const roaring_bitmap& bm) {
+  return roaring_bitmap_range{bm};
+}
+
+roaring_bitmap binary_and(const roaring_bitmap& lhs,
+                          const roaring_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<false, false>(lhs, rhs, detail::and_op{});
+  roaring_bitmap result;
+  result.chunks_ = combine(lhs.chunks_, rhs.chunks_, detail::and_blocks,
+                           false, false);
+  result.num_bits_ = lhs.num_bits_;
+  return result;
+}
+
+roaring_bitmap binary_or(const roaring_bitmap& lhs,
+                         const roaring_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, true>(lhs, rhs, detail::or_op{});
+  roaring_bitmap result;
+  result.chunks_ = combine(lhs.chunks_, rhs.chunks_, detail::or_blocks,
+                           true, true);
+  result.num_bits_ = lhs.num_bits_;
+  return result;
+}
+
+roaring_bitmap binary_xor(const roaring_bitmap& lhs,
+                          const roaring_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, true>(lhs, rhs, detail::xor_op{});
+  roaring_bitmap result;
+  result.chunks_ = combine(lhs.chunks_, rhs.chunks_, detail::xor_blocks,
+                           true, true);
+  result.num_bits_ = lhs.num_bits_;
+  return result;
+}
+
+roaring_bitmap binary_nand(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs) {
+  if (lhs.size() != rhs.size())
+    return binary_eval<true, false>(lhs, rhs, detail::nand_op{});
+  roaring_bitmap result;
+  result.chunks_ = combine(lhs.chunks_, rhs.chunks_, detail::nand_blocks,
+                           true, false);
+  result.num_bits_ = lhs.num_bits_;
+  return result;
+}
+
+namespace detail {
+
+roaring_bitmap::size_type count_ones(const roaring_bitmap& bm) {
+  auto result = roaring_bitmap::size_type{0};
+  for (auto& x : bm.chunks())
+    result += cardinality(x);
+  return result;
+}
+
+} // namespace detail
+
+} // namespace vast
@@ -1,4 +1,8 @@
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <caf/streambuf.hpp>
 
 #include "vast/error.hpp"
 #include "vast/event.hpp"
@@ -11,40 +15,167 @@
 #include "vast/concept/printable/vast/error.hpp"
 #include "vast/concept/printable/vast/filesystem.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
+#include "vast/detail/assert.hpp"
+#include "vast/detail/byte_swap.hpp"
 
 namespace vast {
 
+namespace {
+
+// The number of bytes of the fixed-size segment header.
+constexpr size_t segment_header_size = 4 + 4 + 16 + 8;
+
+// The number of bytes of a single entry in the batch directory.
+constexpr size_t batch_header_size = 8 * 4;
+
+template <class T>
+void write_integral(std::vector<char>& buf, T x) {
+  x = detail::to_network_order(x);
+  auto ptr = reinterpret_cast<const char*>(&x);
+  buf.insert(buf.end(), ptr, ptr + sizeof(T));
+}
+
+template <class T>
+T read_integral(const char*& ptr) {
+  T x;
+  std::memcpy(&x, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return detail::to_host_order(x);
+}
+
+} // namespace <anonymous>
+
+expected<segment_store::segment>
+segment_store::segment::open(const path& filename) {
+  auto chk = chunk::mmap(filename);
+  if (!chk)
+    return make_error(ec::filesystem_error, "failed to mmap segment",
+                      filename);
+  if (chk->size() < segment_header_size)
+    return make_error(ec::format_error, "truncated segment header");
+  auto ptr = chk->data();
+  if (read_integral<magic_type>(ptr) != magic)
+    return make_error(ec::format_error, "segment magic error");
+  auto v = read_integral<version_type>(ptr);
+  if (v != version)
+    return make_error(ec::version_error, v, version);
+  segment result;
+  std::copy(ptr, ptr + result.id_.size(), result.id_.begin());
+  ptr += result.id_.size();
+  auto n = read_integral<uint64_t>(ptr);
+  // Compare counts rather than byte offsets, because a corrupt count would
+  // overflow the size of the directory.
+  if (n > (chk->size() - segment_header_size) / batch_header_size)
+    return make_error(ec::format_error, "truncated batch directory");
+  result.headers_.resize(n);
+  for (auto& x : result.headers_) {
+    x.first = read_integral<uint64_t>(ptr);
+    x.last = read_integral<uint64_t>(ptr);
+    x.offset = read_integral<uint64_t>(ptr);
+    x.size = read_integral<uint64_t>(ptr);
+    if (x.size > chk->size() || x.offset > chk->size() - x.size)
+      return make_error(ec::format_error, "batch exceeds segment bounds");
+  }
+  result.bytes_ = chk->size();
+  result.chunk_ = std::move(chk);
+  return result;
+}
+
+expected<void> segment_store::segment::write(const path& filename) const {
+  VAST_ASSERT(!chunk_); // Mapped segments exist on disk already.
+  std::ofstream out{filename.str(), std::ios::binary};
+  if (!out)
+    return make_error(ec::filesystem_error, "failed to open file", filename);
+  // Write the batches first, so that we know their location.
+  auto directory = headers_;
+  auto offset = segment_header_size + directory.size() * batch_header_size;
+  out.seekp(offset);
+  std::vector<char> buf;
+  for (auto i = 0u; i < batches_.size(); ++i) {
+    buf.clear();
+    if (auto result = save(buf, batches_[i]); !result)
+      return result.error();
+    out.write(buf.data(), buf.size());
+    directory[i].offset = offset;
+    directory[i].size = buf.size();
+    offset += buf.size();
+  }
+  // Then write header and batch directory.
+  buf.clear();
+  write_integral(buf, magic);
+  write_integral(buf, version);
+  buf.insert(buf.end(), id_.begin(), id_.end());
+  write_integral(buf, static_cast<uint64_t>(directory.size()));
+  for (auto& x : directory) {
+    write_integral(buf, uint64_t{x.first});
+    write_integral(buf, uint64_t{x.last});
+    write_integral(buf, x.offset);
+    write_integral(buf, x.size);
+  }
+  VAST_ASSERT(buf.size()
+              == segment_header_size + directory.size() * batch_header_size);
+  out.seekp(0);
+  out.write(buf.data(), buf.size());
+  if (!out)
+    return make_error(ec::filesystem_error, "failed to write segment",
+                      filename);
+  return no_error;
+}
+
 void segment_store::segment::add(batch&& x) {
-  auto min = select(x.ids(), 1);
-  VAST_ASSERT(min != invalid_event_id);
-  VAST_ASSERT(batches_.find(min) == batches_.end());
+  VAST_ASSERT(!chunk_); // Mapped segments are immutable.
+  auto first = x.first_id();
+  auto last = x.last_id();
+  VAST_ASSERT(first != invalid_event_id);
+  VAST_ASSERT(headers_.empty() || headers_.back().last <= first);
+  headers_.push_back({first, last + 1});
   bytes_ += bytes(x);
-  batches_.emplace(min, std::move(x));
+  batches_.push_back(std::move(x));
 }
 
-// FIXME: this algorithm is not very efficient. It operates in O(MN) time where
-// M is the number of batches and N the size of the bitmap. Conceptually,
-// there's a straight-forward O(log M * N) or even O(N) algorithm by walking
-// through the query bitmap in lock-step with the batches.
 expected<std::vector<event>>
 segment_store::segment::extract(const bitmap& xs) const {
-  auto min = select(xs, 1);
-  auto max = select(xs, -1);
-  // FIXME: what we really want here is detail::range_map, but it's currently
-  // missing lower_bound()/upper_bound() functionality, so we emulate it here.
-  auto begin = batches_.lower_bound(min);
-  if (begin != batches_.begin()
-      && (begin == batches_.end() || begin->first > min))
-    --begin;
-  auto end = batches_.upper_bound(max);
+  // Finds the first batch that ends after a given ID.
+  auto seek = [&](auto begin, event_id id) {
+    return std::lower_bound(begin, headers_.end(), id,
+                            [](auto& x, auto y) { return x.last <= y; });
+  };
   std::vector<event> result;
-  for (; begin != end; ++begin) {
-    batch::reader reader{begin->second};
-    auto events = reader.read(xs);
-    if (!events)
-      return events;
-    result.reserve(result.size() + events->size());
-    std::move(events->begin(), events->end(), std::back_inserter(result));
+  auto ones = select(xs);
+  if (!ones)
+    return result;
+  auto i = seek(headers_.begin(), ones.get());
+  while (ones && i != headers_.end()) {
+    auto id = ones.get();
+    if (id < i->first) {
+      // Bitmap must catch up, batch is ahead.
+      ones.skip(i->first - id);
+    } else if (id < i->last) {
+      // Match: at least one ID falls into the batch. For a mapped segment,
+      // this is the time to deserialize the batch.
+      expected<std::vector<event>> events{std::vector<event>{}};
+      if (chunk_) {
+        batch b;
+        caf::charbuf buf{const_cast<char*>(chunk_->data()) + i->offset,
+                         i->size};
+        if (auto loaded = load(buf, b); !loaded)
+          return loaded.error();
+        batch::reader reader{b};
+        events = reader.read(xs);
+      } else {
+        batch::reader reader{batches_[i - headers_.begin()]};
+        events = reader.read(xs);
+      }
+      if (!events)
+        return events;
+      result.reserve(result.size() + events->size());
+      std::move(events->begin(), events->end(), std::back_inserter(result));
+      ones.skip(i->last - id);
+      ++i;
+    } else {
+      // Batches must catch up, bitmap is ahead.
+      i = seek(i, id);
+    }
   }
   return result;
 }
@@ -59,20 +190,36 @@ uint64_t bytes(const segment_store::segment& x) {
 
 
 segment_store::segment_store(path dir, size_t max_segment_size,
-                             size_t in_memory_segments)
+                             size_t in_memory_segments, batch::encoding layout)
   : dir_{std::move(dir)},
     max_segment_size_{max_segment_size},
+    layout_{layout},
+    meta_{dir_ / "journal"},
     cache_{in_memory_segments} {
   VAST_ASSERT(max_segment_size > 0);
   // Load meta data about existing segments.
-  if (exists(dir_ / "meta"))
-    if (auto result = load(dir_ / "meta", segments_); !result) {
-      // TODO: factor into a separate function and do not do this work in the
-      // constructor.
-      VAST_ERROR("failed to unarchive meta data:", to_string(result.error()));
-      segments_ = {};
-    }
-
+  auto snapshot = [&](const std::vector<char>& buf) {
+    return load(buf, segments_);
+  };
+  auto record = [&](const std::vector<char>& buf) -> expected<void> {
+    uuid id;
+    std::vector<event_id> bounds;
+    if (auto result = load(buf, id, bounds); !result)
+      return result.error();
+    // A record may precede a snapshot that covers it already, in which case
+    // the injection fails.
+    for (auto i = 0u; i + 1 < bounds.size(); i += 2)
+      segments_.inject(bounds[i], bounds[i + 1], id);
+    return no_error;
+  };
+  if (auto result = meta_.replay(snapshot, record); !result) {
+    // TODO: factor into a separate function and do not do this work in the
+    // constructor.
+    VAST_ERROR("failed to unarchive meta data:", to_string(result.error()));
+    segments_ = {};
+  } else if (auto result = import_legacy_meta(); !result) {
+    VAST_ERROR("failed to import meta data:", to_string(result.error()));
+  }
 }
 
 expected<void> segment_store::put(const std::vector<event>& xs) {
@@ -81,7 +228,7 @@ expected<void> segment_store::put(const std::vector<event>& xs) {
   auto non_monotonic = [](auto& x, auto& y) { return x.id() != y.id() - 1; };
   if (std::adjacent_find(xs.begin(), xs.end(), non_monotonic) != xs.end())
     return make_error(ec::unspecified, "got batch with non-monotonic IDs");
-  batch::writer writer{compression::lz4};
+  batch::writer writer{compression::lz4, layout_};
   for (auto& e : xs)
     if (!writer.write(e))
       return make_error(ec::unspecified, "failed to create batch");
@@ -90,10 +237,11 @@ expected<void> segment_store::put(const std::vector<event>& xs) {
   auto last  = xs.back().id();
   b.ids(first, last + 1);
   // If the batch would cause the segment to exceed its maximum size, then
-  // flush and replace the active segment.
+  // seal and replace the active segment.
   if (bytes(active_) >= max_segment_size_) {
     VAST_ASSERT(bytes(active_) != 0); // must not be empty
-    if (auto result = flush(); !result)
+    auto result = writer_ ? seal() : flush();
+    if (!result)
       return result.error();
   }
   // Append batch to active segment.
@@ -102,6 +250,42 @@ expected<void> segment_store::put(const std::vector<event>& xs) {
   return no_error;
 }
 
+void segment_store::write_behind(writer f) {
+  writer_ = std::move(f);
+}
+
+expected<void> segment_store::persisted(const uuid& id,
+                                        expected<void> result) {
+  auto i = sealed_.find(id);
+  VAST_ASSERT(i != sealed_.end());
+  // Upon failure, we keep the segment in memory to continue serving lookups.
+  if (!result)
+    return result.error();
+  // Subsequent lookups map the segment from the file system.
+  auto seg = std::move(i->second);
+  sealed_.erase(i);
+  VAST_DEBUG("wrote sealed segment", id);
+  if (auto result = record(*seg); !result)
+    return result.error();
+  return compact();
+}
+
+size_t segment_store::sealed() const {
+  return sealed_.size();
+}
+
+expected<void> segment_store::seal() {
+  VAST_ASSERT(writer_);
+  if (!exists(dir_))
+    if (auto result = mkdir(dir_); !result)
+      return result.error();
+  auto seg = std::make_shared<const segment>(std::move(active_));
+  active_ = {};
+  sealed_.emplace(seg->id(), seg);
+  writer_(dir_ / to_string(seg->id()), std::move(seg));
+  return no_error;
+}
+
 expected<void> segment_store::flush() {
   if (bytes(active_) == 0)
     return no_error;
@@ -110,17 +294,68 @@ expected<void> segment_store::flush() {
     if (auto result = mkdir(dir_); !result)
       return result.error();
   auto filename = dir_ / to_string(active_.id());
-  auto result = save(filename, segment::magic, segment::version, active_);
-  if (!result)
+  if (auto result = active_.write(filename); !result)
     return result.error();
   // Move active segment into cache.
   auto segment_id = active_.id();
-  cache_.emplace(segment_id, std::move(active_));
+  auto i = cache_.emplace(segment_id, std::move(active_)).first;
   active_ = {};
+  VAST_DEBUG("wrote active segment to", filename.trim(-3));
   // Update persistent meta data.
-  if (auto result = save(dir_ / "meta", segments_); !result)
+  if (auto result = record(i->second); !result)
     return result.error();
-  VAST_DEBUG("wrote active segment to", filename.trim(-3));
+  // Sealed segments get journaled in ::persisted, i.e., only after their
+  // file exists.
+  return compact();
+}
+
+expected<void> segment_store::record(const segment& s) {
+  std::vector<event_id> bounds;
+  bounds.reserve(s.headers_.size() * 2);
+  for (auto& x : s.headers_) {
+    bounds.push_back(x.first);
+    bounds.push_back(x.last);
+  }
+  std::vector<char> buf;
+  if (auto result = save(buf, s.id(), bounds); !result)
+    return result.error();
+  return meta_.append(buf);
+}
+
+expected<void> segment_store::compact() {
+  if (!meta_.needs_compaction())
+    return no_error;
+  return write_snapshot();
+}
+
+expected<void> segment_store::write_snapshot() {
+  // The snapshot must only reference segments that exist on the file system.
+  detail::range_map<event_id, uuid> written;
+  for (auto x : segments_)
+    if (x.value != active_.id() && sealed_.count(x.value) == 0)
+      written.insert(x.left, x.right, x.value);
+  std::vector<char> buf;
+  if (auto result = save(buf, written); !result)
+    return result.error();
+  return meta_.compact(buf);
+}
+
+expected<void> segment_store::import_legacy_meta() {
+  // Older versions kept the meta data in a single file, which we import
+  // once and then remove.
+  auto filename = dir_ / "meta";
+  if (!exists(filename))
+    return no_error;
+  detail::range_map<event_id, uuid> xs;
+  if (auto result = load(filename, xs); !result)
+    return result.error();
+  for (auto x : xs)
+    segments_.inject(x.left, x.right, x.value);
+  if (auto result = write_snapshot(); !result)
+    return result.error();
+  if (!rm(filename))
+    return make_error(ec::filesystem_error, "failed to remove", filename);
+  VAST_INFO("imported meta data from", filename);
   return no_error;
 }
 
@@ -149,12 +384,16 @@ expected<std::vector<event>> segment_store::get(const ids& xs) {
   std::vector<event> result;
   VAST_DEBUG("processing", candidates.size(), "candidates");
   for (auto id = candidates.rbegin(); id != candidates.rend(); ++id) {
-    segment* s = nullptr;
+    const segment* s = nullptr;
     // If the segment turns out to be the active segment, we can
     // can query it immediately.
     if (**id == active_.id()) {
       VAST_DEBUG("looking into active segment");
       s = &active_;
+    } else if (auto j = sealed_.find(**id); j != sealed_.end()) {
+      // Sealed segments remain in memory until they reach the file system.
+      VAST_DEBUG("looking into sealed segment", **id);
+      s = j->second.get();
     } else {
       // Otherwise we look into the cache.
       auto i = cache_.find(**id);
@@ -163,16 +402,10 @@ expected<std::vector<event>> segment_store::get(const ids& xs) {
         s = &i->second;
       } else {
         VAST_DEBUG("got cache miss for segment", **id);
-        segment::magic_type m;
-        segment::version_type v;
-        segment seg;
-        if (auto result = load(dir_ / to_string(**id), m, v, seg); !result)
-          return result.error();
-        if (m != segment::magic)
-          return make_error(ec::unspecified, "segment magic error");
-        if (v < segment::version)
-          return make_error(ec::version_error, v, segment::version);
-        i = cache_.emplace(**id, std::move(seg)).first;
+        auto seg = segment::open(dir_ / to_string(**id));
+        if (!seg)
+          return seg.error();
+        i = cache_.emplace(**id, std::move(*seg)).first;
         s = &i->second;
       }
     }
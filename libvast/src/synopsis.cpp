@@ -0,0 +1,208 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+
+#include "vast/synopsis.hpp"
+
+#include "vast/detail/assert.hpp"
+
+namespace vast {
+namespace {
+
+struct kind_selector {
+  using result_type = synopsis::kind;
+
+  template <class T>
+  result_type operator()(const T&) const {
+    return synopsis::kind::none;
+  }
+
+  result_type operator()(const boolean_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const integer_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const count_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const real_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const timespan_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const timestamp_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const port_type&) const {
+    return synopsis::kind::range;
+  }
+
+  result_type operator()(const string_type&) const {
+    return synopsis::kind::bloom;
+  }
+
+  result_type operator()(const address_type&) const {
+    return synopsis::kind::bloom;
+  }
+
+  result_type operator()(const alias_type& t) const {
+    return visit(*this, t.value_type);
+  }
+};
+
+// Maps a value into the domain in which a range synopsis operates. Ports only
+// contribute their number, because the ordering of port types would make the
+// range incorrectly exclude ports with the same number but another protocol.
+data normalize(const data& x) {
+  if (auto p = get_if<port>(x))
+    return count{p->number()};
+  return x;
+}
+
+bool same_kind(const data& x, const data& y) {
+  auto f = [](const auto& lhs, const auto& rhs) -> bool {
+    using lhs_type = std::decay_t<decltype(lhs)>;
+    using rhs_type = std::decay_t<decltype(rhs)>;
+    return std::is_same<lhs_type, rhs_type>{};
+  };
+  return visit(f, x, y);
+}
+
+// Creates a Bloom filter with the optimal number of cells and hash functions
+// for a given number of elements and false positive probability, i.e.,
+// *m = -n ln p / (ln 2)^2* and *k = m/n ln 2*.
+bloom_filter make_bloom_filter(size_t n, double p) {
+  VAST_ASSERT(n > 0);
+  auto ln2 = std::log(2.0);
+  auto m = std::ceil(-static_cast<double>(n) * std::log(p) / (ln2 * ln2));
+  auto k = std::max(1.0, std::round(m / n * ln2));
+  return {static_cast<bloom_filter::size_type>(m),
+          static_cast<bloom_filter::size_type>(k)};
+}
+
+template <class Container>
+bool any_equal(const synopsis& syn, const Container& xs) {
+  for (auto& x : xs)
+    if (syn.lookup(equal, x))
+      return true;
+  return false;
+}
+
+} // namespace <anonymous>
+
+synopsis::synopsis(const type& t, size_t capacity)
+  : kind_{visit(kind_selector{}, t)} {
+  if (kind_ == kind::bloom)
+    bloom_ = make_bloom_filter(capacity, bloom_filter_fp_rate);
+}
+
+bool synopsis::supports(const type& t) {
+  return visit(kind_selector{}, t) != kind::none;
+}
+
+void synopsis::add(const data& x) {
+  if (is<none>(x))
+    return;
+  switch (kind_) {
+    case kind::none:
+      break;
+    case kind::range: {
+      auto y = normalize(x);
+      if (is<none>(min_)) {
+        min_ = y;
+        max_ = std::move(y);
+      } else if (!same_kind(y, min_)) {
+        // We cannot order values of different types, so we give up on ruling
+        // out predicates.
+        kind_ = kind::none;
+        min_ = max_ = nil;
+      } else if (y < min_) {
+        min_ = std::move(y);
+      } else if (max_ < y) {
+        max_ = std::move(y);
+      }
+      break;
+    }
+    case kind::bloom:
+      bloom_.add(std::hash<data>{}(x));
+      break;
+  }
+}
+
+bool synopsis::lookup(relational_operator op, const data& x) const {
+  if (kind_ == kind::none || is<none>(x))
+    return true;
+  if (op == in) {
+    if (auto xs = get_if<vector>(x))
+      return any_equal(*this, *xs);
+    if (auto xs = get_if<set>(x))
+      return any_equal(*this, *xs);
+    return true;
+  }
+  switch (kind_) {
+    default:
+      return true;
+    case kind::range: {
+      // Without any value, no predicate can have a hit.
+      if (is<none>(min_))
+        return false;
+      auto y = normalize(x);
+      if (!same_kind(y, min_))
+        return true;
+      switch (op) {
+        default:
+          return true;
+        case equal:
+          return min_ <= y && y <= max_;
+        case not_equal:
+          return !(min_ == y && max_ == y);
+        case less:
+          return min_ < y;
+        case less_equal:
+          return min_ <= y;
+        case greater:
+          return max_ > y;
+        case greater_equal:
+          return max_ >= y;
+      }
+    }
+    case kind::bloom:
+      if (op == equal)
+        return bloom_.lookup(std::hash<data>{}(x));
+      return true;
+  }
+}
+
+size_t synopsis::memusage() const {
+  return sizeof(*this) - sizeof(bloom_) + bloom_.memusage();
+}
+
+bool operator==(const synopsis& x, const synopsis& y) {
+  return x.kind_ == y.kind_ && x.min_ == y.min_ && x.max_ == y.max_
+    && x.bloom_ == y.bloom_;
+}
+
+} // namespace vast
@@ -19,6 +19,7 @@
 #include "vast/segment_store.hpp"
 
 #include "vast/concept/printable/stream.hpp"
+#include "vast/concept/printable/vast/uuid.hpp"
 
 #include "vast/system/archive.hpp"
 
@@ -29,21 +30,88 @@ using std::chrono::duration_cast;
 using std::chrono::microseconds;
 using namespace caf;
 
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(vast::segment_store::segment_ptr)
+
 namespace vast::system {
 
+namespace {
+
+// Writes sealed segments on its own thread, in order of arrival.
+behavior segment_writer(event_based_actor* self) {
+  return {
+    [=](persist_atom, const path& filename,
+        const segment_store::segment_ptr& seg) -> result<ok_atom> {
+      if (auto result = seg->write(filename); !result)
+        return result.error();
+      return ok_atom::value;
+    },
+    [=](flush_atom) {
+      // Answering in order of arrival signals that all prior writes are done.
+      return ok_atom::value;
+    },
+    [=](shutdown_atom) {
+      self->quit();
+    }
+  };
+}
+
+} // namespace <anonymous>
+
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self,
-        path dir, size_t capacity, size_t max_segment_size) {
+        path dir, size_t capacity, size_t max_segment_size,
+        batch::encoding layout) {
   // TODO: make the choice of store configurable. For most flexibility, it
   // probably makes sense to pass a unique_ptr<stor> directory to the spawn
   // arguments of the actor. This way, users can provide their own store
   // implementation conveniently.
   self->state.store = std::make_unique<segment_store>(dir, max_segment_size,
-                                                      capacity);
+                                                      capacity, layout);
+  self->state.writer = self->spawn<detached>(segment_writer);
+  auto persisted = [=](const uuid& id, expected<void> result) {
+    if (auto done = self->state.store->persisted(id, std::move(result));
+        !done) {
+      VAST_ERROR(self, "failed to write segment", id << ':',
+                 self->system().render(done.error()));
+      self->quit(done.error());
+    }
+  };
+  self->state.store->write_behind(
+    [=](path filename, segment_store::segment_ptr seg) {
+      auto id = seg->id();
+      VAST_DEBUG(self, "hands segment", id, "to I/O worker");
+      auto rp = self->request(self->state.writer, infinite,
+                              persist_atom::value, std::move(filename),
+                              std::move(seg));
+      auto on_success = [=](ok_atom) { persisted(id, no_error); };
+      auto on_error = [=](error& e) { persisted(id, std::move(e)); };
+      // Within the bound, we continue to serve lookups and accept new
+      // batches while the write proceeds. Beyond it, we exert backpressure
+      // by leaving all further messages in our mailbox until the I/O worker
+      // has written the segment.
+      if (self->state.store->sealed() < self->state.max_sealed)
+        rp.then(on_success, on_error);
+      else
+        rp.await(on_success, on_error);
+    }
+  );
   self->set_exit_handler(
     [=](const exit_msg& msg) {
       self->state.store->flush();
-      self->quit(msg.reason);
+      // The I/O worker processes its mailbox in order, so it answers the
+      // flush only after having written all pending segments. Their
+      // completions arrive first and journal the segments.
+      auto reason = msg.reason;
+      self->request(self->state.writer, infinite, flush_atom::value).then(
+        [=](ok_atom) {
+          self->anon_send(self->state.writer, shutdown_atom::value);
+          self->quit(reason);
+        },
+        [=](error& e) {
+          self->anon_send(self->state.writer, shutdown_atom::value);
+          self->quit(std::move(e));
+        }
+      );
     }
   );
   return {
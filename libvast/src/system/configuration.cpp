@@ -31,6 +31,7 @@
 #include "vast/error.hpp"
 #include "vast/event.hpp"
 #include "vast/expression.hpp"
+#include "vast/filesystem.hpp"
 #include "vast/operator.hpp"
 #include "vast/query_options.hpp"
 #include "vast/schema.hpp"
@@ -63,6 +64,7 @@ configuration::configuration() {
   add_message_type<data>("vast::data");
   add_message_type<event>("vast::event");
   add_message_type<expression>("vast::expression");
+  add_message_type<path>("vast::path");
   add_message_type<query_options>("vast::query_options");
   add_message_type<relational_operator>("vast::relational_operator");
   add_message_type<schema>("vast::schema");
@@ -70,7 +72,9 @@ configuration::configuration() {
   add_message_type<timespan>("vast::timespan");
   add_message_type<uuid>("vast::uuid");
   // Containers
+  add_message_type<std::vector<data>>("std::vector<vast::data>");
   add_message_type<std::vector<event>>("std::vector<vast::event>");
+  add_message_type<std::vector<event_id>>("std::vector<uint64_t>");
   // Actor-specific messages
   add_message_type<component_map>("vast::system::component_map");
   add_message_type<component_map_entry>("vast::system::component_map_entry");
@@ -11,6 +11,7 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <algorithm>
 #include <deque>
 #include <unordered_set>
 
@@ -20,14 +21,17 @@
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/expression.hpp"
 #include "vast/concept/printable/vast/error.hpp"
+#include "vast/concept/printable/vast/filesystem.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
 #include "vast/detail/assert.hpp"
+#include "vast/error.hpp"
 #include "vast/event.hpp"
 #include "vast/expression_visitors.hpp"
 #include "vast/json.hpp"
 #include "vast/load.hpp"
 #include "vast/logger.hpp"
 #include "vast/save.hpp"
+#include "vast/synopsis.hpp"
 
 #include "vast/system/accountant.hpp"
 #include "vast/system/index.hpp"
@@ -42,7 +46,97 @@ using namespace caf;
 namespace vast {
 namespace system {
 
-void partition_index::add(const std::vector<event> xs, const uuid& partition) {
+namespace {
+
+// Tests whether a type has a "skip" attribute.
+bool skip(const type& t) {
+  auto& attrs = t.attributes();
+  auto pred = [](auto& x) { return x.key == "skip"; };
+  return std::find_if(attrs.begin(), attrs.end(), pred) != attrs.end();
+}
+
+// Creates the synopses for all fields of a type that support one.
+partition_index::type_synopsis make_synopses(const type& t,
+                                              size_t capacity) {
+  partition_index::type_synopsis result;
+  if (skip(t))
+    return result;
+  if (auto r = get_if<record_type>(t)) {
+    for (auto& f : record_type::each{*r}) {
+      auto& value_type = f.trace.back()->type;
+      if (!skip(value_type) && synopsis::supports(value_type))
+        result.emplace(f.offset, synopsis{value_type, capacity});
+    }
+  } else if (synopsis::supports(t)) {
+    result.emplace(offset{}, synopsis{t, capacity});
+  }
+  return result;
+}
+
+// Evaluates an expression that has been resolved for a given type over the
+// synopses of that type. The visitor returns `false` only if the synopses
+// rule out that any event of the type matches the expression.
+struct synopsis_evaluator {
+  synopsis_evaluator(const type& t, const partition_index::type_synopsis& xs)
+    : type_{t},
+      synopses_{xs} {
+    // nop
+  }
+
+  bool operator()(none) {
+    // The expression did not resolve for this type.
+    return false;
+  }
+
+  bool operator()(const conjunction& c) {
+    for (auto& op : c)
+      if (!visit(*this, op))
+        return false;
+    return true;
+  }
+
+  bool operator()(const disjunction& d) {
+    for (auto& op : d)
+      if (visit(*this, op))
+        return true;
+    return false;
+  }
+
+  bool operator()(const negation&) {
+    // A synopsis cannot rule out the complement of a predicate.
+    return true;
+  }
+
+  bool operator()(const predicate& p) {
+    op_ = p.op;
+    return visit(*this, p.lhs, p.rhs);
+  }
+
+  bool operator()(const attribute_extractor& ex, const data& d) {
+    if (ex.attr == "type")
+      return evaluate(type_.name(), op_, d);
+    return true; // The time_restrictor takes care of the time attribute.
+  }
+
+  bool operator()(const data_extractor& dx, const data& d) {
+    auto i = synopses_.find(dx.offset);
+    return i == synopses_.end() || i->second.lookup(op_, d);
+  }
+
+  template <class T, class U>
+  bool operator()(const T&, const U&) {
+    return true;
+  }
+
+  const type& type_;
+  const partition_index::type_synopsis& synopses_;
+  relational_operator op_;
+};
+
+} // namespace <anonymous>
+
+size_t partition_index::add(const std::vector<event> xs,
+                            const uuid& partition, size_t capacity) {
   // Compute span of events.
   auto bound = [](const interval& a, const interval& b) -> interval {
     return {std::min(a.from, b.from), std::max(a.to, b.to)};
@@ -55,13 +149,87 @@ void partition_index::add(const std::vector<event> xs, const uuid& partition) {
   // Update index.
   auto& x = partitions_[partition];
   x.range = bound(x.range, result);
+  // Update the field synopses. Since batches typically consist of long runs
+  // of events with the same type, we only look up the synopses when the type
+  // changes.
+  const type* current = nullptr;
+  type_synopsis* synopses = nullptr;
+  size_t bytes = 0;
+  for (auto& e : xs) {
+    if (current == nullptr || e.type() != *current) {
+      current = &e.type();
+      auto i = x.types.find(e.type());
+      if (i == x.types.end()) {
+        auto ts = make_synopses(e.type(), capacity);
+        for (auto& syn : ts)
+          bytes += syn.second.memusage();
+        i = x.types.emplace(e.type(), std::move(ts)).first;
+      }
+      synopses = &i->second;
+    }
+    if (synopses->empty())
+      continue;
+    auto v = get_if<vector>(e.data());
+    for (auto& [off, syn] : *synopses) {
+      if (off.empty())
+        syn.add(e.data());
+      else if (v != nullptr)
+        if (auto y = get(*v, off))
+          syn.add(*y);
+    }
+  }
+  return bytes;
+}
+
+void partition_index::add(const uuid& partition, partition_synopsis ps) {
+  partitions_[partition] = std::move(ps);
+}
+
+const partition_index::partition_synopsis*
+partition_index::find(const uuid& partition) const {
+  auto i = partitions_.find(partition);
+  return i != partitions_.end() ? &i->second : nullptr;
+}
+
+size_t partition_index::size() const {
+  return partitions_.size();
+}
+
+size_t partition_index::memusage() const {
+  size_t result = 0;
+  for (auto& [id, ps] : partitions_)
+    for (auto& [t, synopses] : ps.types)
+      for (auto& syn : synopses)
+        result += syn.second.memusage();
+  return result;
 }
 
 std::vector<uuid> partition_index::lookup(const expression& expr) const {
+  // Resolve the expression once per type instead of once per partition.
+  std::unordered_map<type, optional<expression>> resolved;
+  auto resolve = [&](const type& t) -> const optional<expression>& {
+    auto i = resolved.find(t);
+    if (i == resolved.end()) {
+      optional<expression> x;
+      if (auto r = visit(type_resolver{t}, expr))
+        x = std::move(*r);
+      i = resolved.emplace(t, std::move(x)).first;
+    }
+    return i->second;
+  };
   std::vector<uuid> result;
-  for (auto& x : partitions_)
-    if (visit(time_restrictor{x.second.range.from, x.second.range.to}, expr))
-      result.push_back(x.first);
+  for (auto& [id, ps] : partitions_) {
+    if (!visit(time_restrictor{ps.range.from, ps.range.to}, expr))
+      continue;
+    auto qualifies = [&](auto& x) {
+      auto& r = resolve(x.first);
+      return r && visit(synopsis_evaluator{x.first, x.second}, *r);
+    };
+    // Partitions without type information cannot be ruled out.
+    if (ps.types.empty()
+        || std::any_of(ps.types.begin(), ps.types.end(), qualifies))
+      result.push_back(id);
+  }
   return result;
 }
 
@@ -69,16 +237,138 @@ namespace {
 
 // -- scheduling --------------------------------------------------------------
 
+// Marks a partition as most recently used.
+void touch(stateful_actor<index_state>* self, const uuid& part) {
+  self->state.last_access[part] = ++self->state.clock;
+}
+
+// Computes the memory footprint of the loaded partitions and all synopses.
+uint64_t total_memory(stateful_actor<index_state>* self) {
+  return self->state.memory + self->state.synopsis_memory;
+}
+
+// Checks whether the loaded partitions and synopses exceed the memory budget.
+bool over_budget(stateful_actor<index_state>* self) {
+  return self->state.max_memory > 0
+         && total_memory(self) > self->state.max_memory;
+}
+
+// Checks whether we can load another partition without evicting one first.
+// Even when over budget, we must be able to load a partition when there are
+// none left to evict.
+bool has_room(stateful_actor<index_state>* self) {
+  auto& st = self->state;
+  return st.scheduled.empty() && st.loaded.size() < st.capacity
+         && (!over_budget(self) || st.loaded.empty());
+}
+
+// Forgets the memory footprint of a partition that went away.
+void release(stateful_actor<index_state>* self, const actor& part) {
+  self->state.retiring.erase(part);
+  auto i = self->state.memusage.find(part);
+  if (i != self->state.memusage.end()) {
+    self->state.memory -= i->second;
+    self->state.memusage.erase(i);
+  }
+}
+
+// -- persistence -------------------------------------------------------------
+
+// Replaces the meta data journal with a snapshot of the partition index.
+expected<void> write_snapshot(stateful_actor<index_state>* self) {
+  VAST_DEBUG(self, "compacts partition index journal");
+  std::vector<char> buf;
+  if (auto result = save(buf, self->state.part_index); !result)
+    return result.error();
+  return self->state.meta.compact(buf);
+}
+
+// Appends the summary of a partition to the meta data journal. Since a record
+// costs only as much as a single partition summary, we can afford one each
+// time a partition fills up, so that a crash loses no more than the summary
+// of the active partition.
+expected<void> persist(stateful_actor<index_state>* self, const uuid& part) {
+  auto& st = self->state;
+  auto ps = st.part_index.find(part);
+  if (ps == nullptr)
+    return no_error;
+  std::vector<char> buf;
+  if (auto result = save(buf, part, *ps); !result)
+    return result.error();
+  if (auto result = st.meta.append(buf); !result)
+    return result.error();
+  if (!st.meta.needs_compaction())
+    return no_error;
+  return write_snapshot(self);
+}
+
+// Moves the partition index file of older versions into the journal. Its
+// summaries lack synopses, so that lookups consider these partitions for
+// every query within their time range.
+expected<void> import_legacy_meta(stateful_actor<index_state>* self) {
+  auto filename = self->state.dir / "meta";
+  if (!exists(filename))
+    return no_error;
+  std::unordered_map<uuid, partition_index::interval> ranges;
+  if (auto result = load(filename, ranges); !result)
+    return result.error();
+  for (auto& [id, range] : ranges)
+    self->state.part_index.add(id, {range, {}});
+  if (auto result = write_snapshot(self); !result)
+    return result.error();
+  if (!rm(filename))
+    return make_error(ec::filesystem_error, "failed to remove", filename);
+  VAST_INFO(self, "imported partition index from", filename);
+  return no_error;
+}
+
+// Ships the partition cache counters to the accountant.
+void report_statistics(stateful_actor<index_state>* self) {
+  if (!self->state.accountant)
+    return;
+  auto& stats = self->state.stats;
+  self->send(self->state.accountant, "index.partitions.hits", stats.hits);
+  self->send(self->state.accountant, "index.partitions.misses", stats.misses);
+  self->send(self->state.accountant, "index.partitions.evictions",
+             stats.evictions);
+  self->send(self->state.accountant, "index.partitions.prefetches",
+             stats.prefetches);
+  self->send(self->state.accountant, "index.memory", total_memory(self));
+  self->send(self->state.accountant, "index.synopses.memory",
+             self->state.synopsis_memory);
+}
+
+// Evicts the loaded partition that is cheapest to lose. We prefer partitions
+// that fewer lookups will request in the future and break ties by picking
+// the least recently used one.
 void evict(stateful_actor<index_state>* self) {
-  // TODO: pick the LRU partition, not just a random one.
-  for (auto& x : self->state.loaded) {
-    if (self->state.evicted.count(x.second) == 0) {
-      VAST_DEBUG(self, "evicts partition", x.first);
-      self->send(x.second, shutdown_atom::value);
-      self->state.evicted.emplace(x.second, x.first);
-      break;
+  auto& st = self->state;
+  auto pending = [&](const uuid& part) {
+    auto n = size_t{0};
+    for (auto& x : st.lookups)
+      n += std::count(x.second.partitions.begin(), x.second.partitions.end(),
+                      part);
+    return n;
+  };
+  auto victim = st.loaded.end();
+  auto victim_cost = std::pair<size_t, uint64_t>{};
+  for (auto i = st.loaded.begin(); i != st.loaded.end(); ++i) {
+    if (st.evicted.count(i->second) > 0)
+      continue;
+    auto cost = std::make_pair(pending(i->first), st.last_access[i->first]);
+    if (victim == st.loaded.end() || cost < victim_cost) {
+      victim = i;
+      victim_cost = cost;
     }
   }
+  if (victim == st.loaded.end()) {
+    VAST_DEBUG(self, "found no partition to evict");
+    return;
+  }
+  VAST_DEBUG(self, "evicts partition", victim->first);
+  self->send(victim->second, shutdown_atom::value);
+  st.evicted.emplace(victim->second, victim->first);
+  ++st.stats.evictions;
 }
 
 // FIXME: erase lookups that have completed.
@@ -88,23 +378,31 @@ void schedule(stateful_actor<index_state>* self, const uuid& part,
   // If we're dealing with the active partition, we dispatch immediately.
   if (part == self->state.active.id) {
     VAST_DEBUG(self, "dispatches to active partition", part);
+    ++self->state.stats.hits;
     send_as(ctx.sink, self->state.active.partition, ctx.expr);
     return;
   }
-  // If the partition is loaded, we can also dispatch immediately.
+  // If the partition is loaded, we can also dispatch immediately, unless
+  // it's on its way out. Then we must wait and reload it.
   auto l = self->state.loaded.find(part);
-  if (l != self->state.loaded.end()) {
+  if (l != self->state.loaded.end()
+      && self->state.evicted.count(l->second) == 0) {
     VAST_DEBUG(self, "dispatches to loaded partition", part);
+    ++self->state.stats.hits;
+    touch(self, part);
     send_as(ctx.sink, l->second, ctx.expr);
     return;
   }
+  ++self->state.stats.misses;
   // If we have enough room, we can spin up the next partition.
-  if (self->state.loaded.size() < self->state.capacity) {
-    VAST_ASSERT(self->state.scheduled.empty());
+  if (l == self->state.loaded.end() && has_room(self)) {
     VAST_DEBUG(self, "spawns and dispatches partition", part);
     auto part_dir = self->state.dir / to_string(part);
-    auto p = self->spawn<monitored>(partition, std::move(part_dir));
+    auto p = self->spawn<monitored>(partition, std::move(part_dir),
+                                    self->state.pool, self->state.cache_size,
+                                    actor_cast<actor>(self));
     self->state.loaded.emplace(part, p);
+    touch(self, part);
     send_as(ctx.sink, p, ctx.expr);
     return;
   }
@@ -114,11 +412,40 @@ void schedule(stateful_actor<index_state>* self, const uuid& part,
                         self->state.scheduled.end(),
                         [&](auto& x) { return x.id == part; });
   if (i != self->state.scheduled.end()) {
-    VAST_ASSERT(!self->state.evicted.empty());
     i->lookups.insert(lookup);
-  } else {
-    self->state.scheduled.push_back({part, {lookup}});
+    return;
+  }
+  self->state.scheduled.push_back({part, {lookup}});
+  // A partition on its way out takes over its own slot once the eviction
+  // completes, so we must not evict another one.
+  if (l == self->state.loaded.end())
     evict(self);
+}
+
+// Uses free partition slots to load the partitions that lookups will ask
+// for next, so that subsequent requests for more hits find them warm. We
+// never evict a partition for the sake of prefetching, nor exceed the
+// memory budget, and look at most *n* partitions ahead per lookup.
+void prefetch(stateful_actor<index_state>* self, size_t n) {
+  auto& st = self->state;
+  for (auto& [id, ctx] : st.lookups) {
+    auto m = std::min(ctx.partitions.size(), n);
+    for (auto i = ctx.partitions.rbegin(); i != ctx.partitions.rbegin() + m;
+         ++i) {
+      if (!has_room(self))
+        return;
+      if (*i == st.active.id || st.loaded.count(*i) > 0)
+        continue;
+      VAST_DEBUG(self, "prefetches partition", *i, "for lookup", id);
+      auto part_dir = st.dir / to_string(*i);
+      auto p = self->spawn<monitored>(partition, std::move(part_dir),
+                                      self->state.pool, self->state.cache_size,
+                                      actor_cast<actor>(self));
+      st.loaded.emplace(*i, p);
+      touch(self, *i);
+      ++st.stats.prefetches;
+      self->send(p, load_atom::value, ctx.expr);
+    }
   }
 }
 
@@ -127,23 +454,34 @@ void unschedule(stateful_actor<index_state>* self, const actor& part) {
   // Check if we got an evicted partition.
   auto i = self->state.evicted.find(part);
   if (i != self->state.evicted.end()) {
-    VAST_DEBUG(self, "completed eviction of partition", i->second);
-    self->state.loaded.erase(i->second);
+    auto evicted = i->second;
+    VAST_DEBUG(self, "completed eviction of partition", evicted);
+    self->state.loaded.erase(evicted);
+    self->state.last_access.erase(evicted);
     self->state.evicted.erase(i);
-    // Fill the hole if we have scheduled partition.
+    // Fill the hole if we have scheduled partition, preferring the evicted
+    // partition itself when lookups are waiting for it.
     if (!self->state.scheduled.empty()) {
-      auto& next = self->state.scheduled.front();
+      auto j = std::find_if(self->state.scheduled.begin(),
+                            self->state.scheduled.end(),
+                            [&](auto& x) { return x.id == evicted; });
+      if (j == self->state.scheduled.end())
+        j = self->state.scheduled.begin();
+      auto next = std::move(*j);
+      self->state.scheduled.erase(j);
       VAST_DEBUG(self, "spawns next partition", next.id);
       auto part_dir = self->state.dir / to_string(next.id);
-      auto p = self->spawn<monitored>(partition, std::move(part_dir));
+      auto p = self->spawn<monitored>(partition, std::move(part_dir),
+                                      self->state.pool, self->state.cache_size,
+                                      actor_cast<actor>(self));
       self->state.loaded.emplace(next.id, p);
+      touch(self, next.id);
       for (auto& id : next.lookups) {
         VAST_ASSERT(self->state.lookups.count(id) > 0);
         auto& ctx = self->state.lookups[id];
         VAST_DEBUG(self, "dispatches expression", ctx.expr);
         send_as(ctx.sink, p, ctx.expr);
       }
-      self->state.scheduled.pop_front();
       // If we have more pending partitions, try to evict more.
       if (self->state.scheduled.size() > self->state.evicted.size())
         evict(self);
@@ -154,26 +492,49 @@ void unschedule(stateful_actor<index_state>* self, const actor& part) {
 } // namespace <anonymous>
 
 behavior index(stateful_actor<index_state>* self, const path& dir,
-               size_t max_events, size_t max_parts, size_t taste_parts) {
+               size_t max_events, size_t max_parts, size_t taste_parts,
+               size_t max_memory, size_t workers, size_t cache_size) {
   VAST_ASSERT(max_events > 0);
   VAST_ASSERT(max_parts > 0);
   VAST_DEBUG(self, "caps partitions at", max_events, "events");
   VAST_DEBUG(self, "keeps at most", max_parts, "partitions in memory");
+  VAST_DEBUG(self, "limits index memory to", max_memory,
+             "bytes (0 = unlimited)");
   self->state.capacity = max_parts;
+  self->state.max_memory = max_memory;
   self->state.dir = dir;
-  auto accountant = accountant_type{};
+  self->state.pool = std::make_shared<detail::work_stealing_pool>(workers);
+  self->state.cache_size = cache_size;
+  VAST_DEBUG(self, "builds value indexes on",
+             self->state.pool->workers(), "threads");
   if (auto a = self->system().registry().get(accountant_atom::value))
-    accountant = actor_cast<accountant_type>(a);
+    self->state.accountant = actor_cast<accountant_type>(a);
   // Read persistent state.
-  if (exists(self->state.dir / "meta")) {
-    auto result = load(self->state.dir / "meta", self->state.part_index);
-    if (!result) {
-      VAST_ERROR(self, "failed to load partition index:",
-                 self->system().render(result.error()));
-      self->quit(result.error());
-      return {};
-    }
+  self->state.meta = journal{dir / "journal"};
+  auto snapshot = [=](const std::vector<char>& buf) {
+    return load(buf, self->state.part_index);
+  };
+  auto record = [=](const std::vector<char>& buf) -> expected<void> {
+    uuid id;
+    partition_index::partition_synopsis ps;
+    if (auto result = load(buf, id, ps); !result)
+      return result.error();
+    self->state.part_index.add(id, std::move(ps));
+    return no_error;
+  };
+  if (auto result = self->state.meta.replay(snapshot, record); !result) {
+    VAST_ERROR(self, "failed to load partition index:",
+               self->system().render(result.error()));
+    self->quit(result.error());
+    return {};
+  }
+  if (auto result = import_legacy_meta(self); !result) {
+    VAST_ERROR(self, "failed to import partition index:",
+               self->system().render(result.error()));
+    self->quit(result.error());
+    return {};
   }
+  self->state.synopsis_memory = self->state.part_index.memusage();
   self->set_exit_handler(
     [=](const exit_msg& msg) {
       auto can_terminate = [=] {
@@ -204,16 +565,7 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
       // Save our own state only if we have written something.
       if (self->state.active.partition) {
         VAST_DEBUG(self, "persists partition index");
-        if (!exists(self->state.dir)) {
-          auto result = mkdir(self->state.dir);
-          if (!result) {
-            VAST_ERROR(self, self->system().render(result.error()));
-            self->quit(result.error());
-            return;
-          }
-        }
-        auto result = save(self->state.dir / "meta",
-                           self->state.part_index);
+        auto result = persist(self, self->state.active.id);
         if (!result) {
           VAST_ERROR(self, "failed to persist partition index:",
                      self->system().render(result.error()));
@@ -243,9 +595,15 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
         VAST_IGNORE_UNUSED(n);
         VAST_DEBUG(self, "erases", n, "scheduled lookups");
         self->state.scheduled.erase(j, self->state.scheduled.end());
+        // Nobody will ask for the remaining partitions anymore, so neither
+        // prefetching nor eviction should consider them.
+        i->second.partitions.clear();
       } else {
         // A partition went down.
-        unschedule(self, actor_cast<actor>(msg.source));
+        auto part = actor_cast<actor>(msg.source);
+        release(self, part);
+        unschedule(self, part);
+        prefetch(self, taste_parts);
       }
     }
   );
@@ -254,31 +612,69 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
       VAST_DEBUG(self, "got", events.size(), "events ["
                  << events.front().id() << ',' << (events.back().id() + 1)
                  << ')');
+      // When we exceed the memory budget even though there is no passive
+      // partition left, the active partition must go. As long as passive
+      // partitions remain, evicting them makes room instead.
+      auto memory_exhausted = over_budget(self) && self->state.loaded.empty();
       auto partition_full = self->state.active.events > 0
-        && self->state.active.events + events.size() > max_events;
+        && (self->state.active.events + events.size() > max_events
+            || memory_exhausted);
       if (partition_full || !self->state.active.partition) {
         if (partition_full) {
           VAST_DEBUG(self, "encountered full partition");
-          if (self->state.loaded.size() == self->state.capacity) {
+          if (auto result = persist(self, self->state.active.id); !result) {
+            VAST_ERROR(self, "failed to persist partition index:",
+                       self->system().render(result.error()));
+            self->quit(result.error());
+            return;
+          }
+          if (memory_exhausted
+              || self->state.loaded.size() == self->state.capacity) {
             VAST_DEBUG(self, "evicts active partition");
+            // The partition still flushes its indexes before going down, but
+            // its memory is as good as free.
+            release(self, self->state.active.partition);
+            self->state.retiring.insert(self->state.active.partition);
             self->send(self->state.active.partition, shutdown_atom::value);
           } else {
             VAST_DEBUG(self, "moves active partition to cache");
+            // The partition receives no more events and may cache hits.
+            self->send(self->state.active.partition, seal_atom::value);
             self->state.loaded.emplace(self->state.active.id,
                                        self->state.active.partition);
+            touch(self, self->state.active.id);
           }
         }
         auto id = uuid::random();
         VAST_DEBUG(self, "spawns new active partition", id);
         auto part_dir = self->state.dir / to_string(id);
-        auto part = self->spawn<monitored>(partition, part_dir);
+        auto part = self->spawn<monitored>(partition, part_dir,
+                                           self->state.pool,
+                                           self->state.cache_size,
+                                           actor_cast<actor>(self));
         self->state.active = {id, part, 0};
       }
       self->state.active.events += events.size();
-      self->state.part_index.add(events, self->state.active.id);
+      self->state.synopsis_memory += self->state.part_index.add(
+        events, self->state.active.id, max_events);
       auto msg = self->current_mailbox_element()->move_content_to_message();
       self->send(self->state.active.partition, msg);
     },
+    [=](memory_atom, int64_t delta) {
+      auto part = actor_cast<actor>(self->current_sender());
+      if (self->state.retiring.count(part) > 0)
+        return;
+      self->state.memusage[part] += delta;
+      self->state.memory += delta;
+      // Make room for the budget by evicting passive partitions, one at a
+      // time to avoid evicting more than necessary.
+      if (over_budget(self) && self->state.evicted.empty()) {
+        VAST_DEBUG(self, "exceeds memory budget:",
+                   total_memory(self) << '/' << self->state.max_memory,
+                   "bytes");
+        evict(self);
+      }
+    },
     [=](const expression& expr) -> result<uuid, size_t, size_t> {
       auto sender = actor_cast<actor>(self->current_sender());
       VAST_DEBUG(self, "got lookup:", expr);
@@ -305,6 +701,8 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
         schedule(self, *i, id);
       partitions.resize(partitions.size() - n);
       ctx.first->second.partitions = std::move(partitions);
+      prefetch(self, taste_parts);
+      report_statistics(self);
       return {id, num_partitions, n};
     },
     [=](const uuid& id, size_t n) {
@@ -320,6 +718,8 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
       for (auto i = ctx.partitions.end() - n; i != ctx.partitions.end(); ++i)
         schedule(self, *i, id);
       ctx.partitions.resize(ctx.partitions.size() - n);
+      prefetch(self, taste_parts);
+      report_statistics(self);
     },
   };
 }
@@ -11,6 +11,7 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+
 #include <caf/all.hpp>
 
 #include "vast/concept/parseable/to.hpp"
@@ -24,10 +25,10 @@
 #include "vast/expression.hpp"
 #include "vast/expression_visitors.hpp"
 #include "vast/filesystem.hpp"
-#include "vast/load.hpp"
+#include "vast/ids.hpp"
 #include "vast/logger.hpp"
+#include "vast/mapped_serialization.hpp"
 #include "vast/offset.hpp"
-#include "vast/save.hpp"
 #include "vast/value_index.hpp"
 
 #include "vast/system/atoms.hpp"
@@ -37,139 +38,125 @@ using namespace caf;
 
 namespace vast {
 namespace system {
-namespace {
 
-struct value_indexer_state {
+// A value index along with the strand that serializes all operations on it.
+// Only tasks on the strand may access the members other than the strand.
+struct column_index {
+  column_index(path filename, vast::type t, detail::work_stealing_pool& pool)
+    : filename{std::move(filename)},
+      type{std::move(t)},
+      strand{pool.make_strand()} {
+    // nop
+  }
+
   path filename;
   vast::type type;
   std::unique_ptr<value_index> idx;
   value_index::size_type last_flush = 0;
-  static inline const char* name = "value-indexer";
+  size_t memusage = 0;
+  std::shared_ptr<detail::work_stealing_pool::strand> strand;
 };
 
-// Wraps a value index into an actor.
-template <class Extract>
-behavior value_indexer(stateful_actor<value_indexer_state>* self,
-                       path filename, type index_type, Extract extract) {
-  self->state.type = std::move(index_type);
-  self->state.filename = std::move(filename);
-  if (exists(self->state.filename)) {
-    // Materialize the index when encountering persistent state.
-    detail::value_index_inspect_helper tmp{self->state.type, self->state.idx};
-    auto result = load(self->state.filename, self->state.last_flush, tmp);
-    if (!result) {
-      VAST_ERROR(self, "failed to load bitmap index:",
-                 self->system().render(result.error()));
-      self->quit(result.error());
-    } else {
-      VAST_DEBUG(self, "loaded value index with offset",
-                 self->state.idx->offset());
-    }
-  } else {
-    // Otherwise construct a new one.
-    self->state.idx = value_index::make(self->state.type);
-    if (!self->state.idx)
-      self->quit(make_error(ec::unspecified, "failed to construct index"));
+namespace {
+
+// -- tasks on the pool -------------------------------------------------------
+
+// The tasks report back to the event indexer via messages, because only
+// the actor itself may touch its state.
+
+// Computes how much the memory footprint of an index changed.
+int64_t update_memusage(column_index& col) {
+  if (!col.idx)
+    return 0;
+  auto memusage = col.idx->memusage();
+  auto delta = static_cast<int64_t>(memusage)
+               - static_cast<int64_t>(col.memusage);
+  col.memusage = memusage;
+  return delta;
+}
+
+// Materializes an index from persistent state or constructs a new one. The
+// bitmaps of a persistent index reference their blocks in the mapped file.
+expected<void> init(column_index& col) {
+  if (exists(col.filename)) {
+    detail::value_index_inspect_helper tmp{col.type, col.idx};
+    return load_mapped(col.filename, col.last_flush, tmp);
   }
-  return {
-    [=](const std::vector<event>& events) {
-      VAST_TRACE(self, "got", events.size(), "events");
-      for (auto& e : events) {
-        VAST_ASSERT(e.id() != invalid_event_id);
-        if (auto data = extract(e)) {
-          auto result = self->state.idx->push_back(*data, e.id());
-          if (!result) {
-            VAST_ERROR(self->system().render(result.error()));
-            self->quit(result.error());
-            break;
-          }
-        }
-      }
-    },
-    [=](const predicate& pred) -> result<bitmap> {
-      VAST_TRACE(self, "got predicate:", pred);
-      return self->state.idx->lookup(pred.op, get<data>(pred.rhs));
-    },
-    [=](shutdown_atom) {
-      // Flush index to disk.
-      auto offset = self->state.idx->offset();
-      if (offset == self->state.last_flush) {
-        // Nothing to write.
-        self->quit(exit_reason::user_shutdown);
-        return;
-      }
-      // Create parent directory if it doesn't exist.
-      auto dir = self->state.filename.parent();
-      if (!exists(dir)) {
-        auto result = mkdir(dir);
-        if (!result) {
-          self->quit(result.error());
-          return;
-        }
-      }
-      VAST_DEBUG(self, "flushes index ("
-                 << (offset - self->state.last_flush) << '/' << offset,
-                 "new/total bits)");
-      self->state.last_flush = offset;
-      detail::value_index_inspect_helper tmp{self->state.type, self->state.idx};
-      auto result = save(self->state.filename, self->state.last_flush, tmp);
-      if (result)
-        self->quit(exit_reason::user_shutdown);
-      else
-        self->quit(result.error());
-    },
-  };
+  col.idx = value_index::make(col.type);
+  if (!col.idx)
+    return make_error(ec::unspecified, "failed to construct index");
+  return no_error;
 }
 
-// In the current event indexing design, all indexers receive all events and
-// pick the aspect of the event that's relevant to them. For event meta data
-// indexers, every event is relevant. Event data indexers concern themselves
-// only with a specific aspect of an event.
-
-behavior time_indexer(stateful_actor<value_indexer_state>* self,
-                      const path& p) {
-  // TODO: add type attributes to tune index, e.g., for seconds granularity.
-  auto t = timestamp_type{};
-  auto extract = [](const event& e) { return optional<data>{e.timestamp()}; };
-  return value_indexer(self, p, t, extract);
+// Writes an index to disk unless it has no new values.
+expected<void> flush(column_index& col) {
+  if (!col.idx)
+    return no_error;
+  auto offset = col.idx->offset();
+  if (offset == col.last_flush)
+    return no_error;
+  // Create parent directory if it doesn't exist.
+  auto dir = col.filename.parent();
+  if (!exists(dir))
+    if (auto result = mkdir(dir); !result)
+      return result.error();
+  col.last_flush = offset;
+  detail::value_index_inspect_helper tmp{col.type, col.idx};
+  return save_mapped(col.filename, col.last_flush, tmp);
 }
 
-behavior type_indexer(stateful_actor<value_indexer_state>* self,
-                      const path& p) {
-  auto t = string_type{};
-  auto extract = [](const event& e) { return optional<data>{e.type().name()}; };
-  return value_indexer(self, p, t, extract);
+// -- column management -------------------------------------------------------
+
+// Locates an index or schedules loading it.
+column_index_ptr load_column(stateful_actor<event_indexer_state>* self,
+                             const path& filename, const type& t) {
+  auto& col = self->state.indexes[filename];
+  if (col)
+    return col;
+  VAST_DEBUG(self, "loads value index at", filename);
+  col = std::make_shared<column_index>(filename, t, *self->state.pool);
+  auto handle = actor_cast<actor>(self);
+  col->strand->submit([handle, c = col] {
+    if (auto result = init(*c); !result)
+      anon_send(handle, load_atom::value, c->filename, result.error());
+    else if (auto delta = update_memusage(*c); delta != 0)
+      anon_send(handle, memory_atom::value, delta);
+  });
+  return col;
 }
 
-// Indexes the data from non-record event type.
-behavior flat_data_indexer(stateful_actor<value_indexer_state>* self,
-                           path dir, type event_type) {
-  auto extract = [=](const event& e) -> optional<const data&> {
-    if (e.type() != event_type)
-      return {};
-    return e.data();
-  };
-  return value_indexer(self, dir, event_type, extract);
+// Appends a column of values to an index.
+void append(stateful_actor<event_indexer_state>* self,
+            const column_index_ptr& col, std::vector<data> xs,
+            std::shared_ptr<const std::vector<event_id>> ids) {
+  auto handle = actor_cast<actor>(self);
+  col->strand->submit([handle, col, xs = std::move(xs), ids = std::move(ids)] {
+    if (!col->idx)
+      return;
+    if (auto result = col->idx->append(xs, *ids); !result)
+      anon_send(handle, write_atom::value, col->filename, result.error());
+    else if (auto delta = update_memusage(*col); delta != 0)
+      anon_send(handle, memory_atom::value, delta);
+  });
 }
 
-// Indexes a field of data from record event type.
-behavior field_data_indexer(stateful_actor<value_indexer_state>* self,
-                            path dir, type event_type, type value_type,
-                            offset off) {
-  auto extract = [=](const event& e) -> optional<const data&> {
-    if (e.type() != event_type)
-      return {};
-    auto v = get_if<vector>(e.data());
-    if (!v)
-      return {};
-    if (auto x = get(*v, off))
-      return *x;
-    // If there is no data at a given offset, it means that an intermediate
-    // record is nil but we're trying to access a deeper field.
-    static const auto nil_data = data{nil};
-    return nil_data;
-  };
-  return value_indexer(self, dir, value_type, extract);
+// Appends a batch of events to all indexes of an event indexer.
+void ingest(stateful_actor<event_indexer_state>* self,
+            const std::vector<event>& events) {
+  auto& st = self->state;
+  if (!st.time_index) {
+    VAST_DEBUG(self, "ignores events in read-only mode");
+    return;
+  }
+  auto batch = shred(st, events);
+  auto ids = std::make_shared<const std::vector<event_id>>(
+    std::move(batch.data_ids));
+  for (auto i = 0u; i < batch.columns.size(); ++i)
+    if (!batch.columns[i].empty())
+      append(self, st.columns[i].second, std::move(batch.columns[i]), ids);
+  ids = std::make_shared<const std::vector<event_id>>(std::move(batch.ids));
+  append(self, st.time_index, std::move(batch.times), ids);
+  append(self, st.type_index, std::move(batch.types), ids);
 }
 
 // Tests whether a type has a "skip" attribute.
@@ -181,7 +168,7 @@ bool skip(const type& t) {
 
 // Loads indexes for a predicate.
 struct loader {
-  using result_type = std::vector<actor>;
+  using result_type = std::vector<column_index_ptr>;
 
   template <class T>
   result_type operator()(const T&) {
@@ -213,20 +200,12 @@ struct loader {
     auto p = self->state.dir / "meta";
     if (ex.attr == "time") {
       VAST_ASSERT(is<timestamp>(x));
-      p /= ex.attr;
-      VAST_DEBUG(self, "loads time index at", p);
-      auto& a = self->state.indexers[p];
-      if (!a)
-        a = self->spawn<monitored>(time_indexer, p);
-      result.push_back(a);
+      // TODO: add type attributes to tune index, e.g., for seconds
+      // granularity.
+      result.push_back(load_column(self, p / ex.attr, timestamp_type{}));
     } else if (ex.attr == "type") {
       VAST_ASSERT(is<std::string>(x));
-      p /= ex.attr;
-      VAST_DEBUG(self, "loads type index at", p);
-      auto& a = self->state.indexers[p];
-      if (!a)
-        a = self->spawn<monitored>(type_indexer, p);
-      result.push_back(a);
+      result.push_back(load_column(self, p / ex.attr, string_type{}));
     } else {
       VAST_WARNING(self, "got unsupported attribute:", ex.attr);
     }
@@ -235,29 +214,18 @@ struct loader {
 
   result_type operator()(const data_extractor& dx, const data&) {
     result_type result;
+    auto p = self->state.dir / "data";
     if (dx.offset.empty()) {
-      auto p = self->state.dir / "data";
-      VAST_DEBUG(self, "loads value index for", self->state.event_type.name());
-      auto& a = self->state.indexers[p];
-      if (!a)
-        a = self->spawn<monitored>(flat_data_indexer, p,
-                                   self->state.event_type);
-      result.push_back(a);
+      result.push_back(load_column(self, p, self->state.event_type));
     } else {
       auto r = get<record_type>(dx.type);
       auto k = r.resolve(dx.offset);
       VAST_ASSERT(k);
       auto t = r.at(dx.offset);
       VAST_ASSERT(t);
-      auto p = self->state.dir / "data";
       for (auto& x : *k)
         p /= x;
-      VAST_DEBUG(self, "loads value index for", *k);
-      auto& a = self->state.indexers[p];
-      if (!a)
-        a = self->spawn<monitored>(field_data_indexer, p, dx.type, *t,
-                                   dx.offset);
-      result.push_back(a);
+      result.push_back(load_column(self, p, *t));
     }
     return result;
   }
@@ -265,127 +233,213 @@ struct loader {
   stateful_actor<event_indexer_state>* self;
 };
 
+// Looks up a predicate in all matching value indexes, optionally considering
+// only the IDs of a restriction.
+void lookup(stateful_actor<event_indexer_state>* self, const predicate& pred,
+            std::shared_ptr<const ids> restriction) {
+  auto rp = self->make_response_promise();
+  // For now, we require that the predicate is part of a normalized
+  // expression, i.e., LHS an extractor type and RHS of type data.
+  auto rhs = get_if<data>(pred.rhs);
+  VAST_ASSERT(rhs);
+  auto resolved = type_resolver{self->state.event_type}(pred);
+  if (!resolved) {
+    VAST_DEBUG(self, "failed to resolve predicate:",
+               self->system().render(resolved.error()));
+    rp.deliver(resolved.error());
+    return;
+  }
+  auto columns = visit(loader{self}, *resolved);
+  if (columns.empty()) {
+    VAST_DEBUG(self, "did not find matching indexes for", pred);
+    rp.deliver(bitmap{});
+    return;
+  }
+  // Look up all indexes in parallel and combine the results as they
+  // arrive.
+  VAST_DEBUG(self, "asks", columns.size(), "indexes");
+  auto id = self->state.next_lookup++;
+  self->state.lookups.emplace(id, pending_lookup{rp, columns.size(), {}});
+  auto handle = actor_cast<actor>(self);
+  for (auto& col : columns)
+    col->strand->submit([=, x = *rhs] {
+      if (!col->idx) {
+        anon_send(handle, response_atom::value, id, bitmap{});
+        return;
+      }
+      auto result = restriction
+                  ? col->idx->lookup(pred.op, x, *restriction)
+                  : col->idx->lookup(pred.op, x);
+      if (result)
+        anon_send(handle, response_atom::value, id, std::move(*result));
+      else
+        anon_send(handle, response_atom::value, id, result.error());
+    });
+}
+
 } // namespace <anonymous>
 
+shredded_batch shred(const event_indexer_state& st,
+                     const std::vector<event>& events) {
+  shredded_batch result;
+  result.ids.reserve(events.size());
+  result.times.reserve(events.size());
+  result.types.reserve(events.size());
+  // Only events of our type have data for the event data indexes.
+  result.columns.resize(st.columns.size());
+  for (auto& column : result.columns)
+    column.reserve(events.size());
+  // If there is no data at a given offset, it means that an intermediate
+  // record is nil but we're trying to access a deeper field.
+  static const auto nil_data = data{nil};
+  for (auto& e : events) {
+    VAST_ASSERT(e.id() != invalid_event_id);
+    result.ids.push_back(e.id());
+    result.times.emplace_back(e.timestamp());
+    result.types.emplace_back(e.type().name());
+    if (result.columns.empty() || e.type() != st.event_type)
+      continue;
+    if (!get_if<record_type>(st.event_type)) {
+      result.columns[0].push_back(e.data());
+    } else if (auto v = get_if<vector>(e.data())) {
+      for (auto i = 0u; i < result.columns.size(); ++i) {
+        auto x = get(*v, st.columns[i].first);
+        result.columns[i].push_back(x ? *x : nil_data);
+      }
+    } else {
+      continue;
+    }
+    result.data_ids.push_back(e.id());
+  }
+  return result;
+}
+
 behavior event_indexer(stateful_actor<event_indexer_state>* self,
-                       path dir, type event_type) {
+                       path dir, type event_type,
+                       std::shared_ptr<detail::work_stealing_pool> pool,
+                       actor parent) {
+  VAST_ASSERT(pool);
   self->state.dir = dir;
   self->state.event_type = event_type;
+  self->state.pool = std::move(pool);
+  self->state.parent = std::move(parent);
   VAST_DEBUG(self, "operates for event", event_type);
   // If the directory doesn't exist yet, we're in "construction" mode,
-  // where we spawn all indexers to be able to handle incoming events directly.
-  // Otherwise we deal with a "frozen" indexer that only spawns indexers as
-  // needed for answering queries.
+  // where we create all indexes to be able to handle incoming events
+  // directly. Otherwise we deal with a "frozen" indexer that only loads
+  // indexes as needed for answering queries.
   if (!exists(dir)) {
-    VAST_DEBUG(self, "didn't find persistent state, spawning new indexers");
-    // Spawn indexers for event meta data.
-    auto p = dir / "meta" / "time";
-    auto a = self->spawn<monitored>(time_indexer, p);
-    self->state.indexers.emplace(p, a);
-    p = dir / "meta" / "type";
-    a = self->spawn<monitored>(type_indexer, p);
-    self->state.indexers.emplace(p, a);
-    // Spawn indexers for event data.
+    VAST_DEBUG(self, "didn't find persistent state, creating new indexes");
+    // Create indexes for event meta data.
+    auto& st = self->state;
+    st.time_index = load_column(self, dir / "meta" / "time", timestamp_type{});
+    st.type_index = load_column(self, dir / "meta" / "type", string_type{});
+    // Create indexes for event data.
     if (skip(event_type)) {
       VAST_DEBUG(self, "skips event:", event_type);
     } else {
       auto r = get_if<record_type>(event_type);
       if (!r) {
-        p = dir / "data";
-        VAST_DEBUG(self, "spawns data indexer");
-        a = self->spawn<monitored>(flat_data_indexer, p, event_type);
-        self->state.indexers.emplace(p, a);
+        VAST_DEBUG(self, "creates data index");
+        st.columns.emplace_back(offset{},
+                                load_column(self, dir / "data", event_type));
       } else {
         for (auto& f : record_type::each{*r}) {
           auto& value_type = f.trace.back()->type;
           if (skip(value_type)) {
             VAST_DEBUG(self, "skips record field:", f.key());
           } else {
-            p = dir / "data";
+            auto p = dir / "data";
             for (auto& k : f.key())
               p /= k;
-            VAST_DEBUG(self, "spawns field indexer at offset", f.offset,
+            VAST_DEBUG(self, "creates field index at offset", f.offset,
                        "with type", value_type);
-            a = self->spawn<monitored>(field_data_indexer, p, event_type,
-                                       value_type, f.offset);
-            self->state.indexers.emplace(p, a);
+            st.columns.emplace_back(f.offset,
+                                    load_column(self, p, value_type));
           }
         }
       }
     }
   }
-  // We monitor all indexers so that we can control the shutdown process
-  // explicitly.
-  auto remove_indexer = [=](auto& indexer) {
-    auto i = std::find_if(self->state.indexers.begin(),
-                          self->state.indexers.end(),
-                          [&](auto& p) { return p.second == indexer; });
-    VAST_ASSERT(i != self->state.indexers.end());
-    self->state.indexers.erase(i);
-  };
-  self->set_down_handler(
-    [=](const down_msg& msg) { remove_indexer(msg.source); }
-  );
   return {
-    [=](const std::vector<event>&) {
-      auto msg = self->current_mailbox_element()->move_content_to_message();
-      for (auto& x : self->state.indexers)
-        self->send(x.second, msg);
+    [=](const std::vector<event>& events) {
+      VAST_TRACE(self, "got", events.size(), "events");
+      ingest(self, events);
     },
     [=](const predicate& pred) {
       VAST_DEBUG(self, "got predicate:", pred);
-      auto rp = self->make_response_promise<bitmap>();
-      // For now, we require that the predicate is part of a normalized
-      // expression, i.e., LHS an extractor type and RHS of type data.
-      auto rhs = get_if<data>(pred.rhs);
-      VAST_ASSERT(rhs);
-      auto resolved = type_resolver{self->state.event_type}(pred);
-      if (!resolved) {
-        VAST_DEBUG(self, "failed to resolve predicate:",
-                   self->system().render(resolved.error()));
-        rp.deliver(resolved.error());
+      lookup(self, pred, nullptr);
+    },
+    [=](const predicate& pred, const ids& restriction) {
+      VAST_DEBUG(self, "got predicate:", pred, "with restriction of",
+                 rank(restriction), "IDs");
+      lookup(self, pred, std::make_shared<const ids>(restriction));
+    },
+    [=](response_atom, uint64_t id, bitmap& hits) {
+      auto i = self->state.lookups.find(id);
+      if (i == self->state.lookups.end())
         return;
+      if (!hits.empty())
+        i->second.hits |= hits;
+      if (--i->second.remaining == 0) {
+        i->second.promise.deliver(std::move(i->second.hits));
+        self->state.lookups.erase(i);
       }
-
-      auto indexers = visit(loader{self}, *resolved);
-      // Forward predicate to all available indexers.
-      if (indexers.empty()) {
-        VAST_DEBUG(self, "did not find matching indexers for", pred);
-        rp.deliver(bitmap{});
+    },
+    [=](response_atom, uint64_t id, error& e) {
+      auto i = self->state.lookups.find(id);
+      if (i == self->state.lookups.end())
         return;
-      }
-      VAST_DEBUG(self, "asks", indexers.size(), "indexers");
-      // Manual map-reduce over the indexers.
-      auto n = std::make_shared<size_t>(indexers.size());
-      auto reducer = self->system().spawn([=]() mutable -> behavior {
-        auto result = std::make_shared<bitmap>();
-        return {
-          [=](const bitmap& bm) mutable {
-            if (!bm.empty())
-              *result |= bm;
-            if (--*n == 0)
-              rp.deliver(std::move(*result));
-          },
-          [=](error& e) mutable {
-            rp.deliver(std::move(e));
-          }
-        };
-      });
-      auto msg = self->current_mailbox_element()->move_content_to_message();
-      for (auto& x : indexers)
-        send_as(reducer, x, msg);
+      i->second.promise.deliver(std::move(e));
+      self->state.lookups.erase(i);
+    },
+    [=](load_atom, const path& filename, const error& e) {
+      VAST_ERROR(self, "failed to load value index", filename << ':',
+                 self->system().render(e));
+    },
+    [=](write_atom, const path& filename, const error& e) {
+      VAST_ERROR(self, "failed to append to value index", filename << ':',
+                 self->system().render(e));
+    },
+    [=](memory_atom, int64_t delta) {
+      if (self->state.parent)
+        self->send(self->state.parent, memory_atom::value, delta);
+    },
+    [=](load_atom, const predicate& pred) {
+      // Loading the value indexes happens in the background, ahead of the
+      // actual predicate evaluation.
+      VAST_DEBUG(self, "prefetches indexes for predicate:", pred);
+      if (auto resolved = type_resolver{self->state.event_type}(pred))
+        visit(loader{self}, *resolved);
     },
     [=](shutdown_atom) {
-      for (auto& i : self->state.indexers)
-        self->send(i.second, shutdown_atom::value);
-      // Wait until all indexers have terminated.
-      self->set_down_handler(
-        [=](const down_msg& msg) {
-          remove_indexer(msg.source);
-          if (self->state.indexers.empty())
-            self->quit(exit_reason::user_shutdown);
-        }
-      );
+      // Flush all indexes to disk and terminate once all have finished.
+      auto& st = self->state;
+      if (st.flushing > 0) {
+        VAST_DEBUG(self, "ignores repeated shutdown request");
+        return;
+      }
+      if (st.indexes.empty()) {
+        self->quit(exit_reason::user_shutdown);
+        return;
+      }
+      st.flushing = st.indexes.size();
+      auto handle = actor_cast<actor>(self);
+      for (auto& x : st.indexes) {
+        auto col = x.second;
+        col->strand->submit([handle, col] {
+          auto result = flush(*col);
+          anon_send(handle, done_atom::value, col->filename,
+                    result ? error{} : result.error());
+        });
+      }
+    },
+    [=](done_atom, const path& filename, const error& e) {
+      if (e)
+        VAST_ERROR(self, "failed to write value index", filename << ':',
+                   self->system().render(e));
+      if (--self->state.flushing == 0)
+        self->quit(exit_reason::user_shutdown);
     },
   };
 }
@@ -11,6 +11,9 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <algorithm>
+#include <limits>
+
 #include <caf/all.hpp>
 
 #include "vast/ids.hpp"
@@ -26,6 +29,7 @@
 #include "vast/event.hpp"
 #include "vast/expression.hpp"
 #include "vast/expression_visitors.hpp"
+#include "vast/incremental_evaluator.hpp"
 #include "vast/load.hpp"
 #include "vast/logger.hpp"
 #include "vast/save.hpp"
@@ -61,9 +65,10 @@ struct collector_state {
 
 // Encapsulates a single predicate that is part of one or more expressions.
 // The COLLECTOR receives hits from INDEXERs and relays them to the EVALUATORs
-// after having received all hits for the given predicate.
+// after having received all hits for the given predicate. If given a valid
+// PARTITION, the COLLECTOR also hands the hits to its predicate cache.
 behavior collector(stateful_actor<collector_state>* self, predicate pred,
-                   actor evaluator, size_t expected) {
+                   actor evaluator, size_t expected, actor partition) {
   self->state.name += '[' + to_string(pred) + ']';
   self->state.pred = std::move(pred);
   return {
@@ -73,6 +78,9 @@ behavior collector(stateful_actor<collector_state>* self, predicate pred,
       self->state.hits |= hits;
       if (++self->state.got == expected) {
         VAST_DEBUG(self, "relays", rank(self->state.hits), "hits to evaluator");
+        if (partition)
+          self->send(partition, put_atom::value, self->state.pred,
+                     self->state.hits);
         self->send(evaluator, std::move(self->state.pred), self->state.hits);
         self->quit();
       }
@@ -80,79 +88,32 @@ behavior collector(stateful_actor<collector_state>* self, predicate pred,
   };
 }
 
-struct ids_evaluator {
-  ids_evaluator(const std::unordered_map<predicate, ids>& xs)
-    : xs{xs} {
-    // nop
-  }
-
-  ids operator()(none) const {
-    return {};
-  }
-
-  ids operator()(const conjunction& c) const {
-    auto result = visit(*this, c[0]);
-    if (result.empty() || all<0>(result))
-      return {};
-    for (size_t i = 1; i < c.size(); ++i) {
-      result &= visit(*this, c[i]);
-      if (result.empty() || all<0>(result)) // short-circuit
-        return {};
-    }
-    return result;
-  }
-
-  ids operator()(const disjunction& d) const {
-    ids result;
-    for (auto& op : d) {
-      result |= visit(*this, op);
-      if (all<1>(result)) // short-circuit
-        break;
-    }
-    return result;
-  }
-
-  ids operator()(const negation& n) const {
-    auto result = visit(*this, n.expr());
-    result.flip();
-    return result;
-  }
-
-  ids operator()(const predicate& pred) const {
-    auto i = xs.find(pred);
-    return i != xs.end() ? i->second : ids{};
-  }
-
-  const std::unordered_map<predicate, ids>& xs;
-};
-
 struct evaluator_state {
-  ids hits;
-  std::unordered_map<predicate, ids> predicates;
+  incremental_evaluator eval;
   static inline const char* name = "evaluator";
 };
 
 // Wraps a query expression in an actor. Upon receiving hits from COLLECTORs,
-// re-evaluates the expression and relays new hits to its sinks.
-behavior evaluator(stateful_actor<evaluator_state>* self,
-                   expression expr, size_t num_predicates, actor sink) {
+// re-evaluates the affected parts of the expression and relays new hits to
+// its sink.
+behavior evaluator(stateful_actor<evaluator_state>* self, expression expr,
+                   actor sink) {
+  self->state.eval = incremental_evaluator{expr};
   return {
-    [=](predicate& pred, ids& hits) {
-      self->state.predicates.emplace(std::move(pred), std::move(hits));
-      auto expr_hits = visit(ids_evaluator{self->state.predicates}, expr);
-      auto delta = expr_hits - self->state.hits;
+    [=](const predicate& pred, ids& hits) {
+      auto& eval = self->state.eval;
+      auto delta = eval.add(pred, std::move(hits));
       VAST_DEBUG(self, "evaluated",
-                 self->state.predicates.size() << '/' << num_predicates,
+                 eval.completed() << '/' << eval.predicates(),
                  "predicates, yielding",
-                 rank(delta) << '/' << rank(expr_hits),
+                 rank(delta) << '/' << rank(eval.hits()),
                  "new/total hits for", expr);
       if (any<1>(delta)) {
         VAST_DEBUG(self, "relays", rank(delta), "new hits to sink");
-        self->state.hits |= delta;
         self->send(sink, std::move(delta));
       }
       // We're done with evaluation if all predicates have reported their hits.
-      if (self->state.predicates.size() == num_predicates) {
+      if (eval.done()) {
         VAST_DEBUG(self, "completed expression evaluation");
         self->send(sink, done_atom::value);
         self->quit();
@@ -161,9 +122,245 @@ behavior evaluator(stateful_actor<evaluator_state>* self,
   };
 }
 
+// Selects the known types for which the expression could match.
+std::vector<type> candidates(stateful_actor<partition_state>* self,
+                             const expression& expr) {
+  std::vector<type> result;
+  for (auto& [t, a] : self->state.indexers) {
+    auto resolved = visit(type_resolver{t}, expr);
+    if (resolved && visit(matcher{t}, *resolved)) {
+      VAST_DEBUG(self, "found matching type for expression:", t);
+      result.push_back(t);
+    }
+  }
+  return result;
+}
+
+// Locates or loads the indexer for a type.
+actor load_indexer(stateful_actor<partition_state>* self, const path& dir,
+                   const type& t) {
+  auto& a = self->state.indexers[t];
+  if (!a) {
+    VAST_DEBUG(self, "loads event-indexer for type", t);
+    a = self->spawn(event_indexer, dir / to_digest(t), t, self->state.pool,
+                    actor_cast<actor>(self));
+  }
+  return a;
+}
+
+// Locates or loads the indexers that can produce hits for a predicate. All
+// other indexers would answer with an empty bitmap, so we neither ask nor
+// load them.
+std::vector<actor> load_indexers(stateful_actor<partition_state>* self,
+                                 const path& dir,
+                                 const std::vector<type>& types,
+                                 const predicate& pred) {
+  std::vector<actor> result;
+  for (auto& t : route(types, pred))
+    result.push_back(load_indexer(self, dir, t));
+  return result;
+}
+
+// Adds the hits of a predicate to the cache, evicting the least recently
+// used entries until the cache fits into its budget again.
+void cache_hits(stateful_actor<partition_state>* self, const predicate& pred,
+                const ids& hits) {
+  auto& cache = self->state.cache;
+  auto size = hits.memusage();
+  if (size > cache.capacity)
+    return;
+  if (!cache.entries.emplace(pred, hits).second)
+    return;
+  cache.size += size;
+  self->state.memusage += size;
+  auto evicted = size_t{0};
+  while (cache.size > cache.capacity) {
+    auto victim = cache.entries.evict();
+    auto n = victim.second.memusage();
+    cache.size -= n;
+    evicted += n;
+  }
+  self->state.memusage -= evicted;
+  auto delta = static_cast<int64_t>(size) - static_cast<int64_t>(evicted);
+  if (delta != 0 && self->state.parent)
+    self->send(self->state.parent, memory_atom::value, delta);
+}
+
+// Accounts for the cache hits and misses of a query.
+void report_cache(stateful_actor<partition_state>* self,
+                  const accountant_type& accountant, uint64_t hits,
+                  uint64_t misses) {
+  auto& cache = self->state.cache;
+  cache.hits += hits;
+  cache.misses += misses;
+  if (!accountant)
+    return;
+  self->send(accountant, "partition.cache.hits", hits);
+  self->send(accountant, "partition.cache.misses", misses);
+  auto lookups = cache.hits + cache.misses;
+  if (lookups > 0)
+    self->send(accountant, "partition.cache.hit-rate",
+               static_cast<double>(cache.hits) / lookups);
+}
+
+// Estimates how many events a predicate selects, such that smaller values
+// mean more selective predicates. Cached hits give an exact answer. Otherwise
+// we go by the operator: equality and membership tests tend to select fewer
+// events than range tests, which in turn select fewer than negated tests.
+// Estimating must not count as a cache access, so we only peek at entries.
+std::pair<int, uint64_t> estimate(stateful_actor<partition_state>* self,
+                                  const predicate& pred) {
+  const auto& entries = self->state.cache.entries;
+  if (auto i = entries.peek(pred); i != entries.end())
+    return {0, rank(i->second)};
+  switch (pred.op) {
+    default:
+      return {1, 2};
+    case match:
+    case in:
+    case ni:
+    case equal:
+      return {1, 0};
+    case less:
+    case less_equal:
+    case greater:
+    case greater_equal:
+      return {1, 1};
+  }
+}
+
+// The state of a conjunction of predicates that we evaluate one predicate at
+// a time, in order of increasing estimated selectivity. Each lookup after the
+// first passes the IDs that satisfy all previous predicates, and the
+// evaluation stops as soon as no ID is left.
+struct conjunction_evaluation {
+  expression expr;
+  std::vector<predicate> predicates;
+  std::vector<type> types;
+  size_t next = 0;
+  ids hits;
+  typed_response_promise<ids> promise;
+  steady_clock::time_point start;
+  accountant_type accountant;
+  uint64_t cache_hits = 0;
+  uint64_t cache_misses = 0;
+  // Whether an indexer failed, in which case the promise holds the error.
+  bool failed = false;
+};
+
+using conjunction_evaluation_ptr = std::shared_ptr<conjunction_evaluation>;
+
+void finish(stateful_actor<partition_state>* self,
+            const conjunction_evaluation_ptr& ev) {
+  if (self->state.frozen && self->state.cache.capacity > 0)
+    report_cache(self, ev->accountant, ev->cache_hits, ev->cache_misses);
+  if (ev->hits.empty() || all<0>(ev->hits))
+    ev->hits = {};
+  ev->promise.deliver(std::move(ev->hits));
+  timespan runtime = steady_clock::now() - ev->start;
+  VAST_DEBUG(self, "answered", ev->expr, "in", runtime, "after evaluating",
+             ev->next << '/' << ev->predicates.size(), "predicates");
+  if (ev->accountant)
+    self->send(ev->accountant, "partition.query.runtime", runtime);
+}
+
+void evaluate_next(stateful_actor<partition_state>* self, const path& dir,
+                   conjunction_evaluation_ptr ev);
+
+// Intersects the hits of the current predicate and moves on to the next one.
+void conclude(stateful_actor<partition_state>* self, const path& dir,
+              conjunction_evaluation_ptr ev, const ids& hits) {
+  if (ev->next == 1)
+    ev->hits = hits;
+  else
+    ev->hits &= hits;
+  if (ev->hits.empty() || all<0>(ev->hits)) {
+    VAST_DEBUG(self, "short-circuits conjunction evaluation");
+    finish(self, ev);
+    return;
+  }
+  evaluate_next(self, dir, std::move(ev));
+}
+
+void evaluate_next(stateful_actor<partition_state>* self, const path& dir,
+                   conjunction_evaluation_ptr ev) {
+  if (ev->next == ev->predicates.size()) {
+    finish(self, ev);
+    return;
+  }
+  auto& pred = ev->predicates[ev->next++];
+  // Only unrestricted results represent the full hits of a predicate and
+  // qualify for caching.
+  auto restricted = ev->next > 1;
+  auto use_cache = self->state.frozen && self->state.cache.capacity > 0;
+  if (use_cache) {
+    auto& entries = self->state.cache.entries;
+    if (auto i = entries.find(pred); i != entries.end()) {
+      VAST_DEBUG(self, "found cached hits for", pred);
+      ++ev->cache_hits;
+      conclude(self, dir, std::move(ev), i->second);
+      return;
+    }
+    ++ev->cache_misses;
+  }
+  auto indexers = load_indexers(self, dir, ev->types, pred);
+  if (indexers.empty()) {
+    VAST_DEBUG(self, "found no indexer for", pred);
+    conclude(self, dir, std::move(ev), ids{});
+    return;
+  }
+  VAST_DEBUG(self, "routes", pred, "to", indexers.size(), "indexer(s)");
+  auto result = std::make_shared<ids>();
+  auto remaining = std::make_shared<size_t>(indexers.size());
+  auto collect = [=](ids& hits) {
+    if (ev->failed)
+      return;
+    *result |= hits;
+    if (--*remaining > 0)
+      return;
+    if (use_cache && !restricted)
+      cache_hits(self, ev->predicates[ev->next - 1], *result);
+    conclude(self, dir, ev, *result);
+  };
+  // Missing hits would make the result and any cached entry wrong, so an
+  // error aborts the entire evaluation.
+  auto fail = [=](error& e) {
+    if (ev->failed)
+      return;
+    VAST_ERROR(self, "failed to look up predicate:", self->system().render(e));
+    ev->failed = true;
+    ev->promise.deliver(std::move(e));
+  };
+  for (auto& x : indexers)
+    if (restricted)
+      self->request(x, infinite, pred, ev->hits).then(collect, fail);
+    else
+      self->request(x, infinite, pred).then(collect, fail);
+}
+
 } // namespace <anonymous>
 
-behavior partition(stateful_actor<partition_state>* self, path dir) {
+predicate_cache::predicate_cache()
+  : entries{std::numeric_limits<size_t>::max()} {
+  // nop
+}
+
+std::vector<type> route(const std::vector<type>& types, const predicate& pred) {
+  std::vector<type> result;
+  for (auto& t : types) {
+    auto resolved = type_resolver{t}(pred);
+    if (resolved && visit(matcher{t}, *resolved))
+      result.push_back(t);
+  }
+  return result;
+}
+
+behavior partition(stateful_actor<partition_state>* self, path dir,
+                   std::shared_ptr<detail::work_stealing_pool> pool,
+                   size_t cache_size, actor parent) {
+  self->state.pool = std::move(pool);
+  self->state.cache.capacity = cache_size;
+  self->state.parent = std::move(parent);
   auto accountant = accountant_type{};
   if (auto a = self->system().registry().get(accountant_atom::value))
     accountant = actor_cast<accountant_type>(a);
@@ -177,12 +374,24 @@ behavior partition(stateful_actor<partition_state>* self, path dir) {
     } else {
       for (auto& [str, t] : self->state.meta_data.types)
         self->state.indexers.emplace(t, actor{});
+      self->state.frozen = true;
     }
   }
   return {
     [=](const std::vector<event>& events) {
       VAST_ASSERT(!events.empty());
       VAST_DEBUG(self, "got", events.size(), "events");
+      if (self->state.frozen) {
+        // New events invalidate all cached hits.
+        VAST_WARNING(self, "got events while frozen, disables cache");
+        self->state.frozen = false;
+        auto size = static_cast<int64_t>(self->state.cache.size);
+        self->state.cache.entries.clear();
+        self->state.cache.size = 0;
+        self->state.memusage -= size;
+        if (size > 0 && self->state.parent)
+          self->send(self->state.parent, memory_atom::value, -size);
+      }
       // Locate relevant indexers.
       vast::detail::flat_set<actor> indexers;
       for (auto& e : events) {
@@ -190,7 +399,8 @@ behavior partition(stateful_actor<partition_state>* self, path dir) {
         if (!a) {
           VAST_DEBUG(self, "creates event-indexer for type", e.type());
           auto digest = to_digest(e.type());
-          a = self->spawn(event_indexer, dir / digest, e.type());
+          a = self->spawn(event_indexer, dir / digest, e.type(),
+                          self->state.pool, actor_cast<actor>(self));
           if (self->state.meta_data.types.count(digest) == 0)
             self->state.meta_data.types.emplace(digest, e.type());
         }
@@ -205,27 +415,38 @@ behavior partition(stateful_actor<partition_state>* self, path dir) {
       VAST_DEBUG(self, "got expression:", expr);
       auto start = steady_clock::now();
       auto rp = self->make_response_promise<ids>();
-      // For each known type, check whether the expression could match.
-      // If so, locate/load the corresponding indexer.
-      std::vector<actor> indexers;
-      for (auto& [t, a] : self->state.indexers) {
-        auto resolved = visit(type_resolver{t}, expr);
-        if (resolved && visit(matcher{t}, *resolved)) {
-          VAST_DEBUG(self, "found matching type for expression:", t);
-          if (!a) {
-            VAST_DEBUG(self, "loads event-indexer for type", t);
-            auto indexer_dir = dir / to_digest(t);
-            a = self->spawn(event_indexer, indexer_dir, t);
-          }
-          indexers.push_back(a);
-        }
-      }
-      if (indexers.empty()) {
+      auto types = candidates(self, expr);
+      if (types.empty()) {
         VAST_DEBUG(self, "did not find a matching type in",
                    self->state.indexers.size(), "indexer(s)");
         rp.deliver(ids{});
         return;
       }
+      // Evaluate conjunctions of predicates one predicate at a time.
+      if (auto c = get_if<conjunction>(expr)) {
+        auto is_predicate = [](auto& x) { return is<predicate>(x); };
+        if (std::all_of(c->begin(), c->end(), is_predicate)) {
+          auto ev = std::make_shared<conjunction_evaluation>();
+          ev->expr = expr;
+          // Estimate each predicate once rather than on every comparison.
+          std::vector<std::pair<std::pair<int, uint64_t>, predicate>> xs;
+          for (auto& op : *c) {
+            auto& pred = get<predicate>(op);
+            xs.emplace_back(estimate(self, pred), pred);
+          }
+          std::stable_sort(xs.begin(), xs.end(), [](auto& x, auto& y) {
+            return x.first < y.first;
+          });
+          for (auto& x : xs)
+            ev->predicates.push_back(std::move(x.second));
+          ev->types = std::move(types);
+          ev->promise = std::move(rp);
+          ev->start = start;
+          ev->accountant = accountant;
+          evaluate_next(self, dir, std::move(ev));
+          return;
+        }
+      }
       // Spawn a sink that accumulates the stream of ids from the evaluator
       // and ultimately responds to the user with the result.
       auto accumulator = self->system().spawn(
@@ -252,15 +473,63 @@ behavior partition(stateful_actor<partition_state>* self, path dir) {
       // actor re-evaluates the expression whenever it receives new hits from
       // a collector.
       auto predicates = visit(predicatizer{}, expr);
-      auto eval = self->spawn(evaluator, expr, predicates.size(), accumulator);
+      auto eval = self->spawn(evaluator, expr, accumulator);
+      // A frozen partition answers repeated predicates from its cache.
+      auto use_cache = self->state.frozen && self->state.cache.capacity > 0;
+      auto hits = uint64_t{0};
+      auto misses = uint64_t{0};
       for (auto& pred : predicates) {
-        // FIXME: locate the smallest subset of indexers (checking whether the
-        // predicate could match the type of the indexer) instead of querying
-        // all indexers.
-        auto coll = self->spawn(collector, pred, eval, indexers.size());
+        if (use_cache) {
+          auto i = self->state.cache.entries.find(pred);
+          if (i != self->state.cache.entries.end()) {
+            VAST_DEBUG(self, "found cached hits for", pred);
+            ++hits;
+            self->send(eval, pred, i->second);
+            continue;
+          }
+          ++misses;
+        }
+        auto indexers = load_indexers(self, dir, types, pred);
+        if (indexers.empty()) {
+          VAST_DEBUG(self, "found no indexer for", pred);
+          self->send(eval, pred, ids{});
+          continue;
+        }
+        VAST_DEBUG(self, "routes", pred, "to", indexers.size(), "indexer(s)");
+        auto coll = self->spawn(collector, pred, eval, indexers.size(),
+                                use_cache ? actor_cast<actor>(self) : actor{});
         for (auto& x : indexers)
           send_as(coll, x, pred);
       }
+      if (use_cache)
+        report_cache(self, accountant, hits, misses);
+    },
+    [=](seal_atom) {
+      VAST_DEBUG(self, "got sealed and caches predicate hits from now on");
+      self->state.frozen = true;
+    },
+    [=](put_atom, const predicate& pred, const ids& hits) {
+      if (self->state.frozen)
+        cache_hits(self, pred, hits);
+    },
+    [=](memory_atom, int64_t delta) {
+      self->state.memusage += delta;
+      VAST_TRACE(self, "uses", self->state.memusage, "bytes");
+      if (self->state.parent)
+        self->send(self->state.parent, memory_atom::value, delta);
+    },
+    [=](load_atom, const expression& expr) {
+      VAST_DEBUG(self, "prefetches indexers for expression:", expr);
+      auto types = candidates(self, expr);
+      if (types.empty())
+        return;
+      for (auto& pred : visit(predicatizer{}, expr)) {
+        // Cached predicates need no value indexes.
+        if (self->state.cache.entries.count(pred) > 0)
+          continue;
+        for (auto& x : load_indexers(self, dir, types, pred))
+          self->send(x, load_atom::value, pred);
+      }
     },
     [=](shutdown_atom) {
       if (self->state.indexers.empty()) {
@@ -46,13 +46,16 @@ expected<actor> spawn_archive(local_actor* self, options& opts) {
   auto segments = size_t{10};
   auto r = opts.params.extract_opts({
     {"segments,s", "number of cached segments", segments},
-    {"max-segment-size,m", "maximum segment size in MB", mss}
+    {"max-segment-size,m", "maximum segment size in MB", mss},
+    {"columnar,c", "store events in columnar batches"}
   });
   opts.params = r.remainder;
   if (!r.error.empty())
     return make_error(ec::syntax_error, r.error);
   mss <<= 20; // MB'ify.
-  auto a = self->spawn(archive, opts.dir / opts.label, segments, mss);
+  auto layout = r.opts.count("columnar") > 0 ? batch::encoding::columnar
+                                             : batch::encoding::row;
+  auto a = self->spawn(archive, opts.dir / opts.label, segments, mss, layout);
   return actor_cast<actor>(a);
 }
 
@@ -131,16 +134,27 @@ expected<actor> spawn_index(local_actor* self, options& opts) {
   size_t max_events = 1 << 20;
   size_t max_parts = 10;
   size_t taste_parts = 5;
+  size_t max_memory = 0;
+  size_t workers = 0;
+  size_t cache_size = 1024;
   auto r = opts.params.extract_opts({
     {"max-events,e", "maximum events per partition", max_events},
     {"max-parts,p", "maximum number of in-memory partitions", max_parts},
-    {"taste-parts,p", "number of immediately scheduled partitions", taste_parts}
+    {"taste-parts,p", "number of immediately scheduled partitions",
+     taste_parts},
+    {"max-memory,m", "maximum memory of in-memory partitions in MB",
+     max_memory},
+    {"workers,w", "threads for building value indexes (0 = all cores)",
+     workers},
+    {"cache-size,c", "predicate cache of passive partitions in KB",
+     cache_size}
   });
   opts.params = r.remainder;
   if (!r.error.empty())
     return make_error(ec::syntax_error, r.error);
   return self->spawn(index, opts.dir / opts.label, max_events, max_parts,
-                     taste_parts);
+                     taste_parts, max_memory << 20, workers,
+                     cache_size << 10);
 }
 
 expected<actor> spawn_metastore(local_actor* self, options& opts) {
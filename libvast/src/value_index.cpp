@@ -12,6 +12,8 @@
  ******************************************************************************/
 
 #include <cmath>
+#include <limits>
+#include <regex>
 
 #include "vast/base.hpp"
 #include "vast/concept/parseable/numeric/integral.hpp"
@@ -19,6 +21,8 @@
 #include "vast/concept/parseable/vast/base.hpp"
 #include "vast/value_index.hpp"
 
+#include "vast/detail/pattern_matcher.hpp"
+
 namespace vast {
 namespace {
 
@@ -29,6 +33,12 @@ optional<std::string> extract_attribute(const type& t, const std::string& key) {
   return {};
 }
 
+bool has_attribute(const type& t, const std::string& key) {
+  auto& attrs = t.attributes();
+  auto pred = [&](auto& attr) { return attr.key == key; };
+  return std::find_if(attrs.begin(), attrs.end(), pred) != attrs.end();
+}
+
 optional<base> parse_base(const type& t) {
   if (auto a = extract_attribute(t, "base")) {
     if (auto b = to<base>(*a))
@@ -91,7 +101,13 @@ std::unique_ptr<value_index> value_index::make(const type& t) {
         else
           return nullptr;
       }
-      return std::make_unique<string_index>(max_length);
+      if (detail::uses_string_index(t))
+        return std::make_unique<string_index>(max_length,
+                                              has_attribute(t, "trigrams"));
+      auto max_cardinality = size_t{10000};
+      if (has_attribute(t, "dictionary"))
+        max_cardinality = std::numeric_limits<size_t>::max();
+      return std::make_unique<dictionary_index>(max_length, max_cardinality);
     }
     result_type operator()(const pattern_type&) const {
       return nullptr;
@@ -178,6 +194,45 @@ expected<void> value_index::push_back(const data& x, event_id id) {
   return {};
 }
 
+expected<void> value_index::append(const std::vector<data>& xs,
+                                   const std::vector<event_id>& event_ids) {
+  VAST_ASSERT(xs.size() == event_ids.size());
+  // Compute the gaps between the non-nil values before modifying anything.
+  auto off = offset();
+  auto nils = nils_;
+  value_batch values;
+  values.reserve(xs.size());
+  for (auto i = 0u; i < xs.size(); ++i) {
+    auto id = event_ids[i];
+    if (id < off)
+      // Can only append at the end.
+      return make_error(ec::unspecified, id, '<', off);
+    if (is<none>(xs[i])) {
+      ++nils;
+    } else {
+      values.emplace_back(&xs[i], id - off + nils);
+      nils = 0;
+    }
+    off = id + 1;
+  }
+  if (!values.empty() && !append_impl(values))
+    return make_error(ec::unspecified, "append_impl");
+  nils_ = nils;
+  // Update mask and nil bitmaps.
+  detail::bit_appender<ewah_bitmap> mask{mask_};
+  detail::bit_appender<ewah_bitmap> nones{none_};
+  off = offset();
+  for (auto i = 0u; i < xs.size(); ++i) {
+    auto skip = event_ids[i] - off;
+    nones.append(false, skip);
+    nones.append(is<none>(xs[i]), 1);
+    mask.append(false, skip);
+    mask.append(true, 1);
+    off = event_ids[i] + 1;
+  }
+  return {};
+}
+
 expected<ids> value_index::lookup(relational_operator op, const data& x) const {
   if (is<none>(x)) {
     if (!(op == equal || op == not_equal))
@@ -190,19 +245,43 @@ expected<ids> value_index::lookup(relational_operator op, const data& x) const {
   return (*result - none_) & mask_;
 }
 
+expected<ids> value_index::lookup(relational_operator op, const data& x,
+                                  const ids& restriction) const {
+  ids candidates = restriction & mask_;
+  if (candidates.empty() || all<0>(candidates))
+    return ids{};
+  auto result = lookup(op, x);
+  if (!result)
+    return result;
+  return *result & candidates;
+}
+
 value_index::size_type value_index::offset() const {
   return mask_.size(); // none_ would work just as well.
 }
 
+size_t value_index::memusage() const {
+  return mask_.memusage() + none_.memusage() + memusage_impl();
+}
 
-string_index::string_index(size_t max_length) : max_length_{max_length} {
+bool value_index::append_impl(const value_batch& xs) {
+  for (auto& x : xs)
+    if (!push_back_impl(*x.first, x.second))
+      return false;
+  return true;
+}
+
+
+string_index::string_index(size_t max_length, bool trigrams)
+  : max_length_{max_length},
+    trigrams_{trigrams} {
 }
 
 void string_index::init() {
   if (length_.coder().storage().empty()) {
-    size_t components = std::log10(max_length_);
-    if (max_length_ % 10 != 0)
-      ++components;
+    // Use as many digits as max_length_ has, so that chopped strings do not
+    // wrap around to length 0 when max_length_ is a power of 10.
+    size_t components = std::log10(max_length_) + 1;
     length_ = length_bitmap_index{base::uniform(10, components)};
   }
 }
@@ -221,10 +300,68 @@ bool string_index::push_back_impl(const data& x, size_type skip) {
     auto gap = length_.size() - chars_[i].size();
     chars_[i].push_back(static_cast<uint8_t>((*str)[i]), gap + skip);
   }
+  if (trigrams_)
+    add_trigrams(*str, length_.size() + skip);
   length_.push_back(length, skip);
   return true;
 }
 
+void string_index::add_trigrams(const std::string& str, size_type pos) {
+  auto length = std::min(str.size(), max_length_);
+  if (length < 3)
+    return;
+  std::vector<trigram> xs;
+  xs.reserve(length - 2);
+  for (auto i = 0u; i + 2 < length; ++i)
+    xs.push_back(static_cast<uint8_t>(str[i]) << 16
+                 | static_cast<uint8_t>(str[i + 1]) << 8
+                 | static_cast<uint8_t>(str[i + 2]));
+  std::sort(xs.begin(), xs.end());
+  xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+  for (auto x : xs) {
+    auto& bm = postings_[x];
+    bm.append_bits(false, pos - bm.size());
+    bm.append_bit(true);
+  }
+}
+
+bool string_index::append_impl(const value_batch& xs) {
+  init();
+  // Collect the characters per position, along with the gap to the previous
+  // character at the same position.
+  using char_batch = std::vector<std::pair<uint8_t, size_type>>;
+  std::vector<char_batch> chars;
+  std::vector<size_type> next;
+  std::vector<std::pair<uint32_t, size_type>> lengths;
+  lengths.reserve(xs.size());
+  auto pos = length_.size();
+  for (auto& x : xs) {
+    auto str = get_if<std::string>(*x.first);
+    if (!str)
+      return false;
+    pos += x.second;
+    auto length = std::min(str->size(), max_length_);
+    for (auto i = chars.size(); i < length; ++i)
+      next.push_back(i < chars_.size() ? chars_[i].size() : 0);
+    if (length > chars.size())
+      chars.resize(length);
+    for (auto i = 0u; i < length; ++i) {
+      chars[i].emplace_back(static_cast<uint8_t>((*str)[i]), pos - next[i]);
+      next[i] = pos + 1;
+    }
+    if (trigrams_)
+      add_trigrams(*str, pos);
+    lengths.emplace_back(length, x.second);
+    ++pos;
+  }
+  if (chars.size() > chars_.size())
+    chars_.resize(chars.size(), char_bitmap_index{8});
+  for (auto i = 0u; i < chars.size(); ++i)
+    chars_[i].append_batch(chars[i].begin(), chars[i].end());
+  length_.append_batch(lengths.begin(), lengths.end());
+  return true;
+}
+
 expected<ids>
 string_index::lookup_impl(relational_operator op, const data& x) const {
   return visit(detail::overload(
@@ -267,7 +404,18 @@ string_index::lookup_impl(relational_operator op, const data& x) const {
             return bitmap{length_.size(), op == ni};
           if (str_size > chars_.size())
             return bitmap{length_.size(), op == not_ni};
-          // TODO: Be more clever than iterating over all k-grams (#45).
+          if (trigrams_ && str_size >= 3) {
+            bitmap result{length_.size(), false};
+            result |= lookup_trigrams(str.substr(0, str_size));
+            if (op == not_ni) {
+              // Beyond a single trigram, the complement of the candidates
+              // may miss strings, so a negated lookup cannot rule out any.
+              if (str_size > 3)
+                return bitmap{length_.size(), true};
+              result.flip();
+            }
+            return result;
+          }
           bitmap result{length_.size(), false};
           for (auto i = 0u; i < chars_.size() - str_size + 1; ++i) {
             bitmap substr{length_.size(), true};
@@ -289,11 +437,228 @@ string_index::lookup_impl(relational_operator op, const data& x) const {
         }
       }
     },
+    [&](const pattern& pat) { return lookup_pattern(op, pat); },
     [&](const vector& xs) { return detail::container_lookup(*this, op, xs); },
     [&](const set& xs) { return detail::container_lookup(*this, op, xs); }
   ), x);
 }
 
+expected<ids>
+string_index::lookup_pattern(relational_operator op, const pattern& pat) const {
+  if (!(op == match || op == not_match || op == in || op == not_in))
+    return make_error(ec::unsupported_operator, op);
+  auto negated = op == not_match || op == not_in;
+  auto constraints = detail::derive_constraints(
+    pat.string(), op == match || op == not_match);
+  // A pattern without wildcards amounts to a string comparison, provided
+  // that no string got chopped in the compared range.
+  if (constraints.literal && constraints.literal->size() < max_length_)
+    return lookup_impl(negated ? not_equal : equal, *constraints.literal);
+  // Otherwise, the constraints yield only candidates. Since the complement of
+  // the candidates may miss matching strings, a negated pattern cannot rule
+  // out any string.
+  bitmap result{length_.size(), true};
+  if (negated)
+    return result;
+  // Every candidate begins with the prefix, as far as we store it.
+  auto prefix = std::min(constraints.prefix.size(), max_length_);
+  if (prefix > 0) {
+    if (prefix > chars_.size())
+      return bitmap{length_.size(), false};
+    for (auto i = 0u; i < prefix; ++i) {
+      auto c = static_cast<uint8_t>(constraints.prefix[i]);
+      result &= chars_[i].lookup(equal, c);
+      if (result.empty() || all<0>(result))
+        return result;
+    }
+  }
+  // Every candidate contains the substrings, unless chopping removed them.
+  if (constraints.substrings.empty())
+    return result;
+  auto chopped = length_.lookup(equal, max_length_);
+  for (auto& str : constraints.substrings) {
+    if (str.size() > max_length_)
+      continue;
+    auto hits = lookup_impl(ni, str);
+    if (!hits)
+      return hits;
+    result &= *hits | chopped;
+    if (result.empty() || all<0>(result))
+      return result;
+  }
+  return result;
+}
+
+ids string_index::lookup_trigrams(const std::string& str) const {
+  VAST_ASSERT(str.size() >= 3);
+  // Candidates are all strings that contain every trigram of the substring.
+  ids result;
+  for (auto i = 0u; i + 2 < str.size(); ++i) {
+    trigram x = static_cast<uint8_t>(str[i]) << 16
+                | static_cast<uint8_t>(str[i + 1]) << 8
+                | static_cast<uint8_t>(str[i + 2]);
+    auto posting = postings_.find(x);
+    if (posting == postings_.end())
+      return {};
+    if (i == 0)
+      result = posting->second;
+    else
+      result &= posting->second;
+    if (result.empty() || all<0>(result))
+      return {};
+  }
+  return result;
+}
+
+size_t string_index::memusage_impl() const {
+  auto result = length_.memusage();
+  result += (chars_.capacity() - chars_.size()) * sizeof(char_bitmap_index);
+  for (auto& x : chars_)
+    result += x.memusage();
+  for (auto& x : postings_)
+    result += sizeof(x) + x.second.memusage();
+  return result;
+}
+
+dictionary_index::dictionary_index(size_t max_length, size_t max_cardinality)
+  : max_length_{max_length},
+    max_cardinality_{max_cardinality},
+    fallback_{max_length} {
+}
+
+size_t dictionary_index::cardinality() const {
+  return strings_.size();
+}
+
+bool dictionary_index::positional() const {
+  return positional_;
+}
+
+bool dictionary_index::push_back_impl(const data& x, size_type skip) {
+  auto str = get_if<std::string>(x);
+  if (!str)
+    return false;
+  auto pos = size_ + skip;
+  size_ = pos + 1;
+  if (positional_)
+    return static_cast<bool>(fallback_.push_back(x, pos));
+  auto key = str->substr(0, max_length_);
+  auto i = dictionary_.find(key);
+  if (i == dictionary_.end()) {
+    if (strings_.size() == max_cardinality_)
+      return migrate() && fallback_.push_back(x, pos);
+    i = dictionary_.emplace(key, strings_.size()).first;
+    strings_.push_back(std::move(key));
+    postings_.emplace_back();
+  }
+  auto& bm = postings_[i->second];
+  bm.append_bits(false, pos - bm.size());
+  bm.append_bit(true);
+  return true;
+}
+
+bool dictionary_index::migrate() {
+  VAST_ASSERT(!positional_);
+  // Restore the original order of the values from the postings.
+  std::vector<std::pair<size_type, uint32_t>> rows;
+  for (auto i = 0u; i < postings_.size(); ++i)
+    for (auto pos : select(postings_[i]))
+      rows.emplace_back(pos, i);
+  std::sort(rows.begin(), rows.end());
+  std::vector<data> xs;
+  std::vector<event_id> event_ids;
+  xs.reserve(rows.size());
+  event_ids.reserve(rows.size());
+  for (auto& row : rows) {
+    xs.emplace_back(strings_[row.second]);
+    event_ids.push_back(row.first);
+  }
+  if (!fallback_.append(xs, event_ids))
+    return false;
+  positional_ = true;
+  strings_ = {};
+  postings_ = {};
+  dictionary_ = {};
+  return true;
+}
+
+expected<ids>
+dictionary_index::lookup_impl(relational_operator op, const data& x) const {
+  if (positional_)
+    return fallback_.lookup(op, x);
+  return visit(detail::overload(
+    [&](const auto& x) -> expected<ids> {
+      return make_error(ec::type_clash, x);
+    },
+    [&](const std::string& str) -> expected<ids> {
+      switch (op) {
+        default:
+          return make_error(ec::unsupported_operator, op);
+        case equal:
+        case not_equal: {
+          bitmap result{size_, false};
+          auto i = dictionary_.find(str.substr(0, max_length_));
+          if (i != dictionary_.end())
+            result |= postings_[i->second];
+          if (op == not_equal)
+            result.flip();
+          return result;
+        }
+        case ni:
+        case not_ni: {
+          auto needle = str.substr(0, max_length_);
+          if (needle.empty())
+            return bitmap{size_, op == ni};
+          // Each distinct value gets checked only once, regardless of how
+          // often it occurs.
+          bitmap result{size_, false};
+          for (auto i = 0u; i < strings_.size(); ++i)
+            if (strings_[i].find(needle) != std::string::npos)
+              result |= postings_[i];
+          if (op == not_ni)
+            result.flip();
+          return result;
+        }
+      }
+    },
+    [&](const pattern& pat) -> expected<ids> {
+      if (!(op == match || op == not_match || op == in || op == not_in))
+        return make_error(ec::unsupported_operator, op);
+      // Each distinct value gets checked only once. A chopped value may
+      // match either way, so it remains a candidate regardless of the
+      // operator.
+      auto full = op == match || op == not_match;
+      auto negated = op == not_match || op == not_in;
+      bitmap result{size_, false};
+      try {
+        for (auto i = 0u; i < strings_.size(); ++i) {
+          auto& str = strings_[i];
+          auto hit = full ? pat.match(str) : pat.search(str);
+          if (hit != negated || str.size() == max_length_)
+            result |= postings_[i];
+        }
+      } catch (const std::regex_error& e) {
+        return make_error(ec::invalid_query, e.what());
+      }
+      return result;
+    },
+    [&](const vector& xs) { return detail::container_lookup(*this, op, xs); },
+    [&](const set& xs) { return detail::container_lookup(*this, op, xs); }
+  ), x);
+}
+
+size_t dictionary_index::memusage_impl() const {
+  auto result = fallback_.memusage();
+  for (auto& x : strings_)
+    result += sizeof(x) + x.capacity();
+  for (auto& x : postings_)
+    result += x.memusage();
+  // Each dictionary entry holds another copy of the string plus the ID.
+  for (auto& x : dictionary_)
+    result += sizeof(x) + x.first.capacity();
+  return result;
+}
+
 void address_index::init() {
   if (bytes_[0].coder().storage().empty())
     // Initialize on first to make deserialization feasible.
@@ -369,6 +734,13 @@ address_index::lookup_impl(relational_operator op, const data& d) const {
   ), d);
 }
 
+size_t address_index::memusage_impl() const {
+  auto result = v4_.memusage();
+  for (auto& x : bytes_)
+    result += x.memusage();
+  return result;
+}
+
 void subnet_index::init() {
   if (length_.coder().storage().empty())
     length_ = prefix_index{128 + 1}; // Valid prefixes range from /0 to /128.
@@ -442,6 +814,9 @@ subnet_index::lookup_impl(relational_operator op, const data& d) const {
   ), d);
 }
 
+size_t subnet_index::memusage_impl() const {
+  return network_.memusage() + length_.memusage();
+}
 
 void port_index::init() {
   if (num_.coder().storage().empty()) {
@@ -460,6 +835,24 @@ bool port_index::push_back_impl(const data& x, size_type skip) {
   return false;
 }
 
+bool port_index::append_impl(const value_batch& xs) {
+  std::vector<std::pair<port::number_type, size_type>> numbers;
+  std::vector<std::pair<uint8_t, size_type>> protocols;
+  numbers.reserve(xs.size());
+  protocols.reserve(xs.size());
+  for (auto& x : xs) {
+    auto p = get_if<port>(*x.first);
+    if (!p)
+      return false;
+    numbers.emplace_back(p->number(), x.second);
+    protocols.emplace_back(p->type(), x.second);
+  }
+  init();
+  num_.append_batch(numbers.begin(), numbers.end());
+  proto_.append_batch(protocols.begin(), protocols.end());
+  return true;
+}
+
 expected<ids>
 port_index::lookup_impl(relational_operator op, const data& d) const {
   if (offset() == 0) // FIXME: why do we need this check again?
@@ -483,6 +876,9 @@ port_index::lookup_impl(relational_operator op, const data& d) const {
   ), d);
 }
 
+size_t port_index::memusage_impl() const {
+  return num_.memusage() + proto_.memusage();
+}
 
 sequence_index::sequence_index(vast::type t, size_t max_size)
   : max_size_{max_size},
@@ -527,6 +923,14 @@ sequence_index::lookup_impl(relational_operator op, const data& x) const {
   return result;
 }
 
+size_t sequence_index::memusage_impl() const {
+  auto result = size_.memusage();
+  for (auto& x : elements_)
+    if (x)
+      result += x->memusage();
+  return result;
+}
+
 void serialize(caf::serializer& sink, const sequence_index& idx) {
   sink & static_cast<const value_index&>(idx);
   sink & idx.value_type_;
@@ -578,4 +982,12 @@ void serialize(caf::deserializer& source, sequence_index& idx) {
     throw std::runtime_error{to_string(e)};
 }
 
+namespace detail {
+
+bool uses_string_index(const string_type& t) {
+  // Substring lookups via trigrams require the positional encoding.
+  return has_attribute(t, "trigrams");
+}
+
+} // namespace detail
 } // namespace vast
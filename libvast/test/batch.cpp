@@ -64,6 +64,25 @@ TEST(events with IDs) {
   CHECK_EQUAL(xs->back().id(), 666u + 990);
 }
 
+TEST(first and last ID) {
+  batch::writer writer{compression::null};
+  for (auto& e : events)
+    REQUIRE(writer.write(e));
+  auto b = writer.seal();
+  CHECK_EQUAL(b.first_id(), invalid_event_id);
+  CHECK_EQUAL(b.last_id(), invalid_event_id);
+  REQUIRE(b.ids(666, 666 + 1000));
+  CHECK_EQUAL(b.first_id(), 666u);
+  CHECK_EQUAL(b.last_id(), 1665u);
+  MESSAGE("recompute the IDs after deserialization");
+  std::vector<char> buf;
+  REQUIRE(save(buf, b));
+  batch c;
+  REQUIRE(load(buf, c));
+  CHECK_EQUAL(c.first_id(), 666u);
+  CHECK_EQUAL(c.last_id(), 1665u);
+}
+
 TEST(events without IDs) {
   batch::writer writer{compression::lz4};
   for (auto i = 0; i < 42; ++i)
@@ -81,4 +100,103 @@ TEST(events without IDs) {
   CHECK_EQUAL(xs->back(), event::make(41, event_type));
 }
 
+TEST(columnar events) {
+  auto t = type{record_type{
+    {"s", string_type{}},
+    {"r", record_type{
+      {"c", count_type{}},
+      {"x", real_type{}}
+    }},
+    {"v", vector_type{integer_type{}}}
+  }}.name("bar");
+  std::vector<event> xs;
+  for (auto i = 0; i < 100; ++i) {
+    auto str = i % 2 == 0 ? data{"foo"} : data{"bar"};
+    auto r = i % 10 == 0 ? data{} : data{vector{count(i), data{}}};
+    xs.push_back(event::make(vector{str, r, vector{i, -i}}, t));
+    xs.back().id(i);
+  }
+  batch::writer writer{compression::lz4, batch::encoding::columnar};
+  for (auto i = 0u; i < xs.size(); ++i) {
+    REQUIRE(writer.write(xs[i]));
+    // Interleave events of another type.
+    if (i % 3 == 0)
+      REQUIRE(writer.write(events[i]));
+  }
+  auto b = writer.seal();
+  MESSAGE("read all events");
+  batch::reader reader{b};
+  auto ys = reader.read();
+  REQUIRE(ys);
+  REQUIRE_EQUAL(ys->size(), 134u);
+  CHECK_EQUAL((*ys)[0], event::make(xs[0].data(), t));
+  CHECK_EQUAL((*ys)[1].type(), event_type);
+  CHECK_EQUAL((*ys)[1].data(), events[0].data());
+  CHECK_EQUAL((*ys)[2].data(), xs[1].data());
+  // The last event of the other type follows the last columnar event.
+  CHECK_EQUAL((*ys)[132].data(), xs.back().data());
+  CHECK_EQUAL(ys->back().data(), events[99].data());
+  MESSAGE("read selected columns");
+  b.ids(0, 134);
+  batch::reader partial{b};
+  auto only_count = [](const type&, const offset& o) {
+    return o == offset{1, 0};
+  };
+  ys = partial.read(make_ids({{2, 3}}), only_count);
+  REQUIRE(ys);
+  REQUIRE_EQUAL(ys->size(), 1u);
+  CHECK_EQUAL(ys->front().data(), data(vector{nil, vector{1u, nil}, nil}));
+}
+
+TEST(random access) {
+  auto t = type{string_type{}}.name("bar");
+  std::vector<event> xs;
+  for (auto i = 0; i < 5000; ++i) {
+    if (i % 2 == 0)
+      xs.push_back(event::make(i, event_type));
+    else
+      xs.push_back(event::make(std::to_string(i), t));
+    xs.back().id(i);
+  }
+  batch::writer writer{compression::lz4};
+  for (auto& x : xs)
+    REQUIRE(writer.write(x));
+  auto b = writer.seal();
+  b.ids(0, 5000);
+  MESSAGE("skip blocks before the requested events");
+  batch::reader reader{b};
+  auto ys = reader.read(make_ids({{10, 11}, {2047, 2050}, {4999, 5000}}));
+  REQUIRE(ys);
+  REQUIRE_EQUAL(ys->size(), 5u);
+  CHECK_EQUAL((*ys)[0], xs[10]);
+  CHECK_EQUAL((*ys)[1], xs[2047]);
+  CHECK_EQUAL((*ys)[2], xs[2048]);
+  CHECK_EQUAL((*ys)[3], xs[2049]);
+  CHECK_EQUAL((*ys)[4], xs[4999]);
+  MESSAGE("seek into a block");
+  batch::reader single{b};
+  ys = single.read(make_ids({{3333, 3334}}));
+  REQUIRE(ys);
+  REQUIRE_EQUAL(ys->size(), 1u);
+  CHECK_EQUAL(ys->front(), xs[3333]);
+  CHECK_EQUAL(ys->front().type(), t);
+  MESSAGE("seek with IDs that are not contiguous");
+  bitmap even;
+  for (auto i = 0; i < 5000; ++i) {
+    even.append_bit(true);
+    even.append_bit(false);
+  }
+  REQUIRE(b.ids(even));
+  CHECK_EQUAL(b.first_id(), 0u);
+  CHECK_EQUAL(b.last_id(), 9998u);
+  batch::reader sparse{b};
+  ys = sparse.read(make_ids({{4094, 4099}}));
+  REQUIRE(ys);
+  REQUIRE_EQUAL(ys->size(), 3u);
+  CHECK_EQUAL((*ys)[0].id(), 4094u);
+  CHECK_EQUAL((*ys)[0].data(), xs[2047].data());
+  CHECK_EQUAL((*ys)[2].id(), 4098u);
+  CHECK_EQUAL((*ys)[2].data(), xs[2049].data());
+}
+
 FIXTURE_SCOPE_END()
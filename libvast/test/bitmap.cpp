@@ -11,9 +11,12 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <random>
+
 #include "vast/bitmap.hpp"
 #include "vast/ewah_bitmap.hpp"
 #include "vast/null_bitmap.hpp"
+#include "vast/roaring_bitmap.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/bitmap.hpp"
 
@@ -382,6 +385,14 @@ TEST(wah_bitmap) {
 
 FIXTURE_SCOPE_END()
 
+FIXTURE_SCOPE(roaring_bitmap_tests, bitmap_test_harness<roaring_bitmap>)
+
+TEST(roaring_bitmap) {
+  execute();
+}
+
+FIXTURE_SCOPE_END()
+
 FIXTURE_SCOPE(bitmap_tests, bitmap_test_harness<bitmap>)
 
 TEST(bitmap) {
@@ -754,6 +765,198 @@ TEST(EWAH bitwise NAND) {
   CHECK(to_block_string(bm2 - bm3), str);
 }
 
+namespace {
+
+// Generates an EWAH bitmap that alternates between clean runs and dirty
+// blocks.
+ewah_bitmap make_mixed_ewah(std::mt19937_64& gen, size_t size) {
+  ewah_bitmap bm;
+  while (bm.size() < size) {
+    auto n = std::min<size_t>(size - bm.size(), 1 + gen() % 500);
+    switch (gen() % 3) {
+      case 0:
+        bm.append_bits(false, n);
+        break;
+      case 1:
+        bm.append_bits(true, n);
+        break;
+      default:
+        for (auto i = 0u; i < n; ++i)
+          bm.append_bit(gen() % 3 == 0);
+    }
+  }
+  return bm;
+}
+
+} // namespace <anonymous>
+
+TEST(EWAH specialized algorithms) {
+  std::mt19937_64 gen{42};
+  for (auto n : {2u, 63u, 64u, 65u, 1000u, 100000u}) {
+    MESSAGE("bitmaps with " << n << " bits");
+    auto x = make_mixed_ewah(gen, n);
+    auto y = make_mixed_ewah(gen, n);
+    CHECK_EQUAL(binary_and(x, y),
+                (binary_eval<false, false>(x, y, detail::and_op{})));
+    CHECK_EQUAL(binary_or(x, y),
+                (binary_eval<true, true>(x, y, detail::or_op{})));
+    CHECK_EQUAL(binary_xor(x, y),
+                (binary_eval<true, true>(x, y, detail::xor_op{})));
+    CHECK_EQUAL(binary_nand(x, y),
+                (binary_eval<true, false>(x, y, detail::nand_op{})));
+    CHECK_EQUAL(binary_nand(y, x),
+                (binary_eval<true, false>(y, x, detail::nand_op{})));
+    CHECK_EQUAL(rank(x), rank<1>(x, n - 1));
+    CHECK_EQUAL(rank<0>(x), rank<0>(x, n - 1));
+    CHECK_EQUAL(rank(bitmap{x}), rank(x));
+  }
+  MESSAGE("n-ary OR");
+  std::vector<bitmap> xs;
+  for (auto i = 0; i < 5; ++i)
+    xs.emplace_back(make_mixed_ewah(gen, 5000));
+  auto expected = xs[0];
+  for (auto i = 1u; i < xs.size(); ++i)
+    expected |= xs[i];
+  CHECK_EQUAL(nary_or(xs), expected);
+  CHECK_EQUAL(nary_or(std::vector<bitmap>{}), bitmap{});
+  MESSAGE("n-ary OR with a long leading run");
+  // Without restricting the buffer to the span with 1s, this would allocate
+  // 512 MB.
+  auto offset = ewah_bitmap::size_type{1} << 32;
+  xs.clear();
+  for (auto i = 0; i < 5; ++i) {
+    ewah_bitmap x;
+    x.append_bits(false, offset);
+    x.append(make_mixed_ewah(gen, 5000));
+    x.append_bits(false, 1000);
+    xs.emplace_back(std::move(x));
+  }
+  expected = xs[0];
+  for (auto i = 1u; i < xs.size(); ++i)
+    expected |= xs[i];
+  CHECK_EQUAL(nary_or(xs), expected);
+  MESSAGE("n-ary OR over runs");
+  xs.clear();
+  for (auto i = 0; i < 5; ++i) {
+    ewah_bitmap x;
+    x.append_bits(false, offset + i * 100000);
+    x.append_bits(true, 1000000);
+    x.append_bits(false, 10);
+    xs.emplace_back(std::move(x));
+  }
+  expected = xs[0];
+  for (auto i = 1u; i < xs.size(); ++i)
+    expected |= xs[i];
+  CHECK_EQUAL(nary_or(xs), expected);
+  MESSAGE("n-ary OR without 1s");
+  xs.assign(3, bitmap{ewah_bitmap{offset, false}});
+  CHECK_EQUAL(nary_or(xs), xs[0]);
+}
+
+TEST(Roaring containers) {
+  using container = roaring_bitmap::container;
+  roaring_bitmap bm;
+  MESSAGE("sparse chunk");
+  bm.append_bits(false, 100);
+  bm.append_bit(true);
+  bm.append_bits(false, 1000);
+  bm.append_bit(true);
+  MESSAGE("chunk with a single run");
+  bm.append_bits(false, roaring_bitmap::chunk_size - bm.size());
+  bm.append_bits(true, 30000);
+  MESSAGE("dense chunk");
+  bm.append_bits(false, 2 * roaring_bitmap::chunk_size - bm.size());
+  for (auto i = 0u; i < roaring_bitmap::chunk_size; ++i)
+    bm.append_bit(i % 3 == 0);
+  MESSAGE("gap of empty chunks");
+  bm.append_bits(false, 10 * roaring_bitmap::chunk_size);
+  bm.append_bit(true);
+  auto& chunks = bm.chunks();
+  REQUIRE_EQUAL(chunks.size(), 4u);
+  CHECK_EQUAL(chunks[0].type, container::array);
+  CHECK_EQUAL(chunks[1].type, container::run);
+  CHECK_EQUAL(chunks[2].type, container::bitset);
+  CHECK_EQUAL(chunks[3].key, 13u);
+  CHECK_EQUAL(rank(bm), 2u + 30000u + 21846u + 1u);
+  CHECK_EQUAL(rank(bm), rank<1>(bm, bm.size() - 1));
+  MESSAGE("element access");
+  CHECK(!bm[99]);
+  CHECK(bm[100]);
+  CHECK(bm[1101]);
+  CHECK(bm[roaring_bitmap::chunk_size + 29999]);
+  CHECK(!bm[roaring_bitmap::chunk_size + 30000]);
+  CHECK(bm[2 * roaring_bitmap::chunk_size + 3]);
+  CHECK(!bm[2 * roaring_bitmap::chunk_size + 4]);
+  CHECK(!bm[5 * roaring_bitmap::chunk_size]);
+  CHECK(bm[bm.size() - 1]);
+  MESSAGE("complement");
+  auto complement = ~bm;
+  CHECK_EQUAL(rank(complement), bm.size() - rank(bm));
+  CHECK(complement[99]);
+  CHECK(!complement[100]);
+  CHECK(complement[5 * roaring_bitmap::chunk_size]);
+  CHECK_EQUAL(~complement, bm);
+}
+
+TEST(Roaring specialized algorithms) {
+  std::mt19937_64 gen{42};
+  for (auto n : {2u, 64u, 1000u, 100000u, 300000u}) {
+    MESSAGE("bitmaps with " << n << " bits");
+    roaring_bitmap x;
+    roaring_bitmap y;
+    for (auto i = 0u; i < n; ++i) {
+      // Alternate between sparse and dense regions in both bitmaps.
+      auto dense = (i / 20000) % 2 == 0;
+      x.append_bit(gen() % (dense ? 2 : 500) == 0);
+      y.append_bit(gen() % (dense ? 500 : 2) == 0);
+    }
+    CHECK_EQUAL(binary_and(x, y),
+                (binary_eval<false, false>(x, y, detail::and_op{})));
+    CHECK_EQUAL(binary_or(x, y),
+                (binary_eval<true, true>(x, y, detail::or_op{})));
+    CHECK_EQUAL(binary_xor(x, y),
+                (binary_eval<true, true>(x, y, detail::xor_op{})));
+    CHECK_EQUAL(binary_nand(x, y),
+                (binary_eval<true, false>(x, y, detail::nand_op{})));
+    CHECK_EQUAL(binary_nand(y, x),
+                (binary_eval<true, false>(y, x, detail::nand_op{})));
+    CHECK_EQUAL(rank(x), rank<1>(x, n - 1));
+  }
+}
+
+TEST(mixed bitmap types) {
+  std::mt19937_64 gen{42};
+  auto n = 100000u;
+  roaring_bitmap x;
+  null_bitmap y;
+  ewah_bitmap z;
+  for (auto i = 0u; i < n; ++i) {
+    auto dense = (i / 10000) % 2 == 0;
+    auto bit = gen() % (dense ? 2 : 1000) == 0;
+    x.append_bit(bit);
+    y.append_bit(bit);
+    z.append_bit(bit);
+  }
+  z.append_bits(true, 100);
+  MESSAGE("equal content");
+  auto rx = bitmap{x};
+  auto ry = bitmap{y};
+  CHECK_EQUAL(to_string(rx & ry), to_string(x));
+  CHECK_EQUAL(to_string(ry | rx), to_string(x));
+  CHECK(all<0>(rx ^ ry));
+  CHECK(all<0>(rx - ry));
+  MESSAGE("different sizes");
+  auto rz = bitmap{z};
+  auto tail = std::string(100, '0');
+  CHECK_EQUAL(to_string(rx & rz), to_string(x) + tail);
+  CHECK_EQUAL(to_string(rz - rx), std::string(n, '0') + std::string(100, '1'));
+  CHECK_EQUAL(to_string(rx | rz), to_string(z));
+  MESSAGE("conversion");
+  roaring_bitmap converted;
+  converted.append(z);
+  CHECK_EQUAL(to_string(converted), to_string(z));
+}
+
 TEST(EWAH block append) {
   ewah_bitmap bm;
   bm.append_bits(true, 10);
@@ -0,0 +1,53 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/bloom_filter.hpp"
+#include "vast/load.hpp"
+#include "vast/save.hpp"
+
+#define SUITE bloom_filter
+#include "test.hpp"
+
+using namespace vast;
+
+TEST(bloom filter) {
+  bloom_filter bf{1024, 3};
+  CHECK_EQUAL(bf.size(), 1024u);
+  CHECK_EQUAL(bf.num_hashes(), 3u);
+  MESSAGE("lookup in empty filter");
+  CHECK(!bf.lookup(42));
+  MESSAGE("add and lookup");
+  for (auto i = 0u; i < 10; ++i)
+    bf.add(i * 0x9e3779b97f4a7c15ull);
+  for (auto i = 0u; i < 10; ++i)
+    CHECK(bf.lookup(i * 0x9e3779b97f4a7c15ull));
+  MESSAGE("false positive rate");
+  auto false_positives = 0u;
+  for (auto i = 10u; i < 1010; ++i)
+    if (bf.lookup(i * 0x9e3779b97f4a7c15ull))
+      ++false_positives;
+  CHECK_LESS(false_positives, 10u);
+  MESSAGE("serialization");
+  std::string buf;
+  REQUIRE(save(buf, bf));
+  bloom_filter bf2;
+  REQUIRE(load(buf, bf2));
+  CHECK(bf == bf2);
+}
+
+TEST(default constructed bloom filter) {
+  bloom_filter bf;
+  CHECK(bf.empty());
+  CHECK(!bf.lookup(42));
+}
@@ -47,6 +47,16 @@ TEST(LRU cache lookup) {
   CHECK_EQUAL(*i, *xs.rbegin());
 }
 
+TEST(LRU cache peeking) {
+  auto i = xs.peek("bar");
+  REQUIRE(i != xs.end());
+  CHECK_EQUAL(i->second, 2);
+  // The eviction order remains unchanged.
+  CHECK_EQUAL(xs.begin()->first, "foo");
+  CHECK_EQUAL(xs.rbegin()->first, "qux");
+  CHECK(xs.peek("corge") == xs.end());
+}
+
 TEST(LRU cache eviction) {
   auto i = 0;
   xs.on_evict([&](std::string&, int x) { i = x; });
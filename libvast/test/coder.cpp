@@ -325,6 +325,35 @@ TEST(multi-level range coder) {
   }
 }
 
+TEST(batch encoding) {
+  using pair = std::pair<size_t, null_bitmap::size_type>;
+  std::vector<pair> xs{{4, 0}, {7, 0}, {4, 2}, {3, 0}, {3, 0}, {0, 5}, {1, 0}};
+  for (auto i = 0u; i < 300; ++i)
+    xs.emplace_back(i % 3 == 0 ? 7 : i % 8, i % 100 == 0 ? 70 : 0);
+  auto check = [&](auto x) {
+    auto y = x;
+    for (auto& p : xs)
+      x.encode(p.first, 1, p.second);
+    y.encode_batch(xs.begin(), xs.end());
+    return x == y;
+  };
+  CHECK(check(equality_coder<null_bitmap>{8}));
+  CHECK(check(range_coder<null_bitmap>{8}));
+  CHECK(check(bitslice_coder<null_bitmap>{8}));
+  CHECK(check(multi_level_coder<range_coder<null_bitmap>>{base{2, 2, 2}}));
+  MESSAGE("append to existing bitmaps");
+  range_coder<null_bitmap> x{8};
+  x.encode(5, 10);
+  auto y = x;
+  x.encode(2, 1, 3);
+  x.encode(6);
+  std::vector<pair> ys{{2, 3}, {6, 0}};
+  y.encode_batch(ys.begin(), ys.end());
+  CHECK_EQUAL(x.size(), 15u);
+  CHECK_EQUAL(to_string(y.decode(equal, 2)), to_string(x.decode(equal, 2)));
+  CHECK(x == y);
+}
+
 TEST(serialization range coder) {
   range_coder<null_bitmap> x{100}, y;
   x.encode(42);
@@ -208,6 +208,11 @@ TEST(matcher) {
   CHECK(!match("&type == \"foo\"", r));
   r.name("foo");
   CHECK(match("&type == \"foo\"", r));
+  CHECK(!match("&type != \"foo\"", r));
+  CHECK(!match("&type == \"bar\"", r));
+  CHECK(match("&type != \"bar\"", r));
+  CHECK(match("&type == \"bar\" || &type == \"foo\"", r));
+  CHECK(!match("&type != \"bar\" && &type != \"foo\"", r));
 }
 
 FIXTURE_SCOPE_END()
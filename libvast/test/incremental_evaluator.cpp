@@ -0,0 +1,94 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/incremental_evaluator.hpp"
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/expression.hpp"
+
+#define SUITE expression
+#include "test.hpp"
+
+using namespace vast;
+
+namespace {
+
+predicate make_predicate(const std::string& str) {
+  auto pred = to<predicate>(str);
+  REQUIRE(pred);
+  return *pred;
+}
+
+// Checks whether two ID sets have the same IDs, regardless of their size.
+bool same_ids(const ids& x, const ids& y) {
+  return rank(x) == rank(y) && rank(x & y) == rank(x);
+}
+
+} // namespace <anonymous>
+
+TEST(incremental evaluator - disjunction) {
+  auto expr = to<expression>("a == 1 || b == 2");
+  REQUIRE(expr);
+  incremental_evaluator eval{*expr};
+  CHECK_EQUAL(eval.predicates(), 2u);
+  auto delta = eval.add(make_predicate("a == 1"), make_ids({{0, 4}}));
+  CHECK(same_ids(delta, make_ids({{0, 4}})));
+  CHECK(!eval.done());
+  delta = eval.add(make_predicate("b == 2"), make_ids({{2, 6}}));
+  CHECK(same_ids(delta, make_ids({{4, 6}})));
+  CHECK(same_ids(eval.hits(), make_ids({{0, 6}})));
+  CHECK(eval.done());
+}
+
+TEST(incremental evaluator - conjunction) {
+  auto expr = to<expression>("a == 1 && (b == 2 || c == 3)");
+  REQUIRE(expr);
+  incremental_evaluator eval{*expr};
+  CHECK_EQUAL(eval.predicates(), 3u);
+  auto delta = eval.add(make_predicate("b == 2"), make_ids({{2, 6}}));
+  CHECK_EQUAL(rank(delta), 0u);
+  delta = eval.add(make_predicate("a == 1"), make_ids({{0, 4}, {8, 9}}));
+  CHECK_EQUAL(rank(delta), 0u);
+  CHECK(!eval.done());
+  delta = eval.add(make_predicate("c == 3"), make_ids({{8, 10}}));
+  CHECK(same_ids(delta, make_ids({{2, 4}, {8, 9}})));
+  CHECK(eval.done());
+  MESSAGE("short-circuit on empty operand");
+  eval = incremental_evaluator{*expr};
+  eval.add(make_predicate("a == 1"), ids{});
+  delta = eval.add(make_predicate("b == 2"), make_ids({{2, 6}}));
+  CHECK_EQUAL(rank(delta), 0u);
+  CHECK_EQUAL(rank(eval.hits()), 0u);
+}
+
+TEST(incremental evaluator - negation) {
+  auto pred = make_predicate("a == 1");
+  incremental_evaluator eval{expression{negation{expression{pred}}}};
+  auto hits = make_ids({{0, 2}});
+  hits.append_bits(false, 2);
+  auto delta = eval.add(pred, hits);
+  CHECK(same_ids(delta, make_ids({{2, 4}})));
+}
+
+TEST(incremental evaluator - shared subexpressions) {
+  auto expr = to<expression>("(a == 1 && b == 2) || (a == 1 && c == 3)");
+  REQUIRE(expr);
+  incremental_evaluator eval{*expr};
+  CHECK_EQUAL(eval.predicates(), 3u);
+  eval.add(make_predicate("a == 1"), make_ids({{0, 10}}));
+  auto delta = eval.add(make_predicate("c == 3"), make_ids({{5, 20}}));
+  CHECK(same_ids(delta, make_ids({{5, 10}})));
+  delta = eval.add(make_predicate("b == 2"), make_ids({{0, 3}}));
+  CHECK(same_ids(delta, make_ids({{0, 3}})));
+  CHECK(eval.done());
+}
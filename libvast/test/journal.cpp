@@ -0,0 +1,142 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include <fstream>
+
+#include "vast/journal.hpp"
+#include "vast/load.hpp"
+#include "vast/save.hpp"
+
+#define SUITE journal
+#include "test.hpp"
+
+using namespace vast;
+
+namespace {
+
+struct fixture {
+  fixture() {
+    if (exists(dir))
+      rm(dir);
+  }
+
+  ~fixture() {
+    rm(dir);
+  }
+
+  // Restores a sum from the journal, with records holding the summands.
+  expected<void> restore(journal& j) {
+    sum = 0;
+    return j.replay(
+      [&](const std::vector<char>& buf) { return load(buf, sum); },
+      [&](const std::vector<char>& buf) -> expected<void> {
+        int x;
+        if (auto result = load(buf, x); !result)
+          return result.error();
+        sum += x;
+        return no_error;
+      }
+    );
+  }
+
+  expected<void> add(journal& j, int x) {
+    std::vector<char> buf;
+    if (auto result = save(buf, x); !result)
+      return result.error();
+    return j.append(buf);
+  }
+
+  path dir = "vast-unit-test-journal";
+  int sum = 0;
+};
+
+} // namespace <anonymous>
+
+FIXTURE_SCOPE(journal_tests, fixture)
+
+TEST(append and replay) {
+  journal j{dir};
+  for (auto i = 1; i <= 10; ++i)
+    REQUIRE(add(j, i));
+  CHECK_EQUAL(j.records(), 10u);
+  journal k{dir};
+  REQUIRE(restore(k));
+  CHECK_EQUAL(sum, 55);
+  CHECK_EQUAL(k.records(), 10u);
+}
+
+TEST(compaction) {
+  journal j{dir};
+  for (auto i = 1; i <= 10; ++i)
+    REQUIRE(add(j, i));
+  std::vector<char> buf;
+  REQUIRE(save(buf, 55));
+  REQUIRE(j.compact(buf));
+  CHECK_EQUAL(j.records(), 0u);
+  REQUIRE(add(j, 45));
+  journal k{dir};
+  REQUIRE(restore(k));
+  CHECK_EQUAL(sum, 100);
+  CHECK_EQUAL(k.records(), 1u);
+}
+
+TEST(compaction policy) {
+  journal j{dir};
+  // Without a snapshot, any record outweighs it.
+  CHECK(!j.needs_compaction());
+  REQUIRE(add(j, 1));
+  CHECK(j.needs_compaction());
+  std::vector<char> buf;
+  REQUIRE(save(buf, std::vector<int>(10, 42)));
+  REQUIRE(j.compact(buf));
+  CHECK(!j.needs_compaction());
+  // The log must grow past the snapshot, which the journal remembers across
+  // replays.
+  for (auto i = 0; i < 3; ++i)
+    REQUIRE(add(j, i));
+  CHECK(!j.needs_compaction());
+  journal k{dir};
+  REQUIRE(k.replay(
+    [](const std::vector<char>&) -> expected<void> { return no_error; },
+    [](const std::vector<char>&) -> expected<void> { return no_error; }
+  ));
+  CHECK(!k.needs_compaction());
+  while (!k.needs_compaction())
+    REQUIRE(add(k, 0));
+  CHECK_GREATER(k.records(), 3u);
+}
+
+TEST(torn record) {
+  {
+    journal j{dir};
+    REQUIRE(add(j, 1));
+    REQUIRE(add(j, 2));
+  }
+  // Simulate a crash in the middle of an append.
+  {
+    std::ofstream log{(dir / "log").str(), std::ios::binary | std::ios::app};
+    log.write("\x00\x00\x00\x10\xde\xad", 6);
+  }
+  journal j{dir};
+  REQUIRE(restore(j));
+  CHECK_EQUAL(sum, 3);
+  CHECK_EQUAL(j.records(), 2u);
+  // The journal discards the torn record, so that new records remain
+  // reachable.
+  REQUIRE(add(j, 3));
+  journal k{dir};
+  REQUIRE(restore(k));
+  CHECK_EQUAL(sum, 6);
+}
+
+FIXTURE_SCOPE_END()
@@ -0,0 +1,123 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <fstream>
+#include <vector>
+
+#include "vast/ewah_bitmap.hpp"
+#include "vast/load.hpp"
+#include "vast/mapped_serialization.hpp"
+#include "vast/save.hpp"
+#include "vast/value_index.hpp"
+
+#include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/bitmap.hpp"
+
+#define SUITE mapped_serialization
+#include "test.hpp"
+#include "fixtures/filesystem.hpp"
+
+using namespace vast;
+
+namespace {
+
+ewah_bitmap make_bitmap(size_t n) {
+  ewah_bitmap result;
+  for (auto i = 0u; i < n; ++i) {
+    result.append_bits(i % 3 == 0, i * 7 % 200);
+    result.append_bit(i % 2 == 0);
+  }
+  return result;
+}
+
+} // namespace <anonymous>
+
+FIXTURE_SCOPE(mapped_serialization_tests, fixtures::filesystem)
+
+TEST(mapped bitmaps) {
+  auto filename = directory / "bitmaps";
+  std::vector<ewah_bitmap> xs{make_bitmap(0), make_bitmap(10),
+                              make_bitmap(1000), ewah_bitmap{4242, true}};
+  REQUIRE(save_mapped(filename, xs));
+  std::vector<ewah_bitmap> ys;
+  REQUIRE(load_mapped(filename, ys));
+  REQUIRE_EQUAL(ys.size(), xs.size());
+  CHECK(!ys[0].mapped());
+  for (auto i = 0u; i < xs.size(); ++i) {
+    CHECK_EQUAL(ys[i], xs[i]);
+    CHECK_EQUAL(rank<1>(ys[i]), rank<1>(xs[i]));
+  }
+  MESSAGE("copy on write");
+  REQUIRE(ys[2].mapped());
+  auto y = ys[2];
+  CHECK(y.mapped());
+  y.append_bits(true, 100);
+  CHECK(!y.mapped());
+  CHECK_EQUAL(rank<1>(y), rank<1>(xs[2]) + 100);
+  CHECK_EQUAL(ys[2], xs[2]);
+  MESSAGE("overwrite a mapped file");
+  ys[2] = y;
+  REQUIRE(save_mapped(filename, ys));
+  CHECK_EQUAL(ys[3], xs[3]);
+  std::vector<ewah_bitmap> zs;
+  REQUIRE(load_mapped(filename, zs));
+  CHECK(zs == ys);
+  MESSAGE("regular serialization of mapped bitmaps");
+  std::vector<char> buf;
+  REQUIRE(save(buf, zs));
+  std::vector<ewah_bitmap> ws;
+  REQUIRE(load(buf, ws));
+  CHECK(ws == ys);
+  CHECK(!ws[3].mapped());
+}
+
+TEST(mapped value index) {
+  auto filename = directory / "index";
+  type t = count_type{};
+  auto idx = value_index::make(t);
+  REQUIRE(idx);
+  for (auto i = 0u; i < 1000; ++i)
+    REQUIRE(idx->push_back(count{i % 7}));
+  REQUIRE(save_mapped(filename, detail::value_index_inspect_helper{t, idx}));
+  std::unique_ptr<value_index> idx2;
+  detail::value_index_inspect_helper helper{t, idx2};
+  REQUIRE(load_mapped(filename, helper));
+  REQUIRE(idx2);
+  CHECK_EQUAL(idx2->offset(), idx->offset());
+  auto x = idx->lookup(equal, count{3});
+  auto y = idx2->lookup(equal, count{3});
+  REQUIRE(x);
+  REQUIRE(y);
+  CHECK_EQUAL(to_string(*y), to_string(*x));
+  MESSAGE("append to a loaded index");
+  REQUIRE(idx->push_back(count{3}));
+  REQUIRE(idx2->push_back(count{3}));
+  x = idx->lookup(equal, count{3});
+  y = idx2->lookup(equal, count{3});
+  REQUIRE(x);
+  REQUIRE(y);
+  CHECK_EQUAL(to_string(*y), to_string(*x));
+}
+
+TEST(mapped file corruption) {
+  auto filename = directory / "corrupt";
+  {
+    std::ofstream out{filename.str()};
+    out << "not a mapped file, but long enough to hold a header";
+  }
+  std::vector<ewah_bitmap> xs;
+  CHECK(!load_mapped(filename, xs));
+}
+
+FIXTURE_SCOPE_END()
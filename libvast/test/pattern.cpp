@@ -17,6 +17,8 @@
 #include "vast/concept/printable/vast/pattern.hpp"
 #include "vast/pattern.hpp"
 
+#include "vast/detail/pattern_matcher.hpp"
+
 #define SUITE pattern
 #include "test.hpp"
 
@@ -65,3 +67,64 @@ TEST(parseable) {
   CHECK(f == l);
   CHECK(to_string(pat) == str);
 }
+
+TEST(fast paths) {
+  CHECK(pattern("foo").match("foo"));
+  CHECK(!pattern("foo").match("foobar"));
+  CHECK(pattern("foo").search("barfoobaz"));
+  CHECK(pattern("^foo").search("foobar"));
+  CHECK(!pattern("^foo").search("barfoo"));
+  CHECK(pattern("foo$").search("barfoo"));
+  CHECK(!pattern("foo$").search("foobar"));
+  CHECK(pattern("/index\\.html.*").match("/index.html?q=1"));
+  CHECK(!pattern("/index\\.html.*").match("/indexxhtml"));
+  CHECK(pattern(".*\\.exe").match("/download/setup.exe"));
+  CHECK(pattern("a.c.*e").match("abcde"));
+  CHECK(!pattern("a.c.*e").match("abcdef"));
+  MESSAGE("wildcards do not match line terminators");
+  CHECK(!pattern("a.*b").match("a\nb"));
+  CHECK(!pattern("a.b").search("a\nb"));
+  CHECK(pattern("a.*b").search("x\na b"));
+  CHECK(!pattern("a.b").match("a\rb"));
+  CHECK(!pattern("a.*b").match("a\rb"));
+  CHECK(!pattern(".*").match("\r"));
+  CHECK(pattern("a.*b").search("x\ra b"));
+  MESSAGE("globs");
+  auto p = pattern::glob("*.google.com");
+  CHECK(p.match("www.google.com"));
+  CHECK(!p.match("www.googlexcom"));
+  CHECK(pattern::glob("/img/??.png").match("/img/01.png"));
+}
+
+TEST(shared matcher) {
+  auto p = pattern("^/\\w+");
+  CHECK(p.search("/foo"));
+  auto q = p;
+  CHECK(q.search("/bar"));
+  CHECK(!q.search("bar"));
+  q = pattern("bar");
+  CHECK(q.match("bar"));
+  CHECK(!q.match("/bar"));
+  CHECK(p.search("/foo"));
+}
+
+TEST(constraints) {
+  using detail::derive_constraints;
+  auto c = derive_constraints("foo", true);
+  REQUIRE(c.literal);
+  CHECK_EQUAL(*c.literal, "foo");
+  CHECK_EQUAL(c.prefix, "foo");
+  c = derive_constraints("foo", false);
+  CHECK(!c.literal);
+  CHECK(c.prefix.empty());
+  CHECK_EQUAL(c.substrings, std::vector<std::string>{"foo"});
+  c = derive_constraints("/index\\.html.*x", true);
+  CHECK_EQUAL(c.prefix, "/index.html");
+  CHECK_EQUAL(c.substrings, std::vector<std::string>{"x"});
+  c = derive_constraints("ab(cd)+ef", true);
+  CHECK_EQUAL(c.prefix, "ab");
+  c = derive_constraints("foo|bar", false);
+  CHECK(c.prefix.empty());
+  CHECK(c.substrings.empty());
+  CHECK(!c.literal);
+}
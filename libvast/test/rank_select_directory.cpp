@@ -0,0 +1,92 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <random>
+
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/ewah_bitmap.hpp"
+#include "vast/rank_select_directory.hpp"
+
+#define SUITE rank_select_directory
+#include "test.hpp"
+
+using namespace vast;
+
+TEST(empty directory) {
+  ewah_bitmap bm;
+  rank_select_directory dir{bm};
+  CHECK_EQUAL(dir.size(), 0u);
+  CHECK_EQUAL(dir.rank(), 0u);
+  CHECK_EQUAL(dir.rank<0>(), 0u);
+  CHECK_EQUAL(dir.select(bm, 1), rank_select_directory::word_type::npos);
+  CHECK_EQUAL(dir.select(bm, -1), rank_select_directory::word_type::npos);
+}
+
+TEST(simple directory) {
+  ewah_bitmap bm;
+  bm.append_bits(false, 100);
+  bm.append_bits(true, 1000);
+  bm.append_bit(false);
+  bm.append_bit(true);
+  bm.append_bits(false, 10);
+  rank_select_directory dir{bm};
+  CHECK_EQUAL(dir.size(), bm.size());
+  CHECK_EQUAL(dir.rank(), 1001u);
+  CHECK_EQUAL(dir.rank<0>(), 111u);
+  CHECK_EQUAL(dir.rank(bm, 99), 0u);
+  CHECK_EQUAL(dir.rank(bm, 100), 1u);
+  CHECK_EQUAL(dir.rank<0>(bm, 1100), 101u);
+  CHECK_EQUAL(dir.select(bm, 1), 100u);
+  CHECK_EQUAL(dir.select(bm, 1000), 1099u);
+  CHECK_EQUAL(dir.select(bm, 1001), 1101u);
+  CHECK_EQUAL(dir.select(bm, 1002), rank_select_directory::word_type::npos);
+  CHECK_EQUAL(dir.select(bm, -1), 1101u);
+  CHECK_EQUAL(dir.select<0>(bm, 101), 1100u);
+  CHECK_EQUAL(dir.select<0>(bm, -1), bm.size() - 1);
+}
+
+TEST(agreement with bitmap algorithms) {
+  std::mt19937_64 gen{42};
+  ewah_bitmap bm;
+  while (bm.size() < 100000) {
+    auto n = 1 + gen() % 300;
+    switch (gen() % 3) {
+      case 0:
+        bm.append_bits(false, n);
+        break;
+      case 1:
+        bm.append_bits(true, n);
+        break;
+      default:
+        for (auto i = 0u; i < n; ++i)
+          bm.append_bit(gen() % 2 == 0);
+    }
+  }
+  rank_select_directory dir{bm};
+  CHECK_EQUAL(dir.rank(), rank(bm));
+  CHECK_EQUAL(dir.rank<0>(), rank<0>(bm));
+  CHECK_EQUAL(dir.select(bm, -1), select(bm, -1));
+  CHECK_EQUAL(dir.select<0>(bm, -1), select<0>(bm, -1));
+  for (auto i = 0; i < 1000; ++i) {
+    auto pos = 1 + gen() % (bm.size() - 1);
+    CHECK_EQUAL(dir.rank(bm, pos), rank(bm, pos));
+    CHECK_EQUAL(dir.rank<0>(bm, pos), rank<0>(bm, pos));
+    auto k = 1 + gen() % dir.rank();
+    CHECK_EQUAL(dir.select(bm, k), select(bm, k));
+    k = 1 + gen() % dir.rank<0>();
+    CHECK_EQUAL(dir.select<0>(bm, k), select<0>(bm, k));
+  }
+  // The directory samples the bitmap rather than copying it.
+  CHECK_LESS(dir.memusage() * 10, bm.memusage());
+}
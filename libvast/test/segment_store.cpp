@@ -0,0 +1,162 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "vast/event.hpp"
+#include "vast/ids.hpp"
+#include "vast/load.hpp"
+#include "vast/save.hpp"
+#include "vast/segment_store.hpp"
+
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/uuid.hpp"
+#include "vast/concept/printable/vast/event.hpp"
+
+#include "vast/detail/byte_swap.hpp"
+
+#define SUITE segment_store
+#include "test.hpp"
+
+using namespace vast;
+
+namespace {
+
+struct fixture {
+  fixture() : event_type{integer_type{}} {
+    if (exists(dir))
+      rm(dir);
+    event_type.name("foo");
+    for (auto i = 0; i < 1000; ++i) {
+      events.push_back(event::make(i, event_type));
+      events.back().id(i);
+    }
+  }
+
+  ~fixture() {
+    rm(dir);
+  }
+
+  // Stores the events in batches of 100, with a tiny maximum segment size
+  // such that each batch flushes the previous segment.
+  void put_events(segment_store& store) {
+    for (auto i = 0u; i < events.size(); i += 100) {
+      std::vector<event> xs(events.begin() + i, events.begin() + i + 100);
+      REQUIRE(store.put(xs));
+    }
+    REQUIRE(store.flush());
+  }
+
+  // Overwrites an 8-byte integer at a given offset of a file.
+  void patch(const path& filename, size_t offset, uint64_t x) {
+    auto contents = load_contents(filename);
+    REQUIRE(contents);
+    REQUIRE_LESS_EQUAL(offset + sizeof(x), contents->size());
+    x = detail::to_network_order(x);
+    std::memcpy(contents->data() + offset, &x, sizeof(x));
+    std::ofstream out{filename.str(), std::ios::binary};
+    out.write(contents->data(), contents->size());
+    REQUIRE(out);
+  }
+
+  size_t file_size(const path& filename) {
+    auto contents = load_contents(filename);
+    REQUIRE(contents);
+    return contents->size();
+  }
+
+  path dir = "vast-unit-test-segment-store";
+  type event_type;
+  std::vector<event> events;
+};
+
+} // namespace <anonymous>
+
+FIXTURE_SCOPE(segment_store_tests, fixture)
+
+TEST(meta data compaction) {
+  {
+    segment_store store{dir, 1, 2};
+    put_events(store);
+  }
+  // With ten segments, the store compacted its journal at least once and
+  // never let the log outgrow the snapshot.
+  auto snapshot = dir / "journal" / "snapshot";
+  auto log = dir / "journal" / "log";
+  REQUIRE(exists(snapshot));
+  if (exists(log))
+    CHECK_LESS_EQUAL(file_size(log), file_size(snapshot));
+  MESSAGE("restore meta data from the journal");
+  segment_store store{dir, 1, 2};
+  auto xs = store.get(make_ids({{0, 1000}}));
+  REQUIRE(xs);
+  std::sort(xs->begin(), xs->end());
+  CHECK(*xs == events);
+}
+
+TEST(legacy meta data import) {
+  {
+    segment_store store{dir, 1024 * 1024, 2};
+    put_events(store);
+  }
+  MESSAGE("replace the journal with a meta data file of older versions");
+  rm(dir / "journal");
+  auto segment = *directory{dir}.begin();
+  auto id = to<uuid>(segment.basename().str());
+  REQUIRE(id);
+  detail::range_map<event_id, uuid> legacy;
+  legacy.insert(0, 1000, *id);
+  REQUIRE(save(dir / "meta", legacy));
+  MESSAGE("import the meta data file once");
+  {
+    segment_store store{dir, 1024 * 1024, 2};
+    auto xs = store.get(make_ids({{0, 1000}}));
+    REQUIRE(xs);
+    CHECK(*xs == events);
+  }
+  CHECK(!exists(dir / "meta"));
+  CHECK(exists(dir / "journal" / "snapshot"));
+  segment_store store{dir, 1024 * 1024, 2};
+  auto xs = store.get(make_ids({{500, 600}}));
+  REQUIRE(xs);
+  CHECK_EQUAL(xs->size(), 100u);
+}
+
+TEST(corrupt segment) {
+  {
+    segment_store store{dir, 1024 * 1024, 2};
+    put_events(store);
+  }
+  path filename;
+  for (auto& p : directory{dir})
+    if (to<uuid>(p.basename().str()))
+      filename = p;
+  REQUIRE(segment_store::segment::open(filename));
+  auto original = load_contents(filename);
+  REQUIRE(original);
+  MESSAGE("batch count whose directory size overflows");
+  patch(filename, 24, uint64_t{1} << 59);
+  CHECK(!segment_store::segment::open(filename));
+  MESSAGE("batch bounds that overflow");
+  std::ofstream{filename.str(), std::ios::binary}
+    .write(original->data(), original->size());
+  patch(filename, 48, std::numeric_limits<uint64_t>::max() - 10);
+  CHECK(!segment_store::segment::open(filename));
+  patch(filename, 48, 0);
+  patch(filename, 56, std::numeric_limits<uint64_t>::max());
+  CHECK(!segment_store::segment::open(filename));
+}
+
+FIXTURE_SCOPE_END()
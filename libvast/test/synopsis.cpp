@@ -0,0 +1,113 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include "vast/synopsis.hpp"
+#include "vast/load.hpp"
+#include "vast/save.hpp"
+
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/address.hpp"
+#include "vast/concept/parseable/vast/subnet.hpp"
+
+#define SUITE synopsis
+#include "test.hpp"
+
+using namespace vast;
+using namespace std::string_literals;
+
+TEST(range synopsis) {
+  synopsis syn{count_type{}, 100};
+  MESSAGE("empty synopsis rules out everything");
+  CHECK(!syn.lookup(equal, count{42}));
+  syn.add(count{10});
+  syn.add(count{42});
+  syn.add(nil);
+  syn.add(count{20});
+  MESSAGE("lookup");
+  CHECK(syn.lookup(equal, count{10}));
+  CHECK(syn.lookup(equal, count{30})); // false positive
+  CHECK(!syn.lookup(equal, count{9}));
+  CHECK(!syn.lookup(equal, count{43}));
+  CHECK(syn.lookup(less, count{11}));
+  CHECK(!syn.lookup(less, count{10}));
+  CHECK(syn.lookup(less_equal, count{10}));
+  CHECK(syn.lookup(greater, count{41}));
+  CHECK(!syn.lookup(greater, count{42}));
+  CHECK(syn.lookup(greater_equal, count{42}));
+  CHECK(syn.lookup(not_equal, count{42}));
+  CHECK(syn.lookup(in, vector{count{1}, count{15}}));
+  CHECK(!syn.lookup(in, set{count{1}, count{100}}));
+  MESSAGE("conservative answers");
+  CHECK(syn.lookup(equal, nil));
+  CHECK(syn.lookup(equal, integer{1}));
+  CHECK(syn.lookup(not_in, vector{count{1}}));
+}
+
+TEST(port synopsis) {
+  synopsis syn{port_type{}, 100};
+  syn.add(port{80, port::tcp});
+  syn.add(port{443, port::tcp});
+  CHECK(syn.lookup(equal, port{80, port::udp}));
+  CHECK(syn.lookup(equal, port{443, port::unknown}));
+  CHECK(!syn.lookup(equal, port{53, port::udp}));
+  CHECK(!syn.lookup(greater, port{443, port::tcp}));
+}
+
+TEST(bloom synopsis) {
+  synopsis syn{address_type{}, 100};
+  syn.add(*to<address>("10.0.0.1"));
+  syn.add(*to<address>("192.168.0.1"));
+  CHECK(syn.lookup(equal, *to<address>("10.0.0.1")));
+  CHECK(syn.lookup(equal, *to<address>("192.168.0.1")));
+  CHECK(!syn.lookup(equal, *to<address>("10.0.0.2")));
+  CHECK(!syn.lookup(in, vector{*to<address>("10.0.0.2")}));
+  CHECK(syn.lookup(in, *to<subnet>("10.0.0.0/8"))); // no range information
+  auto str = synopsis{string_type{}, 100};
+  str.add("foo"s);
+  CHECK(str.lookup(equal, "foo"s));
+  CHECK(!str.lookup(equal, "bar"s));
+  CHECK(str.lookup(ni, "fo"s));
+  MESSAGE("serialization");
+  std::string buf;
+  REQUIRE(save(buf, syn));
+  synopsis syn2;
+  REQUIRE(load(buf, syn2));
+  CHECK(syn == syn2);
+}
+
+TEST(bloom synopsis sizing) {
+  auto small = synopsis{string_type{}, 100};
+  auto large = synopsis{string_type{}, 10000};
+  CHECK_LESS(small.memusage(), large.memusage());
+  // A false positive rate of 1% takes about 9.6 bits per value.
+  CHECK_GREATER(large.memusage(), 11900u);
+  CHECK_LESS(large.memusage(), 13000u);
+  auto range = synopsis{count_type{}, 10000};
+  CHECK_LESS(range.memusage(), small.memusage());
+  MESSAGE("false positive rate at capacity");
+  for (auto i = 0; i < 10000; ++i)
+    large.add(std::to_string(i));
+  auto false_positives = 0;
+  for (auto i = 10000; i < 20000; ++i)
+    if (large.lookup(equal, std::to_string(i)))
+      ++false_positives;
+  CHECK_LESS(false_positives, 200);
+}
+
+TEST(unsupported synopsis) {
+  CHECK(!synopsis::supports(subnet_type{}));
+  CHECK(synopsis::supports(alias_type{address_type{}}));
+  synopsis syn{subnet_type{}, 100};
+  CHECK(syn.lookup(equal, *to<subnet>("10.0.0.0/8")));
+}
@@ -26,7 +26,8 @@ using namespace vast;
 FIXTURE_SCOPE(archive_tests, fixtures::actor_system_and_events)
 
 TEST(archiving and querying) {
-  auto a = self->spawn(system::archive, directory, 10, 1024 * 1024);
+  auto a = self->spawn(system::archive, directory, 10, 1024 * 1024,
+                       batch::encoding::row);
   MESSAGE("sending events");
   self->send(a, bro_conn_log);
   self->send(a, bro_dns_log);
@@ -51,6 +52,60 @@ TEST(archiving and querying) {
   CHECK_EQUAL(result[50].id(), 10150u);
   CHECK_EQUAL(result[50].type().name(), "bro::dns");
   CHECK_EQUAL(result[result.size() - 1].id(), 10199u);
+  MESSAGE("querying sparse events");
+  ids = make_ids({{5, 6}, {10160, 10161}});
+  self->request(a, infinite, ids).receive(
+    [&](std::vector<event>& xs) { result = std::move(xs); },
+    error_handler()
+  );
+  REQUIRE_EQUAL(result.size(), 2u);
+  std::sort(result.begin(), result.end());
+  CHECK_EQUAL(result[0].id(), 5u);
+  CHECK_EQUAL(result[1].id(), 10160u);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(querying sealed segments) {
+  // With a tiny maximum segment size, each batch seals the previous segment
+  // and hands it to the I/O worker.
+  auto a = self->spawn(system::archive, directory, 10, 1,
+                       batch::encoding::row);
+  self->send(a, bro_conn_log);
+  self->send(a, bro_dns_log);
+  self->send(a, bro_http_log);
+  self->send(a, bgpdump_txt);
+  auto ids = make_ids({{100, 150}, {10150, 10200}});
+  std::vector<event> result;
+  self->request(a, infinite, ids).receive(
+    [&](std::vector<event>& xs) { result = std::move(xs); },
+    error_handler()
+  );
+  REQUIRE_EQUAL(result.size(), 100u);
+  std::sort(result.begin(), result.end());
+  CHECK_EQUAL(result[0].id(), 100u);
+  CHECK_EQUAL(result[0], bro_conn_log[100]);
+  CHECK_EQUAL(result[50].id(), 10150u);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(querying sealed columnar segments) {
+  auto a = self->spawn(system::archive, directory, 10, 1,
+                       batch::encoding::columnar);
+  self->send(a, bro_conn_log);
+  self->send(a, bro_dns_log);
+  self->send(a, bro_http_log);
+  self->send(a, bgpdump_txt);
+  auto ids = make_ids({{100, 150}, {10150, 10200}});
+  std::vector<event> result;
+  self->request(a, infinite, ids).receive(
+    [&](std::vector<event>& xs) { result = std::move(xs); },
+    error_handler()
+  );
+  REQUIRE_EQUAL(result.size(), 100u);
+  std::sort(result.begin(), result.end());
+  CHECK_EQUAL(result[0].id(), 100u);
+  CHECK_EQUAL(result[0], bro_conn_log[100]);
+  CHECK_EQUAL(result[50].id(), 10150u);
   self->send_exit(a, exit_reason::user_shutdown);
 }
 
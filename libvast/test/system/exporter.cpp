@@ -32,8 +32,10 @@ using namespace std::chrono;
 FIXTURE_SCOPE(exporter_tests, fixtures::actor_system_and_events)
 
 TEST(exporter historical) {
-  auto i = self->spawn(system::index, directory / "index", 1000, 5, 5);
-  auto a = self->spawn(system::archive, directory / "archive", 1, 1024);
+  auto i = self->spawn(system::index, directory / "index", 1000, 5, 5, 0, 0,
+                       1 << 20);
+  auto a = self->spawn(system::archive, directory / "archive", 1, 1024,
+                       batch::encoding::row);
   MESSAGE("ingesting conn.log");
   self->send(i, bro_conn_log);
   self->send(a, bro_conn_log);
@@ -63,8 +65,10 @@ TEST(exporter historical) {
 }
 
 TEST(exporter continuous -- exporter only) {
-  auto i = self->spawn(system::index, directory / "index", 1000, 5, 5);
-  auto a = self->spawn(system::archive, directory / "archive", 1, 1024);
+  auto i = self->spawn(system::index, directory / "index", 1000, 5, 5, 0, 0,
+                       1 << 20);
+  auto a = self->spawn(system::archive, directory / "archive", 1, 1024,
+                       batch::encoding::row);
   auto expr = to<expression>("service == \"http\" && :addr == 212.227.96.110");
   REQUIRE(expr);
   MESSAGE("issueing continuous query");
@@ -94,8 +98,10 @@ TEST(exporter continuous -- exporter only) {
 
 TEST(exporter continuous -- with importer) {
   using namespace system;
-  auto ind = self->spawn(system::index, directory / "index", 1000, 5, 5);
-  auto arc = self->spawn(archive, directory / "archive", 1, 1024);
+  auto ind = self->spawn(system::index, directory / "index", 1000, 5, 5, 0, 0,
+                         1 << 20);
+  auto arc = self->spawn(archive, directory / "archive", 1, 1024,
+                         batch::encoding::row);
   auto imp = self->spawn(importer, directory / "importer", 128);
   auto con = self->spawn(raft::consensus, directory / "consensus");
   self->send(con, run_atom::value);
@@ -135,8 +141,10 @@ TEST(exporter continuous -- with importer) {
 
 TEST(exporter universal) {
   using namespace system;
-  auto ind = self->spawn(system::index, directory / "index", 1000, 5, 5);
-  auto arc = self->spawn(archive, directory / "archive", 1, 1024);
+  auto ind = self->spawn(system::index, directory / "index", 1000, 5, 5, 0, 0,
+                         1 << 20);
+  auto arc = self->spawn(archive, directory / "archive", 1, 1024,
+                         batch::encoding::row);
   auto imp = self->spawn(importer, directory / "importer", 128);
   auto con = self->spawn(raft::consensus, directory / "consensus");
   self->send(con, run_atom::value);
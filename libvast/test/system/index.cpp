@@ -14,7 +14,10 @@
 #include "vast/ids.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/concept/parseable/vast/uuid.hpp"
+#include "vast/load.hpp"
 #include "vast/query_options.hpp"
+#include "vast/save.hpp"
 
 #include "vast/system/index.hpp"
 
@@ -28,14 +31,125 @@ using namespace std::chrono;
 
 namespace {
 
+// Stands in for the accountant and remembers the latest value of each
+// counter.
+behavior counter_monitor() {
+  auto counters = std::make_shared<std::map<std::string, uint64_t>>();
+  return {
+    [=](const std::string& key, uint64_t x) {
+      (*counters)[key] = x;
+    },
+    [=](const std::string&, double) {
+      // nop
+    },
+    [=](const std::string&, timespan) {
+      // nop
+    },
+    [=](get_atom, const std::string& key) {
+      return (*counters)[key];
+    }
+  };
+}
+
+struct index_fixture : fixtures::actor_system_and_events {
+  index_fixture() {
+    monitor = self->spawn(counter_monitor);
+    system.registry().put(system::accountant_atom::value,
+                          actor_cast<strong_actor_ptr>(monitor));
+  }
+
+  ~index_fixture() {
+    system.registry().erase(system::accountant_atom::value);
+    self->send_exit(monitor, exit_reason::user_shutdown);
+  }
+
+  uint64_t counter(const std::string& key) {
+    uint64_t result = 0;
+    self->request(monitor, infinite, get_atom::value, key).receive(
+      [&](uint64_t x) {
+        result = x;
+      },
+      error_handler()
+    );
+    return result;
+  }
+
+  // Creates the *i*-th batch of 100 events with consecutive IDs and
+  // timestamps.
+  std::vector<event> make_batch(size_t i) {
+    auto t = type{count_type{}}.name("test");
+    std::vector<event> result;
+    for (auto j = 0u; j < 100; ++j) {
+      auto id = i * 100 + j;
+      result.push_back(event::make(count{j % 10}, t));
+      result.back().id(id);
+      result.back().timestamp(timestamp{} + seconds(id));
+    }
+    return result;
+  }
+
+  // Sends a lookup to the index and waits for the hits of all scheduled
+  // partitions. Returns the ID of the lookup along with the number of
+  // qualifying partitions.
+  std::pair<uuid, size_t> lookup(const actor& index, const std::string& str) {
+    auto expr = to<expression>(str);
+    REQUIRE(expr);
+    std::pair<uuid, size_t> result;
+    self->send(index, *expr);
+    self->receive(
+      [&](const uuid& id, size_t total, size_t scheduled) {
+        result = {id, total};
+        size_t i = 0;
+        self->receive_for(i, scheduled)(
+          [&](const ids&) {
+            // nop
+          },
+          error_handler()
+        );
+      },
+      error_handler()
+    );
+    return result;
+  }
+
+  // Asks the index to schedule one more partition of a lookup and waits for
+  // its hits.
+  void more(const actor& index, const uuid& id) {
+    self->send(index, id, size_t{1});
+    self->receive(
+      [&](const ids&) {
+        // nop
+      },
+      error_handler()
+    );
+  }
+
+  // Looks up the events from the *i*-th batch onwards. Since a lookup
+  // touches all value indexes of a batch after they have appended it, the
+  // index knows their memory footprint afterwards.
+  size_t sync(const actor& index, size_t i) {
+    return lookup(index, "&time >= @" + std::to_string(i * 100)
+                         + " && &type == \"test\" && :count >= 0").second;
+  }
+
+  // Looks up exactly the events of the *i*-th batch.
+  std::pair<uuid, size_t> lookup_batch(const actor& index, size_t i) {
+    return lookup(index, "&time >= @" + std::to_string(i * 100)
+                         + " && &time < @" + std::to_string((i + 1) * 100));
+  }
+
+  actor monitor;
+};
+
 } // namespace <anonymous>
 
-FIXTURE_SCOPE(index_tests, fixtures::actor_system_and_events)
+FIXTURE_SCOPE(index_tests, index_fixture)
 
 TEST(index) {
   directory /= "index";
   MESSAGE("spawing");
-  auto index = self->spawn(system::index, directory, 1000, 5, 10);
+  auto index = self->spawn(system::index, directory, 1000, 5, 10, 0, 0,
+                           1 << 20);
   MESSAGE("indexing logs");
   self->send(index, bro_conn_log);
   self->send(index, bro_dns_log);
@@ -52,9 +166,10 @@ TEST(index) {
   self->receive(
     [&](const uuid& id, size_t total, size_t scheduled) {
       CHECK_NOT_EQUAL(id, uuid::nil());
-      // Each batch wound up in its own partition.
-      CHECK_EQUAL(total, 3u);
-      CHECK_EQUAL(scheduled, 3u);
+      // Each batch wound up in its own partition, but the synopses rule out
+      // the DNS partition because it lacks the address.
+      CHECK_EQUAL(total, 2u);
+      CHECK_EQUAL(scheduled, 2u);
       // After the lookup ID has arrived,
       size_t i = 0;
       ids all;
@@ -68,23 +183,34 @@ TEST(index) {
   );
   self->send_exit(index, exit_reason::user_shutdown);
   self->wait_for(index);
-  CHECK(exists(directory / "meta"));
+  CHECK(exists(directory / "journal"));
   MESSAGE("reloading index");
-  index = self->spawn(system::index, directory, 1000, 2, 2);
+  index = self->spawn(system::index, directory, 1000, 2, 1, 0, 0, 1 << 20);
+  MESSAGE("issueing a query without qualifying partitions");
+  auto needle = to<expression>(":addr == 1.2.3.4 && :port == 4711/tcp");
+  REQUIRE(needle);
+  self->send(index, *needle);
+  self->receive(
+    [&](const uuid&, size_t total, size_t scheduled) {
+      CHECK_EQUAL(total, 0u);
+      CHECK_EQUAL(scheduled, 0u);
+    },
+    error_handler()
+  );
   MESSAGE("issueing queries");
   self->send(index, *expr);
   self->receive(
     [&](const uuid& id, size_t total, size_t scheduled) {
       CHECK_NOT_EQUAL(id, uuid::nil());
-      CHECK_EQUAL(total, 3u);
-      CHECK_EQUAL(scheduled, 2u); // Only two this time
+      CHECK_EQUAL(total, 2u);
+      CHECK_EQUAL(scheduled, 1u); // Only one this time
       size_t i = 0;
       ids all;
       self->receive_for(i, scheduled)(
         [&](const ids& hits) { all |= hits; },
         error_handler()
       );
-      // Evict one partition.
+      // Schedule the remaining partition.
       self->send(index, id, size_t{1});
       self->receive(
         [&](const ids& hits) { all |= hits; },
@@ -96,6 +222,144 @@ TEST(index) {
   );
   self->send_exit(index, exit_reason::user_shutdown);
   self->wait_for(index);
+  MESSAGE("reloading index with an exhausted memory budget");
+  index = self->spawn(system::index, directory, 1000, 2, 1, 1, 0, 1 << 20);
+  self->send(index, *expr);
+  self->receive(
+    [&](const uuid& id, size_t total, size_t scheduled) {
+      CHECK_EQUAL(total, 2u);
+      CHECK_EQUAL(scheduled, 1u);
+      ids all;
+      self->receive([&](const ids& hits) { all |= hits; }, error_handler());
+      self->send(index, id, size_t{1});
+      self->receive([&](const ids& hits) { all |= hits; }, error_handler());
+      CHECK_EQUAL(rank(all), total_hits);
+    },
+    error_handler()
+  );
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+}
+
+TEST(memory budget) {
+  MESSAGE("measuring the footprint of a single batch");
+  auto index = self->spawn(system::index, directory / "unlimited", 1000, 5,
+                           1, 0, 0, 1 << 20);
+  self->send(index, make_batch(0));
+  CHECK_EQUAL(sync(index, 0), 1u);
+  sync(index, 0);
+  auto footprint = counter("index.memory");
+  REQUIRE_GREATER(footprint, 0u);
+  // The footprint includes the synopses of the partition.
+  auto synopses = counter("index.synopses.memory");
+  CHECK_GREATER(synopses, 0u);
+  CHECK_LESS(synopses, footprint);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+  MESSAGE("filling partitions with about two batches each");
+  auto budget = footprint + footprint / 2;
+  index = self->spawn(system::index, directory / "budget", 1000, 5, 1,
+                      budget, 0, 1 << 20);
+  for (auto i = 0u; i < 6; ++i) {
+    self->send(index, make_batch(i));
+    sync(index, i);
+  }
+  // A retiring active partition no longer counts against the budget, so
+  // its successor can receive more than a single batch.
+  CHECK_EQUAL(sync(index, 0), 3u);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+}
+
+TEST(partition eviction) {
+  MESSAGE("filling one partition per batch");
+  directory /= "eviction";
+  auto index = self->spawn(system::index, directory, 100, 5, 1, 0, 0,
+                           1 << 20);
+  for (auto i = 0u; i < 3; ++i)
+    self->send(index, make_batch(i));
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+  MESSAGE("loading partitions into two slots");
+  index = self->spawn(system::index, directory, 100, 2, 1, 0, 0, 1 << 20);
+  CHECK_EQUAL(lookup_batch(index, 0).second, 1u); // miss
+  CHECK_EQUAL(lookup_batch(index, 1).second, 1u); // miss
+  lookup_batch(index, 0); // hit
+  MESSAGE("evicting the least recently used partition");
+  lookup_batch(index, 2); // miss, evicts the partition of batch 1
+  lookup_batch(index, 0); // hit
+  MESSAGE("keeping partitions that lookups still need");
+  // The lookup spans the loaded partitions of batch 0 and 2, but schedules
+  // only one of them.
+  auto [id, total] = lookup(index, "&time < @100 || &time >= @200");
+  CHECK_EQUAL(total, 2u); // hit
+  lookup_batch(index, 1); // miss, evicts the partition that is not pending
+  more(index, id); // hit
+  lookup_batch(index, 1); // hit
+  CHECK_EQUAL(counter("index.partitions.hits"), 5u);
+  CHECK_EQUAL(counter("index.partitions.misses"), 4u);
+  CHECK_EQUAL(counter("index.partitions.evictions"), 2u);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+}
+
+TEST(partition prefetching) {
+  directory /= "prefetching";
+  auto index = self->spawn(system::index, directory, 100, 5, 1, 0, 0,
+                           1 << 20);
+  for (auto i = 0u; i < 4; ++i)
+    self->send(index, make_batch(i));
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+  index = self->spawn(system::index, directory, 100, 3, 1, 0, 0, 1 << 20);
+  MESSAGE("prefetching the next partition of a lookup");
+  auto [id, total] = lookup(index, "&time >= @0");
+  CHECK_EQUAL(total, 4u);
+  CHECK_EQUAL(counter("index.partitions.misses"), 1u);
+  CHECK_EQUAL(counter("index.partitions.prefetches"), 1u);
+  MESSAGE("finding prefetched partitions warm");
+  more(index, id);
+  more(index, id);
+  MESSAGE("never evicting for the sake of prefetching");
+  // All slots are taken now, so the lookup for all partitions finds the
+  // first one loaded and prefetches nothing.
+  lookup(index, "&time >= @0");
+  CHECK_EQUAL(counter("index.partitions.hits"), 3u);
+  CHECK_EQUAL(counter("index.partitions.misses"), 1u);
+  CHECK_EQUAL(counter("index.partitions.prefetches"), 2u);
+  CHECK_EQUAL(counter("index.partitions.evictions"), 0u);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+}
+
+TEST(partition index persistence) {
+  directory /= "persistence";
+  auto index = self->spawn(system::index, directory, 100, 5, 1, 0, 0,
+                           1 << 20);
+  for (auto i = 0u; i < 3; ++i)
+    self->send(index, make_batch(i));
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+  MESSAGE("compacting the journal");
+  // The first record outgrows the empty snapshot.
+  CHECK(exists(directory / "journal" / "snapshot"));
+  MESSAGE("importing the partition index of older versions");
+  std::unordered_map<uuid, system::partition_index::interval> legacy;
+  for (auto& entry : vast::directory{directory})
+    if (auto id = to<uuid>(entry.basename().str()))
+      legacy[*id] = {timestamp{}, timestamp{} + seconds(300)};
+  REQUIRE_EQUAL(legacy.size(), 3u);
+  rm(directory / "journal");
+  REQUIRE(save(directory / "meta", legacy));
+  index = self->spawn(system::index, directory, 100, 5, 1, 0, 0, 1 << 20);
+  CHECK_EQUAL(lookup(index, "&time >= @0").second, 3u);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
+  CHECK(!exists(directory / "meta"));
+  index = self->spawn(system::index, directory, 100, 5, 1, 0, 0, 1 << 20);
+  CHECK_EQUAL(lookup(index, "&time >= @0").second, 3u);
+  self->send_exit(index, exit_reason::user_shutdown);
+  self->wait_for(index);
 }
 
 FIXTURE_SCOPE_END()
@@ -28,12 +28,61 @@
 using namespace caf;
 using namespace vast;
 
+TEST(shredding) {
+  auto t = type{record_type{
+    {"s", string_type{}},
+    {"r", record_type{
+      {"c", count_type{}}
+    }}
+  }}.name("foo");
+  auto other = type{count_type{}}.name("bar");
+  system::event_indexer_state st;
+  st.event_type = t;
+  st.columns.emplace_back(offset{0}, nullptr);
+  st.columns.emplace_back(offset{1, 0}, nullptr);
+  std::vector<event> xs;
+  xs.push_back(event::make(vector{"x", vector{42u}}, t));
+  xs.push_back(event::make(42u, other));
+  xs.push_back(event::make(vector{"y", nil}, t));
+  for (auto i = 0u; i < xs.size(); ++i) {
+    xs[i].id(10 + i);
+    xs[i].timestamp(timestamp{} + std::chrono::seconds(i));
+  }
+  MESSAGE("record type");
+  auto batch = system::shred(st, xs);
+  CHECK_EQUAL(batch.ids, (std::vector<event_id>{10, 11, 12}));
+  CHECK_EQUAL(batch.data_ids, (std::vector<event_id>{10, 12}));
+  REQUIRE_EQUAL(batch.times.size(), 3u);
+  CHECK_EQUAL(batch.times[2], data{timestamp{} + std::chrono::seconds(2)});
+  CHECK_EQUAL(batch.types, (std::vector<data>{"foo", "bar", "foo"}));
+  REQUIRE_EQUAL(batch.columns.size(), 2u);
+  CHECK_EQUAL(batch.columns[0], (std::vector<data>{"x", "y"}));
+  // The nil record has no field at the offset.
+  CHECK_EQUAL(batch.columns[1], (std::vector<data>{42u, nil}));
+  MESSAGE("non-record type");
+  st.event_type = other;
+  st.columns.clear();
+  st.columns.emplace_back(offset{}, nullptr);
+  batch = system::shred(st, xs);
+  CHECK_EQUAL(batch.data_ids, (std::vector<event_id>{11}));
+  REQUIRE_EQUAL(batch.columns.size(), 1u);
+  CHECK_EQUAL(batch.columns[0], (std::vector<data>{42u}));
+  MESSAGE("no data indexes");
+  st.columns.clear();
+  batch = system::shred(st, xs);
+  CHECK_EQUAL(batch.ids.size(), 3u);
+  CHECK(batch.data_ids.empty());
+  CHECK(batch.columns.empty());
+}
+
 FIXTURE_SCOPE(indexer_tests, fixtures::actor_system_and_events)
 
 TEST(indexer) {
   directory /= "indexer";
   const auto conn_log_type = bro_conn_log[0].type();
-  auto i = self->spawn(system::event_indexer, directory, conn_log_type);
+  auto pool = std::make_shared<detail::work_stealing_pool>(2);
+  auto i = self->spawn(system::event_indexer, directory, conn_log_type, pool,
+                       actor{});
   MESSAGE("ingesting events");
   self->send(i, bro_conn_log);
   // Event indexers operate with predicates, whereas partitions take entire
@@ -67,7 +116,8 @@ TEST(indexer) {
   CHECK(exists(directory / "data" / "id" / "orig_h"));
   CHECK(exists(directory / "meta" / "time"));
   MESSAGE("respawning indexer from file system");
-  i = self->spawn(system::event_indexer, directory, conn_log_type);
+  i = self->spawn(system::event_indexer, directory, conn_log_type, pool,
+                  actor{});
   // Same as above: submit the query and verify the result.
   self->request(i, infinite, *pred).receive(
     [&](bitmap& bm) {
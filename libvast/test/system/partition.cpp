@@ -28,11 +28,34 @@ using namespace std::chrono;
 
 namespace {
 
+// Stands in for the accountant and sums up the counters of partitions.
+behavior counter_monitor() {
+  auto counters = std::make_shared<std::map<std::string, uint64_t>>();
+  return {
+    [=](const std::string& key, uint64_t x) {
+      (*counters)[key] += x;
+    },
+    [=](const std::string&, double) {
+      // nop
+    },
+    [=](const std::string&, timespan) {
+      // nop
+    },
+    [=](get_atom, const std::string& key) {
+      return (*counters)[key];
+    }
+  };
+}
+
 struct partition_fixture : fixtures::actor_system_and_events {
   partition_fixture() {
     directory /= "partition";
+    monitor = self->spawn(counter_monitor);
+    system.registry().put(system::accountant_atom::value,
+                          actor_cast<strong_actor_ptr>(monitor));
     MESSAGE("ingesting conn.log");
-    partition = self->spawn(system::partition, directory);
+    partition = self->spawn(system::partition, directory, pool, 1 << 20,
+                            actor{});
     self->send(partition, bro_conn_log);
     MESSAGE("ingesting http.log");
     self->send(partition, bro_http_log);
@@ -44,6 +67,19 @@ struct partition_fixture : fixtures::actor_system_and_events {
   ~partition_fixture() {
     self->send(partition, system::shutdown_atom::value);
     self->wait_for(partition);
+    system.registry().erase(system::accountant_atom::value);
+    self->send_exit(monitor, exit_reason::user_shutdown);
+  }
+
+  uint64_t counter(const std::string& key) {
+    uint64_t result = 0;
+    self->request(monitor, infinite, get_atom::value, key).receive(
+      [&](uint64_t hits) {
+        result = hits;
+      },
+      error_handler()
+    );
+    return result;
   }
 
   ids query(const std::string& str) {
@@ -65,17 +101,30 @@ struct partition_fixture : fixtures::actor_system_and_events {
     REQUIRE(exists(directory / "547119946" / "meta" / "time"));
     REQUIRE(exists(directory / "547119946" / "meta" / "type"));
     MESSAGE("respawning partition and sending query again");
-    partition = self->spawn(system::partition, directory);
+    partition = self->spawn(system::partition, directory, pool, 1 << 20,
+                            actor{});
     self->request(partition, infinite, *expr).receive(
       [&](const ids& hits) {
         REQUIRE_EQUAL(hits, result);
       },
       error_handler()
     );
+    MESSAGE("sending query to frozen partition with warm cache");
+    auto hits_before = counter("partition.cache.hits");
+    self->request(partition, infinite, *expr).receive(
+      [&](const ids& hits) {
+        REQUIRE_EQUAL(hits, result);
+      },
+      error_handler()
+    );
+    CHECK_GREATER(counter("partition.cache.hits"), hits_before);
     return result;
   }
 
+  std::shared_ptr<detail::work_stealing_pool> pool
+    = std::make_shared<detail::work_stealing_pool>(2);
   actor partition;
+  actor monitor;
 };
 
 } // namespace <anonymous>
@@ -110,4 +159,88 @@ TEST(partition queries - mixed) {
   CHECK_EQUAL(rank(hits), 28u);
 }
 
+TEST(predicate routing) {
+  std::vector<type> types{bro_conn_log[0].type(), bro_http_log[0].type(),
+                          bgpdump_txt[0].type()};
+  auto route = [&](const std::string& str) {
+    auto expr = to<expression>(str);
+    REQUIRE(expr);
+    auto pred = get_if<predicate>(*expr);
+    REQUIRE(pred);
+    std::vector<std::string> result;
+    for (auto& t : system::route(types, *pred))
+      result.push_back(t.name());
+    return result;
+  };
+  using names = std::vector<std::string>;
+  MESSAGE("key extractors");
+  CHECK_EQUAL(route("conn_state == \"SF\""), names{"bro::conn"});
+  CHECK_EQUAL(route("method == \"GET\""), names{"bro::http"});
+  CHECK_EQUAL(route("id.resp_p == 443/?"), (names{"bro::conn", "bro::http"}));
+  CHECK_EQUAL(route("foo == 42"), names{});
+  MESSAGE("attribute extractors");
+  CHECK_EQUAL(route("&type == \"bro::http\""), names{"bro::http"});
+  CHECK_EQUAL(route("&type != \"bro::http\""),
+              (names{"bro::conn", bgpdump_txt[0].type().name()}));
+  CHECK_EQUAL(route("&time > 1970-01-01").size(), 3u);
+}
+
+TEST(sealed partition caches predicate hits) {
+  auto expr = to<expression>("&type == \"bro::conn\"");
+  REQUIRE(expr);
+  auto run = [&] {
+    self->request(partition, infinite, *expr).receive(
+      [&](const ids& hits) {
+        CHECK_EQUAL(rank(hits), 8462u);
+      },
+      error_handler()
+    );
+  };
+  MESSAGE("querying partition that still receives events");
+  run();
+  run();
+  CHECK_EQUAL(counter("partition.cache.hits"), 0u);
+  MESSAGE("sealing partition");
+  self->send(partition, system::seal_atom::value);
+  run();
+  auto hits = counter("partition.cache.hits");
+  run();
+  CHECK_GREATER(counter("partition.cache.hits"), hits);
+}
+
+TEST(conjunctions evaluate selective predicates first) {
+  self->send(partition, system::seal_atom::value);
+  // The range predicate comes first, but the equality predicate has a lower
+  // estimate and yields no hits. The evaluation thus stops after a single
+  // lookup, which the cache accounts for as a single miss.
+  auto expr = to<expression>("id.resp_p > 0/? && conn_state == \"XX\"");
+  REQUIRE(expr);
+  self->request(partition, infinite, *expr).receive(
+    [&](const ids& hits) {
+      CHECK_EQUAL(rank(hits), 0u);
+    },
+    error_handler()
+  );
+  CHECK_EQUAL(counter("partition.cache.misses"), 1u);
+  CHECK_EQUAL(counter("partition.cache.hits"), 0u);
+}
+
+TEST(conjunctions report indexer errors) {
+  self->send(partition, system::seal_atom::value);
+  // String indexes do not support range queries. Since the failing predicate
+  // comes first, a truncated result would end up in the cache and answer
+  // the second query.
+  auto expr = to<expression>("conn_state < \"S\" && id.resp_p > 0/?");
+  REQUIRE(expr);
+  for (auto i = 0; i < 2; ++i)
+    self->request(partition, infinite, *expr).receive(
+      [&](const ids&) {
+        FAIL("expected an error");
+      },
+      [&](const error& e) {
+        CHECK(e == ec::unsupported_operator);
+      }
+    );
+}
+
 FIXTURE_SCOPE_END()
@@ -218,6 +218,16 @@ TEST(string) {
   auto multi = idx.lookup(in, set{"foo", "bar", "baz"});
   REQUIRE(multi);
   CHECK_EQUAL(to_string(*multi), "1111110000");
+  MESSAGE("lookups with many elements");
+  vector xs{"foo"};
+  for (auto i = 0; i < 20; ++i)
+    xs.push_back("x" + std::to_string(i));
+  CHECK_EQUAL(to_string(*idx.lookup(in, xs)),     "1001100000");
+  CHECK_EQUAL(to_string(*idx.lookup(not_in, xs)), "0110011111");
+  for (auto x : {"bar", "baz", "", "qux", "corge", "bazz"})
+    xs.insert(xs.begin(), x);
+  CHECK_EQUAL(to_string(*idx.lookup(in, xs)),     "1111111111");
+  CHECK_EQUAL(to_string(*idx.lookup(not_in, xs)), "0000000000");
   MESSAGE("serialization");
   std::vector<char> buf;
   save(buf, idx);
@@ -227,6 +237,141 @@ TEST(string) {
   CHECK_EQUAL(to_string(*idx2.lookup(equal, "bar")), "0100010000");
 }
 
+TEST(string with trigrams) {
+  string_index idx{100, true};
+  string_index ref{100};
+  MESSAGE("push_back");
+  auto xs = {"foobar", "barfoo", "xfooy", "fo", "", "oobfoo", "fooob", "foo"};
+  for (auto x : xs) {
+    REQUIRE(idx.push_back(x));
+    REQUIRE(ref.push_back(x));
+  }
+  REQUIRE(idx.push_back(nil));
+  REQUIRE(ref.push_back(nil));
+  MESSAGE("lookup");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "foo")),  "111001110");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "oob")),  "100001100");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "zzz")),  "000000000");
+  CHECK_EQUAL(to_string(*idx.lookup(not_ni, "foo")), "000110000");
+  MESSAGE("candidates for longer substrings");
+  // The trigrams of "foob" also occur in "oobfoo" and "fooob", but not in
+  // sequence.
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "foob")), "100001100");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "fooobx")), "000000000");
+  CHECK_EQUAL(to_string(*idx.lookup(not_ni, "foob")), "111111110");
+  for (auto x : {"fo", "foo", "oob", "zzz"}) {
+    CHECK_EQUAL(*idx.lookup(ni, x), *ref.lookup(ni, x));
+    CHECK_EQUAL(*idx.lookup(not_ni, x), *ref.lookup(not_ni, x));
+  }
+  for (auto x : {"foob", "barf", "oobfoo"}) {
+    auto candidates = *idx.lookup(ni, x);
+    CHECK_EQUAL(candidates | *ref.lookup(ni, x), candidates);
+  }
+  MESSAGE("serialization");
+  std::vector<char> buf;
+  save(buf, idx);
+  string_index idx2{};
+  load(buf, idx2);
+  CHECK_EQUAL(to_string(*idx2.lookup(ni, "foob")), "100001100");
+  CHECK_EQUAL(*idx2.lookup(ni, "oob"), *ref.lookup(ni, "oob"));
+}
+
+TEST(string patterns) {
+  string_index idx{100};
+  MESSAGE("push_back");
+  auto xs = {"foo", "foobar", "barfoo", "xfooy", "", "bar"};
+  for (auto x : xs)
+    REQUIRE(idx.push_back(x));
+  MESSAGE("exact lookups");
+  auto lookup = [&](relational_operator op, const char* rx) {
+    auto result = idx.lookup(op, pattern{rx});
+    REQUIRE(result);
+    return to_string(*result);
+  };
+  CHECK_EQUAL(lookup(match, "foo"),        "100000");
+  CHECK_EQUAL(lookup(not_match, "foo"),    "011111");
+  CHECK_EQUAL(lookup(match, "foo.*"),      "110000");
+  CHECK_EQUAL(lookup(in, "foo"),           "111100");
+  CHECK_EQUAL(lookup(in, "^bar"),          "001001");
+  CHECK_EQUAL(lookup(match, "qux.*"),      "000000");
+  CHECK(!idx.lookup(equal, pattern{"foo"}));
+  MESSAGE("candidate lookups");
+  CHECK_EQUAL(lookup(not_match, "f.o"),    "111111");
+  for (auto rx : {"f.o", ".*foo", "x.*y", "(foo|bar)", "fo+bar", "[a-z]+"}) {
+    auto pat = pattern{rx};
+    for (auto op : {match, in}) {
+      auto candidates = idx.lookup(op, pat);
+      REQUIRE(candidates);
+      bitmap hits;
+      for (auto x : xs)
+        hits.append_bit(op == match ? pat.match(x) : pat.search(x));
+      CHECK(all<0>(hits - *candidates));
+    }
+  }
+  MESSAGE("chopped strings");
+  string_index chopped{4};
+  REQUIRE(chopped.push_back("foobar"));
+  REQUIRE(chopped.push_back("foo"));
+  REQUIRE(chopped.push_back("foobaz"));
+  CHECK_EQUAL(to_string(*chopped.lookup(match, pattern{"foobar"})), "101");
+  CHECK_EQUAL(to_string(*chopped.lookup(not_match, pattern{"foobar"})),
+              "111");
+  CHECK_EQUAL(to_string(*chopped.lookup(match, pattern{"foo"})), "010");
+}
+
+TEST(dictionary) {
+  dictionary_index idx{100, 3};
+  MESSAGE("push_back");
+  REQUIRE(idx.push_back("foo"));
+  REQUIRE(idx.push_back("bar"));
+  REQUIRE(idx.push_back(nil));
+  REQUIRE(idx.push_back("foo"));
+  REQUIRE(idx.push_back(""));
+  REQUIRE(idx.push_back("bar", 7));
+  CHECK_EQUAL(idx.cardinality(), 3u);
+  CHECK(!idx.positional());
+  MESSAGE("lookup");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "foo")),     "10010000");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "bar")),     "01000001");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "")),        "00001000");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "qux")),     "00000000");
+  CHECK_EQUAL(to_string(*idx.lookup(not_equal, "foo")), "01001001");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "o")),          "10010000");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "")),           "11011001");
+  CHECK_EQUAL(to_string(*idx.lookup(not_ni, "a")),      "10011000");
+  CHECK_EQUAL(to_string(*idx.lookup(in, set{"foo", "bar"})), "11010001");
+  CHECK(!idx.lookup(match, "foo"));
+  CHECK_EQUAL(to_string(*idx.lookup(match, pattern{"f.o"})),     "10010000");
+  CHECK_EQUAL(to_string(*idx.lookup(not_match, pattern{"f.o"})), "01001001");
+  CHECK_EQUAL(to_string(*idx.lookup(in, pattern{"a"})),          "01000001");
+  CHECK_EQUAL(to_string(*idx.lookup(not_in, pattern{"a"})),      "10011000");
+  CHECK(!idx.lookup(match, pattern{"("}));
+  MESSAGE("serialization");
+  std::vector<char> buf;
+  save(buf, idx);
+  dictionary_index idx2{};
+  load(buf, idx2);
+  CHECK_EQUAL(idx2.cardinality(), 3u);
+  CHECK_EQUAL(to_string(*idx2.lookup(equal, "bar")), "01000001");
+  REQUIRE(idx2.push_back("foo"));
+  CHECK_EQUAL(to_string(*idx2.lookup(equal, "foo")), "100100001");
+  MESSAGE("switch to positional encoding");
+  REQUIRE(idx.push_back("baz"));
+  CHECK(idx.positional());
+  CHECK_EQUAL(idx.cardinality(), 0u);
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "foo")),     "100100000");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "bar")),     "010000010");
+  CHECK_EQUAL(to_string(*idx.lookup(equal, "baz")),     "000000001");
+  CHECK_EQUAL(to_string(*idx.lookup(not_equal, "foo")), "010010011");
+  CHECK_EQUAL(to_string(*idx.lookup(ni, "ba")),         "010000011");
+  buf.clear();
+  save(buf, idx);
+  dictionary_index idx3{};
+  load(buf, idx3);
+  CHECK(idx3.positional());
+  CHECK_EQUAL(to_string(*idx3.lookup(equal, "bar")), "010000010");
+}
+
 TEST(address) {
   address_index idx;
   MESSAGE("push_back");
@@ -471,3 +616,79 @@ TEST(polymorphic none values) {
   REQUIRE(bm);
   CHECK_EQUAL(to_string(*bm), "00000001100000001110000");
 }
+
+TEST(bulk append) {
+  std::vector<data> xs{nil, "foo", "foo", nil, "bar", "foobar", nil, "b"};
+  std::vector<event_id> ids{1, 2, 3, 7, 8, 9, 10, 42};
+  auto x = value_index::make(string_type{});
+  auto y = value_index::make(string_type{});
+  for (auto i = 0u; i < xs.size(); ++i)
+    REQUIRE(x->push_back(xs[i], ids[i]));
+  REQUIRE(y->append(xs, ids));
+  CHECK_EQUAL(y->offset(), 43u);
+  for (auto& str : {"foo", "bar", "foobar", "b", "x"}) {
+    auto bm = y->lookup(equal, str);
+    REQUIRE(bm);
+    CHECK_EQUAL(to_string(*bm), to_string(*x->lookup(equal, str)));
+  }
+  auto bm = y->lookup(equal, nil);
+  REQUIRE(bm);
+  CHECK_EQUAL(to_string(*bm), to_string(*x->lookup(equal, nil)));
+  MESSAGE("arithmetic values");
+  auto z = arithmetic_index<count>{base::uniform(10, 20)};
+  REQUIRE(z.push_back(count{17}, 2));
+  REQUIRE(z.append({count{42}, nil, count{17}, count{4711}}, {3, 4, 6, 7}));
+  bm = z.lookup(less, count{100});
+  REQUIRE(bm);
+  CHECK_EQUAL(to_string(*bm), "00110010");
+  bm = z.lookup(equal, count{17});
+  REQUIRE(bm);
+  CHECK_EQUAL(to_string(*bm), "00100010");
+  MESSAGE("ports");
+  auto p = port_index{};
+  REQUIRE(p.append({port{80, port::tcp}, port{53, port::udp}}, {0, 1}));
+  bm = p.lookup(equal, port{53, port::udp});
+  REQUIRE(bm);
+  CHECK_EQUAL(to_string(*bm), "01");
+  MESSAGE("invalid input");
+  CHECK(!z.append({count{1}}, {5}));
+  CHECK(!z.append({"foo"}, {8}));
+  CHECK_EQUAL(z.offset(), 8u);
+}
+
+TEST(restricted lookup) {
+  auto x = arithmetic_index<count>{base::uniform(10, 20)};
+  REQUIRE(x.append({count{1}, count{2}, count{1}, count{1}}, {0, 1, 2, 3}));
+  auto restriction = ids{};
+  restriction.append_bits(false, 2);
+  restriction.append_bits(true, 2);
+  auto bm = x.lookup(equal, count{1}, restriction);
+  REQUIRE(bm);
+  CHECK_EQUAL(to_string(*bm), "0011");
+  MESSAGE("disjoint restriction");
+  restriction = ids{};
+  restriction.append_bits(false, 10);
+  restriction.append_bit(true);
+  bm = x.lookup(equal, count{1}, restriction);
+  REQUIRE(bm);
+  CHECK_EQUAL(rank(*bm), 0u);
+}
+
+TEST(memory usage) {
+  auto t = type{string_type{}};
+  auto idx = value_index::make(t);
+  REQUIRE(idx);
+  auto empty = idx->memusage();
+  for (auto i = 0; i < 1000; ++i)
+    REQUIRE(idx->push_back("foo" + std::to_string(i)));
+  auto full = idx->memusage();
+  CHECK_GREATER(full, empty);
+  MESSAGE("deserialized index");
+  std::vector<char> buf;
+  save(buf, detail::value_index_inspect_helper{t, idx});
+  std::unique_ptr<value_index> idx2;
+  detail::value_index_inspect_helper helper{t, idx2};
+  load(buf, helper);
+  REQUIRE(idx2);
+  CHECK_GREATER(idx2->memusage(), empty);
+}
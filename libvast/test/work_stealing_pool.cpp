@@ -0,0 +1,53 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "vast/detail/work_stealing_pool.hpp"
+
+#define SUITE detail
+#include "test.hpp"
+
+using namespace vast;
+
+TEST(work stealing pool) {
+  std::atomic<int> sum = 0;
+  {
+    detail::work_stealing_pool pool{4};
+    CHECK_EQUAL(pool.workers(), 4u);
+    for (auto i = 1; i <= 100; ++i)
+      pool.submit([&, i] {
+        // Tasks spawned from a worker go into its own queue, from which
+        // idle workers steal.
+        pool.submit([&, i] { sum += i; });
+      });
+  }
+  // Destruction runs all remaining tasks.
+  CHECK_EQUAL(sum, 5050);
+}
+
+TEST(work stealing pool strand) {
+  std::vector<int> xs;
+  {
+    detail::work_stealing_pool pool{4};
+    auto strand = pool.make_strand();
+    for (auto i = 0; i < 1000; ++i)
+      strand->submit([&, i] { xs.push_back(i); });
+  }
+  REQUIRE_EQUAL(xs.size(), 1000u);
+  for (auto i = 0; i < 1000; ++i)
+    CHECK_EQUAL(xs[i], i);
+}
@@ -15,19 +15,26 @@
 #define VAST_BATCH_HPP
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
 #include <caf/binary_deserializer.hpp>
 #include <caf/binary_serializer.hpp>
 #include <caf/message.hpp>
+#include <caf/meta/load_callback.hpp>
 #include <caf/streambuf.hpp>
 
 #include "vast/aliases.hpp"
 #include "vast/bitmap.hpp"
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/compression.hpp"
 #include "vast/detail/compressedbuf.hpp"
+#include "vast/error.hpp"
 #include "vast/expected.hpp"
+#include "vast/offset.hpp"
+#include "vast/rank_select_directory.hpp"
 #include "vast/time.hpp"
 #include "vast/type.hpp"
 
@@ -41,6 +48,35 @@ class batch {
   using size_type = uint64_t;
 
 public:
+  /// The physical layout of the events in a batch.
+  enum class encoding : int8_t {
+    /// One event after another, each serialized as a whole.
+    row = 0,
+    /// Grouped by type, with a column for the timestamps and one for each
+    /// field. A column consists of a null bitmap and the values, stored as
+    /// typed array or as dictionary in the case of strings.
+    columnar = 1
+  };
+
+  /// A position in the serialized events of a row-based batch from where a
+  /// reader can start decoding. It coincides with the beginning of a
+  /// compressed block and the writer repeats all type definitions after it.
+  struct seek_point {
+    /// The ordinal of the first event after the seek point.
+    size_type event;
+
+    /// The offset of the seek point in the serialized events.
+    size_type offset;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, seek_point& x) {
+      return f(x.event, x.offset);
+    }
+  };
+
+  /// The number of events between two seek points.
+  static constexpr size_type seek_interval = 1024;
+
   /// A proxy class to write events into the batch.
   class writer;
 
@@ -65,24 +101,46 @@ public:
   /// Retrieves the bitmap of IDs for this batch
   const bitmap& ids() const;
 
+  /// Retrieves the smallest ID of this batch.
+  /// @returns The first ID or `invalid_event_id` if the batch has no IDs.
+  event_id first_id() const;
+
+  /// Retrieves the largest ID of this batch.
+  /// @returns The last ID or `invalid_event_id` if the batch has no IDs.
+  event_id last_id() const;
+
   /// Retrieves the number of events in the batch.
   /// @returns The number of events in the batch.
   size_type events() const;
 
   template <class Inspector>
   friend auto inspect(Inspector& f, batch& b) {
-    return f(b.method_, b.first_, b.last_, b.events_, b.ids_, b.data_);
+    auto load = [&]() -> error {
+      b.index_ids();
+      return {};
+    };
+    return f(b.method_, b.encoding_, b.first_, b.last_, b.events_, b.ids_,
+             b.seek_points_, b.data_, caf::meta::load_callback(load));
   }
 
   // TODO: make this a generic concept that leverages the inspection API.
   friend uint64_t bytes(const batch&);
 
 private:
+  /// Computes first and last ID, and a rank/select directory for IDs that
+  /// are not contiguous.
+  void index_ids();
+
   compression method_;
+  encoding encoding_ = encoding::row;
   timestamp first_ = timestamp::max();
   timestamp last_ = timestamp::min();
   size_type events_ = 0;
   bitmap ids_;
+  event_id first_id_ = invalid_event_id;
+  event_id last_id_ = invalid_event_id;
+  rank_select_directory id_directory_;
+  std::vector<seek_point> seek_points_;
   buffer_type data_;
 };
 
@@ -90,18 +148,26 @@ class batch::writer {
 public:
   /// Constructs a writer from a batch.
   /// @param method The compression method to use.
-  writer(compression method = compression::null);
+  /// @param layout The layout of the events in the batch.
+  writer(compression method = compression::null,
+         encoding layout = encoding::row);
+
+  ~writer();
 
   /// Writes an event into the batch.
   /// @param e The event to serialize.
+  /// @returns `false` if the data of *e* does not match its type.
   bool write(const event& e);
 
   /// Constructs a batch from the accumulated events.
   batch seal();
 
 private:
+  struct column_state;
+
   batch batch_;
   std::unordered_map<type, uint32_t> type_cache_;
+  std::unique_ptr<column_state> columns_;
   caf::vectorbuf vectorbuf_;
   detail::compressedbuf compressedbuf_;
   caf::stream_serializer<detail::compressedbuf&> serializer_;
@@ -109,10 +175,16 @@ private:
 
 class batch::reader {
 public:
+  /// Selects the fields to decode, given the event type and the offset of a
+  /// field within the type.
+  using projection = std::function<bool(const type&, const offset&)>;
+
   /// Constructs a reader from a batch.
   /// @param b The batch to extract objects from.
   reader(const batch& b);
 
+  ~reader();
+
   /// Extracts all events.
   /// @returns The set events in the corresponding batch.
   expected<std::vector<event>> read();
@@ -122,9 +194,26 @@ public:
   /// @returns The set events according to *ids*.
   expected<std::vector<event>> read(const bitmap& ids);
 
+  /// Extracts events according to a bitmap, decoding only some fields. For a
+  /// columnar batch, the reader decodes only the columns of selected fields
+  /// and leaves the other fields nil. For a row-based batch, it decodes all
+  /// fields.
+  /// @param ids The set of event IDs encoded as bitmap.
+  /// @param project The function that selects the fields to decode.
+  /// @returns The set events according to *ids*.
+  expected<std::vector<event>> read(const bitmap& ids, projection project);
+
 private:
+  struct column_state;
+
   expected<event> materialize();
 
+  expected<event> materialize_columns();
+
+  // Skips all events up to the last seek point before a given ID.
+  void seek(event_id id);
+
+  const batch& batch_;
   const buffer_type& data_;
   std::unordered_map<uint32_t, type> type_cache_;
   select_range<bitmap_bit_range> id_range_;
@@ -132,6 +221,8 @@ private:
   caf::charbuf charbuf_;
   detail::compressedbuf compressedbuf_;
   caf::stream_deserializer<detail::compressedbuf&> deserializer_;
+  std::unique_ptr<column_state> columns_;
+  projection project_;
 };
 
 } // namespace vast
@@ -14,10 +14,14 @@
 #ifndef VAST_BITMAP_HPP
 #define VAST_BITMAP_HPP
 
+#include <vector>
+
 #include "vast/bitmap_base.hpp"
+#include "vast/config.hpp"
 #include "vast/detail/type_traits.hpp"
 #include "vast/ewah_bitmap.hpp"
 #include "vast/null_bitmap.hpp"
+#include "vast/roaring_bitmap.hpp"
 #include "vast/wah_bitmap.hpp"
 #include "vast/variant.hpp"
 
@@ -30,12 +34,19 @@ class bitmap : public bitmap_base<bitmap>,
   using bitmap_variant = variant<
     ewah_bitmap,
     null_bitmap,
-    wah_bitmap
+    wah_bitmap,
+    roaring_bitmap
   >;
 
 public:
-  /// The concrete bitmap type to be used for default construction.
+  /// The concrete bitmap type to be used for default construction. Building
+  /// with `VAST_USE_ROARING_BITMAPS` favors fast random access and
+  /// intersections of medium-density bitmaps over compact runs.
+#ifdef VAST_USE_ROARING_BITMAPS
+  using default_bitmap = roaring_bitmap;
+#else
   using default_bitmap = ewah_bitmap;
+#endif
 
   /// Default-constructs a bitmap of type ::default_bitmap.
   bitmap();
@@ -62,6 +73,18 @@ public:
 
   size_type size() const;
 
+  /// @returns An estimate of the number of bytes the bitmap occupies in
+  ///          memory.
+  size_t memusage() const;
+
+  // -- element access -------------------------------------------------------
+
+  /// Accesses the *i*-th bit with the algorithm of the concrete bitmap type.
+  /// @param i The index into the bitmap.
+  /// @returns `true` iff bit *i* is 1.
+  /// @pre `i < size()`
+  bool operator[](size_type i) const;
+
   // -- modifiers ------------------------------------------------------------
 
   void append_bit(bool bit);
@@ -101,7 +124,8 @@ private:
   using range_variant = variant<
     ewah_bitmap_range,
     null_bitmap_range,
-    wah_bitmap_range
+    wah_bitmap_range,
+    roaring_bitmap_range
   >;
 
   range_variant range_;
@@ -109,6 +133,37 @@ private:
 
 bitmap_bit_range bit_range(const bitmap& bm);
 
+// -- algorithms -------------------------------------------------------------
+//
+// When both operands hold EWAH or both hold Roaring bitmaps, the following
+// overloads dispatch to the specialized algorithms and otherwise to the
+// generic ones.
+
+bitmap binary_and(const bitmap& lhs, const bitmap& rhs);
+
+bitmap binary_or(const bitmap& lhs, const bitmap& rhs);
+
+bitmap binary_xor(const bitmap& lhs, const bitmap& rhs);
+
+bitmap binary_nand(const bitmap& lhs, const bitmap& rhs);
+
+/// Computes the bitwise OR of several bitmaps. If they all hold EWAH bitmaps
+/// of the same size, this uses the single-pass EWAH algorithm and otherwise
+/// falls back to ::nary_or over the range.
+/// @param xs The bitmaps to combine.
+/// @returns The bitwise OR of all bitmaps in *xs*.
+bitmap nary_or(const std::vector<bitmap>& xs);
+
+/// Computes the *rank* of a bitmap with the algorithm of the concrete bitmap
+/// type.
+/// @tparam Bit The bit value to count.
+/// @param bm The bitmap whose rank to compute.
+/// @returns The population count of *bm*.
+template <bool Bit = true>
+bitmap::size_type rank(const bitmap& bm) {
+  return visit([](auto& x) -> bitmap::size_type { return rank<Bit>(x); }, bm);
+}
+
 } // namespace vast
 
 #endif
@@ -40,6 +40,44 @@ struct eval_result_type {
 template <class T, class U>
 using eval_result_type_t = typename eval_result_type<T, U>::type;
 
+// The block-wise operations of the binary algorithms. Concrete bitmap types
+// with specialized algorithms fall back to these for the generic case.
+
+struct and_op {
+  template <class T>
+  T operator()(T x, T y) const {
+    return x & y;
+  }
+};
+
+struct or_op {
+  template <class T>
+  T operator()(T x, T y) const {
+    return x | y;
+  }
+};
+
+struct xor_op {
+  template <class T>
+  T operator()(T x, T y) const {
+    return x ^ y;
+  }
+};
+
+struct nand_op {
+  template <class T>
+  T operator()(T x, T y) const {
+    return x & ~y;
+  }
+};
+
+struct nor_op {
+  template <class T>
+  T operator()(T x, T y) const {
+    return x | ~y;
+  }
+};
+
 } // namespace detail
 
 /// Applies a bitwise operation on two immutable bitmaps, writing the result
@@ -78,6 +116,16 @@ binary_eval(const LHS& lhs, const RHS& rhs, Operation op) {
   auto is_fill = [](auto x) {
     return x->homogeneous() && x->size() >= word_type::width;
   };
+  // Extracts the next *n* bits from a sequence of which *remaining* bits
+  // have not been consumed yet. Since bitmaps of different types need not
+  // align their sequences at block boundaries, we may have to continue in
+  // the middle of a literal.
+  auto take = [](auto x, uint64_t remaining, uint64_t n) {
+    auto data = x->size() > word_type::width
+      ? x->data()
+      : x->data() >> (x->size() - remaining);
+    return data & word_type::lsb_fill(n);
+  };
   result_type result;
   // Initialize LHS.
   auto lhs_range = bit_range(lhs);
@@ -91,28 +139,21 @@ binary_eval(const LHS& lhs, const RHS& rhs, Operation op) {
   uint64_t lhs_bits = lhs.empty() ? 0 : lhs_begin->size();
   uint64_t rhs_bits = rhs.empty() ? 0 : rhs_begin->size();
   while (lhs_begin != lhs_end && rhs_begin != rhs_end) {
-    auto block = op(lhs_begin->data(), rhs_begin->data());
     if (is_fill(lhs_begin) && is_fill(rhs_begin)) {
+      auto block = op(lhs_begin->data(), rhs_begin->data());
       VAST_ASSERT(word_type::all_or_none(block));
       auto min_bits = std::min(lhs_bits, rhs_bits);
       result.append_bits(block, min_bits);
       lhs_bits -= min_bits;
       rhs_bits -= min_bits;
-    } else if (is_fill(lhs_begin)) {
-      VAST_ASSERT(rhs_bits > 0);
-      VAST_ASSERT(rhs_bits <= word_type::width);
-      result.append_block(block);
-      lhs_bits -= word_type::width;
-      rhs_bits = 0;
-    } else if (is_fill(rhs_begin)) {
-      VAST_ASSERT(lhs_bits > 0);
-      VAST_ASSERT(lhs_bits <= word_type::width);
-      result.append_block(block);
-      rhs_bits -= word_type::width;
-      lhs_bits = 0;
     } else {
-      result.append_block(block, std::max(lhs_bits, rhs_bits));
-      lhs_bits = rhs_bits = 0;
+      // At least one side is a literal, so we can process at most one block.
+      auto n = std::min({lhs_bits, rhs_bits, uint64_t{word_type::width}});
+      auto l = take(lhs_begin, lhs_bits, n);
+      auto r = take(rhs_begin, rhs_bits, n);
+      result.append_block(op(l, r) & word_type::lsb_fill(n), n);
+      lhs_bits -= n;
+      rhs_bits -= n;
     }
     if (lhs_bits == 0 && ++lhs_begin != lhs_end)
       lhs_bits = lhs_begin->size();
@@ -122,33 +163,26 @@ binary_eval(const LHS& lhs, const RHS& rhs, Operation op) {
   // Fill the remaining bits, either with zeros or with the longer bitmap. If
   // we woudn't fill up the bitmap, we would end up with a shorter bitmap that
   // doesn't reflect the true result size.
-  if (!FillLHS && !FillLHS) {
+  auto fill = [&](auto& begin, auto& end, uint64_t bits) {
+    while (begin != end) {
+      if (is_fill(begin))
+        result.append_bits(begin->data(), bits);
+      else
+        result.append_block(take(begin, bits, bits), bits);
+      if (++begin != end)
+        bits = begin->size();
+    }
+  };
+  if (FillLHS)
+    fill(lhs_begin, lhs_end, lhs_bits);
+  if (FillRHS)
+    fill(rhs_begin, rhs_end, rhs_bits);
+  // Unless one side is empty and the operation disregards the remainder of
+  // the other side, the result spans the longer of the two bitmaps.
+  if ((!FillLHS && !FillRHS) || (!lhs.empty() && !rhs.empty())) {
     auto max_size = std::max(lhs.size(), rhs.size());
     VAST_ASSERT(max_size >= result.size());
     result.append_bits(false, max_size - result.size());
-  } else {
-    if (FillLHS) {
-      while (lhs_begin != lhs_end) {
-        if (is_fill(lhs_begin))
-          result.append_bits(lhs_begin->data(), lhs_bits);
-        else
-          result.append_block(lhs_begin->data(), lhs_begin->size());
-        ++lhs_begin;
-        if (lhs_begin != lhs_end)
-          lhs_bits = lhs_begin->size();
-      }
-    }
-    if (FillRHS) {
-      while (rhs_begin != rhs_end) {
-        if (is_fill(rhs_begin))
-          result.append_bits(rhs_begin->data(), rhs_bits);
-        else
-          result.append_block(rhs_begin->data(), rhs_begin->size());
-        ++rhs_begin;
-        if (rhs_begin != rhs_end)
-          rhs_bits = rhs_begin->size();
-      }
-    }
   }
   return result;
 }
@@ -202,32 +236,27 @@ auto nary_eval(Iterator begin, Iterator end, Operation op) {
 
 template <class LHS, class RHS>
 auto binary_and(const LHS& lhs, const RHS& rhs) {
-  auto op = [](auto x, auto y) { return x & y; };
-  return binary_eval<false, false>(lhs, rhs, op);
+  return binary_eval<false, false>(lhs, rhs, detail::and_op{});
 }
 
 template <class LHS, class RHS>
 auto binary_or(const LHS& lhs, const RHS& rhs) {
-  auto op = [](auto x, auto y) { return x | y; };
-  return binary_eval<true, true>(lhs, rhs, op);
+  return binary_eval<true, true>(lhs, rhs, detail::or_op{});
 }
 
 template <class LHS, class RHS>
 auto binary_xor(const LHS& lhs, const RHS& rhs) {
-  auto op = [](auto x, auto y) { return x ^ y; };
-  return binary_eval<true, true>(lhs, rhs, op);
+  return binary_eval<true, true>(lhs, rhs, detail::xor_op{});
 }
 
 template <class LHS, class RHS>
 auto binary_nand(const LHS& lhs, const RHS& rhs) {
-  auto op = [](auto x, auto y) { return x & ~y; };
-  return binary_eval<true, false>(lhs, rhs, op);
+  return binary_eval<true, false>(lhs, rhs, detail::nand_op{});
 }
 
 template <class LHS, class RHS>
 auto binary_nor(const LHS& lhs, const RHS& rhs) {
-  auto op = [](auto x, auto y) { return x | ~y; };
-  return binary_eval<true, true>(lhs, rhs, op);
+  return binary_eval<true, true>(lhs, rhs, detail::nor_op{});
 }
 
 template <class Iterator>
@@ -296,7 +325,7 @@ select(const Bitmap& bm, typename Bitmap::size_type i) {
   if (i == Bitmap::word_type::npos) {
     auto last = Bitmap::word_type::npos;
     for (auto b : bit_range(bm)) {
-      auto l = find_last(b);
+      auto l = find_last<Bit>(b);
       if (l != Bitmap::word_type::npos)
         last = n + l;
       n += b.size();
@@ -384,8 +413,11 @@ public:
         if (n > rng_.get().size()) {
           n -= rng_.get().size();
         } else {
-          i_ = n - 2;
-          next();
+          // Land on the first 1-bit at or after offset n - 1. Since
+          // find_next only looks past a given offset, offset 0 needs
+          // find_first.
+          i_ = n == 1 ? find_first(rng_.get()) : find_next(rng_.get(), n - 2);
+          scan();
           break;
         }
         n_ += rng_.get().size();
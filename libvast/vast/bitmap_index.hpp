@@ -14,7 +14,10 @@
 #ifndef VAST_BITMAP_INDEX_HPP
 #define VAST_BITMAP_INDEX_HPP
 
+#include <iterator>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "vast/base.hpp"
 #include "vast/binner.hpp"
@@ -73,6 +76,22 @@ public:
     coder_.encode(transform(binner_type::bin(x)), n, skip);
   }
 
+  /// Appends a sequence of values. This has the same effect as invoking
+  /// `push_back(x, skip)` for each pair *(x, skip)* in *[first, last)*, but
+  /// bins all values first and then lets the coder fill one bitmap at a time.
+  /// @param first An iterator to the first pair of value and skip.
+  /// @param last The iterator past the last pair.
+  /// @post Skipped entries show up as 0s during decoding.
+  template <class Iterator>
+  void append_batch(Iterator first, Iterator last) {
+    using coder_value_type = typename coder_type::value_type;
+    std::vector<std::pair<coder_value_type, size_type>> xs;
+    xs.reserve(std::distance(first, last));
+    for (; first != last; ++first)
+      xs.emplace_back(transform(binner_type::bin(first->first)), first->second);
+    coder_.encode_batch(xs.begin(), xs.end());
+  }
+
   /// Appends the contents of another bitmap index to this one.
   /// @param other The other bitmap index.
   void append(const bitmap_index& other) {
@@ -93,6 +112,12 @@ public:
     return coder_.size();
   }
 
+  /// Estimates the memory footprint of the bitmap index.
+  /// @returns The number of bytes the bitmap index occupies in memory.
+  size_t memusage() const {
+    return coder_.memusage();
+  }
+
   /// Checks whether the bitmap index is empty.
   /// @returns `true` *iff* the bitmap index has 0 entries.
   bool empty() const {
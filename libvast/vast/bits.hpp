@@ -64,7 +64,7 @@ class bits {
   /// Checks whether all bits have the same value.
   /// @returns `true` if the bits are either all 0 or all 1.
   bool homogeneous() const {
-    return size_ == word_type::width
+    return size_ >= word_type::width
       ? word_type::all_or_none(data_)
       : word_type::all_or_none(data_, size_);
   }
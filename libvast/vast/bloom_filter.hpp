@@ -0,0 +1,83 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_BLOOM_FILTER_HPP
+#define VAST_BLOOM_FILTER_HPP
+
+#include <cstdint>
+
+#include "vast/bitvector.hpp"
+#include "vast/detail/operators.hpp"
+
+namespace vast {
+
+/// A Bloom filter over 64-bit digests. The filter derives its *k* hash
+/// functions from a single digest via double hashing, i.e., the *i*-th
+/// position is *h1 + i * h2 mod m*, where *h1* and *h2* are the lower and
+/// upper 32 bits of the digest.
+class bloom_filter : detail::equality_comparable<bloom_filter> {
+public:
+  using size_type = uint64_t;
+  using digest_type = uint64_t;
+
+  /// Default-constructs an empty Bloom filter that cannot hold elements.
+  bloom_filter() = default;
+
+  /// Constructs a Bloom filter with a fixed number of cells.
+  /// @param num_bits The number of cells of the underlying bit vector.
+  /// @param num_hashes The number of hash functions.
+  /// @pre `num_bits > 0 && num_hashes > 0`
+  bloom_filter(size_type num_bits, size_type num_hashes);
+
+  /// Adds a digest to the filter.
+  /// @param x The digest to add.
+  /// @pre `!empty()`
+  void add(digest_type x);
+
+  /// Checks whether the filter may contain a digest.
+  /// @param x The digest to test.
+  /// @returns `false` if *x* is certainly not in the filter, and `true` if
+  ///          *x* may be in the filter.
+  bool lookup(digest_type x) const;
+
+  /// @returns The number of cells in the filter.
+  size_type size() const;
+
+  /// @returns The number of hash functions.
+  size_type num_hashes() const;
+
+  /// @returns `true` iff the filter has no cells.
+  bool empty() const;
+
+  /// @returns An estimate of the number of bytes the filter occupies in
+  ///          memory.
+  size_t memusage() const;
+
+  friend bool operator==(const bloom_filter& x, const bloom_filter& y);
+
+  template <class Inspector>
+  friend auto inspect(Inspector& f, bloom_filter& x) {
+    return f(x.num_hashes_, x.bits_);
+  }
+
+private:
+  size_type position(digest_type x, size_type i) const;
+
+  size_type num_hashes_ = 0;
+  bitvector<uint64_t> bits_;
+};
+
+} // namespace vast
+
+#endif
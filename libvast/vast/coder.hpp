@@ -16,9 +16,11 @@
 
 #include <algorithm>
 #include <array>
+#include <iterator>
 #include <limits>
 #include <vector>
 #include <type_traits>
+#include <utility>
 
 #include <caf/meta/load_callback.hpp>
 #include <caf/meta/save_callback.hpp>
@@ -29,6 +31,71 @@
 #include "vast/detail/operators.hpp"
 
 namespace vast {
+namespace detail {
+
+/// Buffers bits destined for a bitmap and appends them either as runs or as
+/// entire blocks, instead of one bit at a time.
+template <class Bitmap>
+class bit_appender {
+public:
+  using block_type = typename Bitmap::block_type;
+  using size_type = typename Bitmap::size_type;
+  using word_type = typename Bitmap::word_type;
+
+  /// Constructs a bit appender for a given bitmap.
+  /// @param bm The bitmap to append to.
+  explicit bit_appender(Bitmap& bm) : bitmap_{bm} {
+  }
+
+  ~bit_appender() {
+    flush();
+  }
+
+  /// Appends a sequence of bits.
+  /// @param bit The bit value.
+  /// @param n The number of times to append *bit*.
+  void append(bool bit, size_type n) {
+    if (n == 0)
+      return;
+    // Fill up the pending block first.
+    if (size_ > 0) {
+      auto k = std::min(n, word_type::width - size_);
+      if (bit)
+        block_ |= word_type::lsb_fill(k) << size_;
+      size_ += k;
+      n -= k;
+      if (size_ < word_type::width)
+        return;
+      flush();
+    }
+    // Append runs spanning entire blocks directly.
+    auto run = n - n % word_type::width;
+    if (run > 0) {
+      bitmap_.append_bits(bit, run);
+      n -= run;
+    }
+    if (n > 0) {
+      block_ = bit ? word_type::lsb_fill(n) : word_type::none;
+      size_ = n;
+    }
+  }
+
+  /// Appends the pending block to the bitmap.
+  void flush() {
+    if (size_ == 0)
+      return;
+    bitmap_.append_block(block_, size_);
+    block_ = word_type::none;
+    size_ = 0;
+  }
+
+private:
+  Bitmap& bitmap_;
+  block_type block_ = word_type::none;
+  size_type size_ = 0;
+};
+
+} // namespace detail
 
 /// The concept class for bitmap coders. A coder offers two basic primitives:
 /// encoding and decoding of (one or more) values into bitmap storage. The
@@ -50,6 +117,14 @@ struct coder {
   /// @post Skipped entries show up as 0s during decoding.
   void encode(value_type x, size_type n = 1, size_type skip = 0);
 
+  /// Encodes a sequence of values, each one time. This has the same effect
+  /// as invoking `encode(x, 1, skip)` for each pair *(x, skip)* in
+  /// *[first, last)*, but fills the bitmaps one after another.
+  /// @param first An iterator to the first pair of value and skip.
+  /// @param last The iterator past the last pair.
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last);
+
   /// Decodes a value under a relational operator.
   /// @param x The value to decode.
   /// @param op The relation operator under which to decode *x*.
@@ -68,6 +143,10 @@ struct coder {
 
   /// Retrieves the coder-specific bitmap storage.
   auto& storage() const;
+
+  /// Estimates the memory footprint of the coder.
+  /// @returns The number of bytes the coder occupies in memory.
+  size_t memusage() const;
 };
 
 /// A coder that wraps a single bitmap (and can thus only stores 2 values).
@@ -83,6 +162,13 @@ public:
     bitmap_.append_bits(x, n + skip);
   }
 
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last) {
+    detail::bit_appender<Bitmap> out{bitmap_};
+    for (; first != last; ++first)
+      out.append(first->first, first->second + 1);
+  }
+
   Bitmap decode(relational_operator op, value_type x) const {
     VAST_ASSERT(op == equal || op == not_equal);
     auto result = bitmap_;
@@ -100,6 +186,10 @@ public:
     return bitmap_.size();
   }
 
+  size_t memusage() const {
+    return bitmap_.memusage();
+  }
+
   const Bitmap& storage() const {
     return bitmap_;
   }
@@ -138,6 +228,13 @@ public:
     return size_;
   }
 
+  size_t memusage() const {
+    auto result = (bitmaps_.capacity() - bitmaps_.size()) * sizeof(Bitmap);
+    for (auto& bm : bitmaps_)
+      result += bm.memusage();
+    return result;
+  }
+
   auto& storage() const {
     return bitmaps_;
   }
@@ -182,6 +279,31 @@ public:
     this->size_ += skip + n;
   }
 
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last) {
+    // Group the positions by value so that we touch one bitmap at a time.
+    std::vector<std::pair<value_type, size_type>> xs;
+    auto pos = this->size_;
+    for (; first != last; ++first) {
+      VAST_ASSERT(first->first < this->bitmaps_.size());
+      pos += first->second;
+      xs.emplace_back(first->first, pos++);
+    }
+    VAST_ASSERT(Bitmap::max_size >= pos);
+    std::sort(xs.begin(), xs.end());
+    for (auto i = xs.begin(); i != xs.end(); ) {
+      auto& bm = this->bitmaps_[i->first];
+      auto size = bm.size();
+      detail::bit_appender<Bitmap> out{bm};
+      for (auto x = i->first; i != xs.end() && i->first == x; ++i) {
+        out.append(false, i->second - size);
+        out.append(true, 1);
+        size = i->second + 1;
+      }
+    }
+    this->size_ = pos;
+  }
+
   Bitmap decode(relational_operator op, value_type x) const {
     VAST_ASSERT(op == less || op == less_equal || op == equal || op == not_equal
                 || op == greater_equal || op == greater);
@@ -259,6 +381,22 @@ public:
     this->size_ += n + skip;
   }
 
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last) {
+    for (auto i = 0u; i < this->bitmaps_.size(); ++i) {
+      auto& bm = this->bitmaps_[i];
+      detail::bit_appender<Bitmap> out{bm};
+      out.append(true, this->size_ - bm.size());
+      for (auto x = first; x != last; ++x) {
+        VAST_ASSERT(x->first < this->bitmaps_.size() + 1);
+        out.append(true, x->second);
+        out.append(i >= x->first, 1);
+      }
+    }
+    for (; first != last; ++first)
+      this->size_ += first->second + 1;
+  }
+
   Bitmap decode(relational_operator op, value_type x) const {
     VAST_ASSERT(op == less || op == less_equal || op == equal || op == not_equal
                 || op == greater_equal || op == greater);
@@ -328,6 +466,21 @@ public:
     this->size_ += n + skip;
   }
 
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last) {
+    for (auto i = 0u; i < this->bitmaps_.size(); ++i) {
+      auto& bm = this->bitmaps_[i];
+      detail::bit_appender<Bitmap> out{bm};
+      out.append(false, this->size_ - bm.size());
+      for (auto x = first; x != last; ++x) {
+        out.append(false, x->second);
+        out.append(((x->first >> i) & 1) == 0, 1);
+      }
+    }
+    for (; first != last; ++first)
+      this->size_ += first->second + 1;
+  }
+
   // RangeEval-Opt for the special case with uniform base 2.
   Bitmap decode(relational_operator op, value_type x) const {
     switch (op) {
@@ -436,6 +589,24 @@ public:
       coders_[i].encode(xs_[i], n, skip);
   }
 
+  template <class Iterator>
+  void encode_batch(Iterator first, Iterator last) {
+    if (xs_.empty())
+      init();
+    // Decompose all values up front and then encode one component at a time.
+    using component = std::vector<std::pair<value_type, size_type>>;
+    std::vector<component> components(base_.size());
+    for (auto& c : components)
+      c.reserve(std::distance(first, last));
+    for (; first != last; ++first) {
+      base_.decompose(first->first, xs_);
+      for (auto i = 0u; i < base_.size(); ++i)
+        components[i].emplace_back(xs_[i], first->second);
+    }
+    for (auto i = 0u; i < base_.size(); ++i)
+      coders_[i].encode_batch(components[i].begin(), components[i].end());
+  }
+
   auto decode(relational_operator op, value_type x) const {
     return coders_.empty() ? bitmap_type{} : decode(coders_, op, x);
   }
@@ -450,6 +621,13 @@ public:
     return coders_.empty() ? 0 : coders_[0].size();
   }
 
+  size_t memusage() const {
+    auto result = xs_.capacity() * sizeof(value_type);
+    for (auto& x : coders_)
+      result += x.memusage();
+    return result;
+  }
+
   auto& storage() const {
     return coders_;
   }
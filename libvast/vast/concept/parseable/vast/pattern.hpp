@@ -34,7 +34,11 @@ struct access::parser<pattern> : vast::parser<access::parser<pattern>> {
 
   template <class Iterator>
   bool parse(Iterator& f, const Iterator& l, pattern& a) const {
-    return pattern_parser{}(f, l, a.str_);
+    std::string str;
+    if (!pattern_parser{}(f, l, str))
+      return false;
+    a = pattern{std::move(str)};
+    return true;
   }
 };
 
@@ -0,0 +1,117 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_DETAIL_BLOCK_ARENA_HPP
+#define VAST_DETAIL_BLOCK_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vast/chunk.hpp"
+
+namespace vast::detail {
+
+/// A read-only view of a contiguous sequence of bitmap blocks.
+class block_view {
+public:
+  using block_type = uint64_t;
+  using const_iterator = const block_type*;
+
+  block_view() = default;
+
+  block_view(const block_type* data, size_t size) : data_{data}, size_{size} {
+    // nop
+  }
+
+  const block_type* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const_iterator begin() const {
+    return data_;
+  }
+
+  const_iterator end() const {
+    return data_ + size_;
+  }
+
+  const block_type& operator[](size_t i) const {
+    return data_[i];
+  }
+
+  const block_type& back() const {
+    return data_[size_ - 1];
+  }
+
+private:
+  const block_type* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+/// Stores the blocks of bitmaps out of line during serialization, such that
+/// they end up in a single contiguous and aligned array next to the remaining
+/// state. Serializers and deserializers that also derive from this class
+/// allow bitmaps to write their blocks in bulk and to reference them without
+/// copying after loading.
+class block_arena {
+public:
+  using block_type = block_view::block_type;
+
+  /// Constructs an empty arena for writing.
+  block_arena() = default;
+
+  /// Constructs an arena for reading.
+  /// @param chk The chunk holding the blocks.
+  /// @param blocks A pointer into *chk* to the first block.
+  /// @param size The number of blocks.
+  /// @pre *blocks* is suitably aligned for `block_type`.
+  block_arena(chunk_ptr chk, const block_type* blocks, size_t size);
+
+  /// Appends a sequence of blocks.
+  /// @param xs The blocks to append.
+  /// @returns The offset of the first block of *xs* in the arena.
+  uint64_t append(block_view xs);
+
+  /// Retrieves a sequence of blocks.
+  /// @param offset The offset of the first block.
+  /// @param size The number of blocks.
+  /// @returns A pointer to the first block or `nullptr` if the sequence
+  ///          exceeds the arena bounds.
+  const block_type* get(uint64_t offset, uint64_t size) const;
+
+  /// @returns The chunk that owns the blocks of a readable arena.
+  const chunk_ptr& chunk() const;
+
+  /// @returns All blocks of the arena.
+  block_view blocks() const;
+
+private:
+  std::vector<block_type> buffer_;
+  chunk_ptr chunk_;
+  const block_type* blocks_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace vast::detail
+
+#endif
@@ -0,0 +1,53 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_DETAIL_BLOCK_KERNELS_HPP
+#define VAST_DETAIL_BLOCK_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vast::detail {
+
+// Bulk operations over contiguous sequences of 64-bit blocks. The first call
+// selects the widest instruction set the CPU supports (AVX2, SSE4.2, or a
+// portable scalar loop), so that callers need not care about the hardware.
+// All binary operations allow *out* to alias *x* or *y*.
+
+/// Computes `out[i] = x[i] & y[i]` for all *i* in *[0,n)*.
+void and_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n);
+
+/// Computes `out[i] = x[i] | y[i]` for all *i* in *[0,n)*.
+void or_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n);
+
+/// Computes `out[i] = x[i] ^ y[i]` for all *i* in *[0,n)*.
+void xor_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out, size_t n);
+
+/// Computes `out[i] = x[i] & ~y[i]` for all *i* in *[0,n)*.
+void nand_blocks(const uint64_t* x, const uint64_t* y, uint64_t* out,
+                 size_t n);
+
+/// Computes `out[i] = ~x[i]` for all *i* in *[0,n)*.
+void not_blocks(const uint64_t* x, uint64_t* out, size_t n);
+
+/// Counts the 1-bits in a sequence of blocks.
+/// @returns The population count of *xs[0,n)*.
+uint64_t popcount_blocks(const uint64_t* xs, size_t n);
+
+/// @returns The name of the instruction set the kernels use on this machine.
+const char* block_kernels_isa();
+
+} // namespace vast::detail
+
+#endif
@@ -218,6 +218,16 @@ public:
     return find(x) == end() ? 0 : 1;
   }
 
+  /// Looks up an entry without affecting the eviction order.
+  /// @param x The key to lookup.
+  /// @returns An iterator to the entry for *x* or `end()`.
+  const_iterator peek(const key_type& x) const {
+    auto i = tracker_.find(x);
+    if (i == tracker_.end())
+      return xs_.end();
+    return i->second;
+  }
+
   // -- concepts ------------------------------------------------------------
 
   template <class Inspector>
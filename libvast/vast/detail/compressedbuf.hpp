@@ -38,6 +38,9 @@ namespace vast::detail {
 ///     +-------------------+-----------------+--------------------...---+
 ///
 /// Both sizes are written in *variable byte* encoding to save space.
+///
+/// In reading mode, the streambuffer supports seeking to the beginning of a
+/// block, with the position referring to the underlying streambuffer.
 class compressedbuf : public std::streambuf {
 public:
   /// The default buffer size in bytes.
@@ -55,6 +58,12 @@ public:
 protected:
   // -- buffer management and positioning ------------------------------------
 
+  /// Repositions the underlying streambuffer and discards the get area.
+  /// @param pos The position of a block in the underlying streambuffer.
+  /// @param which Must be `std::ios_base::in`.
+  /// @returns The new position or -1 on failure.
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
   /// If a put area exists, calls `overflow()` to write all pending output to
   /// the underlying streambuffer, then clears its internal buffers.
   /// @returns -1 on failure or the number of characters written to the
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_DETAIL_PATTERN_MATCHER_HPP
+#define VAST_DETAIL_PATTERN_MATCHER_HPP
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vast::detail {
+
+/// A precompiled regular expression. Expressions that consist only of
+/// literal characters, `.`, `.*`, and the anchors `^` and `$`, such as those
+/// resulting from literals, prefixes, suffixes, and globs, bypass the regex
+/// engine. Literals compare directly, prefixes and suffixes compare at the
+/// respective end, substrings use a string search, and the remaining
+/// wildcard expressions use a greedy wildcard matcher. All other expressions
+/// go through a `std::regex` that gets compiled exactly once.
+class pattern_matcher {
+public:
+  /// Compiles a regular expression.
+  /// @param rx The regular expression in ECMAScript syntax.
+  /// @throws std::regex_error if *rx* is not a valid regular expression.
+  explicit pattern_matcher(const std::string& rx);
+
+  /// Matches a string against the expression.
+  /// @param str The string to match.
+  /// @returns `true` if the expression matches exactly *str*.
+  bool match(std::string_view str) const;
+
+  /// Searches the expression in a string.
+  /// @param str The string to search.
+  /// @returns `true` if the expression matches inside *str*.
+  bool search(std::string_view str) const;
+
+  /// @returns `true` if the expression bypasses the regex engine.
+  bool simple() const;
+
+private:
+  // A simple expression that is ready for evaluation.
+  struct program {
+    enum kind { exact, prefix, suffix, substring, wildcard };
+    kind op;
+    std::string literal;
+    std::vector<int> tokens; // Characters and negative wildcard codes.
+  };
+
+  static program make_program(std::vector<int> tokens);
+
+  static bool eval(const program& p, std::string_view str);
+
+  // Checks whether the fast path applies to a string.
+  bool bypass(std::string_view str) const;
+
+  std::regex regex_;
+  bool simple_ = false;
+  bool restricted_ = false;
+  program match_;
+  program search_;
+};
+
+/// Necessary conditions for a string to match a regular expression, derived
+/// from the literal parts of the expression. Indexes use them to narrow down
+/// the candidates of a pattern lookup.
+struct pattern_constraints {
+  /// A literal that every matching string begins with.
+  std::string prefix;
+
+  /// Literals that every matching string contains.
+  std::vector<std::string> substrings;
+
+  /// If set, a string matches iff it equals this literal.
+  std::optional<std::string> literal;
+};
+
+/// Derives the constraints of a regular expression. The derivation is
+/// conservative: parts of the expression that it does not understand, such
+/// as alternatives, yield no constraints. It never fails, not even for
+/// malformed expressions.
+/// @param rx The regular expression in ECMAScript syntax.
+/// @param full Whether the expression must match the entire string, as
+///             opposed to any substring.
+/// @returns The constraints for a string to match *rx*.
+pattern_constraints derive_constraints(const std::string& rx, bool full);
+
+} // namespace vast::detail
+
+#endif
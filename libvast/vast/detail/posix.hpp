@@ -135,6 +135,11 @@ bool write(int fd, const void* buffer, size_t bytes, size_t* put = nullptr);
 /// @returns `true` on successful seek.
 bool seek(int fd, size_t bytes);
 
+/// Wraps `fsync(2)`.
+/// @param fd The file descriptor to synchronize with its storage device.
+/// @returns `true` on success.
+bool fsync(int fd);
+
 } // namespace vast::detail
 
 #endif
@@ -0,0 +1,109 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_DETAIL_WORK_STEALING_POOL_HPP
+#define VAST_DETAIL_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vast::detail {
+
+/// A fixed-size thread pool where each worker owns a task queue. A worker
+/// takes tasks from the back of its own queue and, once that runs dry,
+/// steals tasks from the front of the other queues. Workers without tasks
+/// sleep on their own queue, and a submission wakes only a single worker.
+class work_stealing_pool {
+public:
+  using task = std::function<void()>;
+
+  /// Executes tasks one after another in the order of submission, but on
+  /// the threads of a pool. A strand protects a resource that tasks must not
+  /// access concurrently.
+  class strand : public std::enable_shared_from_this<strand> {
+  public:
+    /// Constructs a strand.
+    /// @param pool The pool to run the tasks on.
+    /// @pre *pool* outlives all tasks of the strand.
+    explicit strand(work_stealing_pool& pool);
+
+    /// Submits a task that runs after all previously submitted ones.
+    /// @param f The task to execute.
+    void submit(task f);
+
+  private:
+    void run();
+
+    work_stealing_pool& pool_;
+    std::mutex mutex_;
+    std::deque<task> tasks_;
+    bool running_ = false;
+  };
+
+  /// Spawns the worker threads.
+  /// @param workers The number of threads; 0 means one per hardware thread.
+  explicit work_stealing_pool(size_t workers = 0);
+
+  work_stealing_pool(const work_stealing_pool&) = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  /// Executes all remaining tasks and joins the worker threads.
+  ~work_stealing_pool();
+
+  /// Submits a task. When called from a worker of this pool, the task goes
+  /// into the queue of the calling worker, and otherwise into the queues in
+  /// round-robin fashion.
+  /// @param f The task to execute.
+  void submit(task f);
+
+  /// Creates a strand on this pool.
+  std::shared_ptr<strand> make_strand();
+
+  /// @returns The number of worker threads.
+  size_t workers() const;
+
+private:
+  struct task_queue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<task> tasks;
+    bool sleeping = false;
+  };
+
+  // Takes a task from the own queue or steals one from another queue.
+  bool try_pop(size_t worker, task& f);
+
+  // Wakes the owner of a queue if it sleeps, and otherwise another sleeping
+  // worker that can steal the task.
+  void wake(size_t worker);
+
+  void work(size_t worker);
+
+  std::vector<std::unique_ptr<task_queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> pending_{0};
+  std::atomic<size_t> next_{0};
+  std::atomic<bool> done_{false};
+};
+
+} // namespace vast::detail
+
+#endif
@@ -14,10 +14,17 @@
 #ifndef VAST_EWAH_BITMAP_HPP
 #define VAST_EWAH_BITMAP_HPP
 
+#include <type_traits>
+
+#include <caf/meta/load_callback.hpp>
+
 #include "vast/bitmap_base.hpp"
 #include "vast/bitvector.hpp"
+#include "vast/chunk.hpp"
+#include "vast/error.hpp"
 #include "vast/word.hpp"
 
+#include "vast/detail/block_arena.hpp"
 #include "vast/detail/operators.hpp"
 
 namespace vast {
@@ -87,11 +94,15 @@ struct ewah_word : word<Block> {
 /// 1. The first block is a marker.
 /// 2. The last block is always dirty.
 ///
+/// When deserialized with a ::block_arena, the blocks of a bitmap may reside
+/// in a memory-mapped chunk rather than on the heap. Such a bitmap copies its
+/// blocks on the first modification.
 class ewah_bitmap : public bitmap_base<ewah_bitmap>,
                     detail::equality_comparable<ewah_bitmap> {
 public:
   using word_type = ewah_word<block_type>;
   using block_vector = std::vector<block_type>;
+  using block_view = detail::block_view;
 
   ewah_bitmap() = default;
 
@@ -103,7 +114,14 @@ public:
 
   size_type size() const;
 
-  const block_vector& blocks() const;
+  /// @returns An estimate of the number of bytes the bitmap occupies in
+  ///          memory. Blocks in a memory-mapped chunk do not count.
+  size_t memusage() const;
+
+  block_view blocks() const;
+
+  /// @returns `true` if the blocks reside in a memory-mapped chunk.
+  bool mapped() const;
 
   // -- modifiers ------------------------------------------------------------
 
@@ -120,11 +138,53 @@ public:
   friend bool operator==(const ewah_bitmap& x, const ewah_bitmap& y);
 
   template <class Inspector>
-  friend auto inspect(Inspector&f, ewah_bitmap& bm) {
-    return f(bm.blocks_, bm.last_marker_, bm.num_bits_);
+  friend auto inspect(Inspector& f, ewah_bitmap& bm) {
+    if constexpr (std::is_polymorphic_v<Inspector>) {
+      // Arenas store the blocks out of line, so that loading merely points
+      // into the arena instead of copying.
+      if (auto arena = dynamic_cast<detail::block_arena*>(&f)) {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        if constexpr (Inspector::reads_state) {
+          size = bm.blocks().size();
+          offset = arena->append(bm.blocks());
+        }
+        auto load = [&]() -> error {
+          bm.blocks_.clear();
+          bm.chunk_ = nullptr;
+          bm.mapped_ = {};
+          if (size == 0)
+            return {};
+          auto blocks = arena->get(offset, size);
+          if (!blocks)
+            return make_error(ec::format_error, "bitmap exceeds block arena");
+          bm.chunk_ = arena->chunk();
+          bm.mapped_ = block_view{blocks, size};
+          return {};
+        };
+        return f(offset, size, bm.last_marker_, bm.num_bits_,
+                 caf::meta::load_callback(load));
+      }
+    }
+    if constexpr (Inspector::reads_state) {
+      if (bm.mapped()) {
+        auto blocks = block_vector(bm.mapped_.begin(), bm.mapped_.end());
+        return f(blocks, bm.last_marker_, bm.num_bits_);
+      }
+    }
+    auto load = [&]() -> error {
+      bm.chunk_ = nullptr;
+      bm.mapped_ = {};
+      return {};
+    };
+    return f(bm.blocks_, bm.last_marker_, bm.num_bits_,
+             caf::meta::load_callback(load));
   }
 
 private:
+  /// Copies the blocks out of a memory-mapped chunk prior to modifications.
+  void unmap();
+
   /// Incorporates the most recent (complete) dirty block.
   /// @pre `num_bits_ % word_type::width == 0`
   void integrate_last_block();
@@ -135,6 +195,8 @@ private:
   void bump_dirty_count();
 
   block_vector blocks_;
+  chunk_ptr chunk_;
+  block_view mapped_;
   block_type last_marker_ = 0;
   size_type num_bits_ = 0;
 };
@@ -161,6 +223,49 @@ private:
 
 ewah_bitmap_range bit_range(const ewah_bitmap& bm);
 
+// -- algorithms -------------------------------------------------------------
+//
+// The following overloads take precedence over the generic algorithms when
+// both operands have the same size. Rather than going block by block, they
+// combine entire clean runs from the markers and hand runs of dirty blocks
+// to vectorized kernels.
+
+ewah_bitmap binary_and(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+ewah_bitmap binary_or(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+ewah_bitmap binary_xor(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+ewah_bitmap binary_nand(const ewah_bitmap& lhs, const ewah_bitmap& rhs);
+
+/// Computes the bitwise OR of several EWAH bitmaps. Instead of materializing
+/// intermediate results, it ORs the runs of every input into a single
+/// uncompressed buffer and compresses that buffer once at the end. The buffer
+/// only spans the blocks that contain 1s, and inputs that consist mostly of
+/// runs fall back to pairwise evaluation.
+/// @param xs The bitmaps to combine.
+/// @returns The bitwise OR of all bitmaps in *xs*.
+/// @pre All bitmaps in *xs* have the same size.
+ewah_bitmap nary_or(const std::vector<const ewah_bitmap*>& xs);
+
+namespace detail {
+
+/// Counts the 1-bits of an EWAH bitmap.
+ewah_bitmap::size_type count_ones(const ewah_bitmap& bm);
+
+} // namespace detail
+
+/// Computes the *rank* of an EWAH bitmap from the clean runs of its markers
+/// and a bulk population count of its dirty blocks.
+/// @tparam Bit The bit value to count.
+/// @param bm The bitmap whose rank to compute.
+/// @returns The population count of *bm*.
+template <bool Bit = true>
+ewah_bitmap::size_type rank(const ewah_bitmap& bm) {
+  auto ones = detail::count_ones(bm);
+  return Bit ? ones : bm.size() - ones;
+}
+
 } // namespace vast
 
 #endif
@@ -211,6 +211,7 @@ struct matcher {
   }
 
   const type& type_;
+  relational_operator op_ = equal;
 };
 
 } // namespace vast
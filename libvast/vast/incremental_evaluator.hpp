@@ -0,0 +1,94 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_INCREMENTAL_EVALUATOR_HPP
+#define VAST_INCREMENTAL_EVALUATOR_HPP
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "vast/expression.hpp"
+#include "vast/ids.hpp"
+
+namespace vast {
+
+/// Evaluates an expression over the hits of its predicates as they arrive
+/// one by one. The evaluator compiles the expression into a DAG where equal
+/// subexpressions share a node. When the hits of a predicate arrive, only
+/// the nodes on the paths from the predicate to the root get re-evaluated:
+/// a disjunction merges the new hits of the changed operand, while
+/// conjunctions and negations evaluate exactly once, when all their operands
+/// are complete. Predicates without hits count as empty.
+class incremental_evaluator {
+public:
+  /// Constructs an evaluator for the empty expression.
+  incremental_evaluator();
+
+  /// Compiles an expression.
+  /// @param expr The expression to evaluate.
+  explicit incremental_evaluator(const expression& expr);
+
+  /// Supplies the hits of a predicate and re-evaluates the expression.
+  /// @param pred The predicate.
+  /// @param hits The hits of *pred*.
+  /// @returns The hits of the expression that *hits* added.
+  /// @pre Each predicate has hits only once.
+  ids add(const predicate& pred, ids hits);
+
+  /// @returns The hits of the expression so far.
+  const ids& hits() const;
+
+  /// @returns The number of predicates with hits.
+  size_t completed() const;
+
+  /// @returns The number of distinct predicates in the expression.
+  size_t predicates() const;
+
+  /// @returns `true` iff all predicates have hits.
+  bool done() const;
+
+private:
+  enum class kind { predicate, conjunction, disjunction, negation };
+
+  struct node {
+    kind k;
+    std::vector<size_t> operands;
+    std::vector<size_t> parents;
+    /// The number of operands that are yet to complete.
+    size_t pending = 0;
+    bool complete = false;
+    ids hits;
+  };
+
+  size_t compile(const expression& expr);
+
+  size_t make_node(const expression& expr, kind k,
+                   std::vector<size_t> operands);
+
+  // Updates a parent after one of its operands changed or completed.
+  void update(size_t parent, size_t operand, bool completed);
+
+  std::vector<node> nodes_;
+  std::unordered_map<expression, size_t> index_;
+  std::unordered_map<predicate, size_t> predicates_;
+  size_t root_ = 0;
+  size_t completed_ = 0;
+  bool dirty_ = false;
+  ids hits_;
+};
+
+} // namespace vast
+
+#endif
@@ -0,0 +1,88 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#ifndef VAST_JOURNAL_HPP
+#define VAST_JOURNAL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "vast/expected.hpp"
+#include "vast/filesystem.hpp"
+
+namespace vast {
+
+/// An append-only log of checksummed records on top of a snapshot. Owners of
+/// persistent meta data append one record per modification, which costs
+/// time proportional to the modification instead of the entire state, and
+/// periodically compact the log into a new snapshot of their state.
+///
+/// Each record and the snapshot consist of the payload size (4 bytes) and
+/// the CRC32 of the payload (4 bytes), both in network byte order, followed
+/// by the payload. Appends and compactions reach stable storage before they
+/// return. A crash during an append leaves a torn record at the end
+/// of the log, which the next replay discards. A crash during compaction may
+/// leave records behind that the new snapshot already covers, hence applying
+/// a record must be idempotent.
+class journal {
+public:
+  /// A function that applies a snapshot or record to the owner's state.
+  using handler = std::function<expected<void>(const std::vector<char>&)>;
+
+  journal() = default;
+
+  /// Constructs a journal.
+  /// @param dir The directory holding snapshot and log.
+  explicit journal(path dir);
+
+  /// Restores the owner's state from snapshot and log. Replay stops at the
+  /// first torn or corrupted record, which the journal discards along with
+  /// all subsequent ones.
+  /// @param snapshot The function that applies the snapshot, if one exists.
+  /// @param record The function that applies a single record.
+  /// @returns No error on success.
+  expected<void> replay(handler snapshot, handler record);
+
+  /// Appends a record to the log.
+  /// @param x The serialized record.
+  /// @returns No error on success.
+  expected<void> append(const std::vector<char>& x);
+
+  /// Replaces the snapshot and empties the log.
+  /// @param x The serialized state of the owner.
+  /// @returns No error on success.
+  expected<void> compact(const std::vector<char>& x);
+
+  /// Checks whether the log has outgrown the snapshot. Compacting only then
+  /// bounds the journal at roughly twice the size of the owner's state and
+  /// keeps the amortized cost per record constant.
+  /// @returns `true` if the log holds more bytes than the snapshot.
+  bool needs_compaction() const;
+
+  /// @returns The number of records in the log.
+  size_t records() const;
+
+  /// @returns The directory of the journal.
+  const path& dir() const;
+
+private:
+  path dir_;
+  size_t records_ = 0;
+  size_t log_bytes_ = 0;
+  size_t snapshot_bytes_ = 0;
+};
+
+} // namespace vast
+
+#endif
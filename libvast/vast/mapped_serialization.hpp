@@ -0,0 +1,147 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_MAPPED_SERIALIZATION_HPP
+#define VAST_MAPPED_SERIALIZATION_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <caf/stream_deserializer.hpp>
+#include <caf/stream_serializer.hpp>
+#include <caf/streambuf.hpp>
+
+#include "vast/chunk.hpp"
+#include "vast/error.hpp"
+#include "vast/expected.hpp"
+#include "vast/filesystem.hpp"
+
+#include "vast/detail/block_arena.hpp"
+#include "vast/detail/variadic_serialization.hpp"
+
+namespace vast {
+namespace detail {
+
+/// A serializer that moves bitmap blocks into a ::block_arena.
+class arena_serializer : public caf::stream_serializer<caf::vectorbuf&>,
+                         public block_arena {
+public:
+  explicit arena_serializer(caf::vectorbuf& sb)
+    : caf::stream_serializer<caf::vectorbuf&>{sb} {
+    // nop
+  }
+};
+
+/// A deserializer that lets bitmaps reference their blocks in a
+/// ::block_arena.
+class arena_deserializer : public caf::stream_deserializer<caf::charbuf&>,
+                           public block_arena {
+public:
+  arena_deserializer(caf::charbuf& sb, block_arena arena)
+    : caf::stream_deserializer<caf::charbuf&>{sb},
+      block_arena{std::move(arena)} {
+    // nop
+  }
+};
+
+/// The parsed layout of a mapped file.
+struct mapped_file {
+  chunk_ptr chunk;
+  const char* state;
+  size_t state_size;
+  block_arena arena;
+};
+
+/// Writes a mapped file.
+/// @param filename The file to write.
+/// @param state The serialized state.
+/// @param blocks The blocks of the arena.
+expected<void> write_mapped_file(const path& filename,
+                                 const std::vector<char>& state,
+                                 block_view blocks);
+
+/// Memory-maps a mapped file and parses its layout.
+/// @param filename The file to read.
+expected<mapped_file> read_mapped_file(const path& filename);
+
+} // namespace detail
+
+/// The on-disk layout of mapped files, in which bitmap blocks reside in a
+/// separate, aligned array. Bitmaps loaded from such a file reference the
+/// array in the memory-mapped file instead of copying it onto the heap. All
+/// processes that load the same file thus share its pages through the page
+/// cache, and loading costs little more than deserializing the remaining
+/// state.
+///
+///     header: magic (4 bytes), version (4 bytes), state size (8 bytes),
+///             arena offset (8 bytes), arena size in blocks (8 bytes)
+///     state:  the CAF-serialized objects, with bitmaps referencing
+///             blocks via offset and length
+///     arena:  the blocks, as little-endian 64-bit words aligned at an
+///             8-byte boundary
+///
+/// The header uses network byte order.
+struct mapped_file_format {
+  using magic_type = uint32_t;
+  using version_type = uint32_t;
+  static inline constexpr magic_type magic = 0x564d4150;
+  static inline constexpr version_type version = 1;
+  static inline constexpr size_t header_size = 4 + 4 + 8 + 8 + 8;
+};
+
+/// Serializes a sequence of objects into a mapped file. The function first
+/// writes a temporary file and then renames it, so that existing mappings of
+/// the file remain intact.
+/// @param filename The file to write.
+/// @param xs The objects to serialize.
+/// @see load_mapped
+template <class... Ts>
+expected<void> save_mapped(const path& filename, Ts&&... xs) {
+  static_assert(sizeof...(Ts) > 0);
+  std::vector<char> state;
+  try {
+    caf::vectorbuf sb{state};
+    detail::arena_serializer s{sb};
+    detail::write(s, std::forward<Ts>(xs)...);
+    return detail::write_mapped_file(filename, state, s.blocks());
+  } catch (const std::exception& e) {
+    return make_error(ec::unspecified, e.what());
+  }
+}
+
+/// Deserializes a sequence of objects from a mapped file. Bitmaps in the
+/// objects keep the file mapped for as long as they reference its blocks.
+/// @param filename The file to read.
+/// @param xs The objects to deserialize.
+/// @see save_mapped
+template <class... Ts>
+expected<void> load_mapped(const path& filename, Ts&... xs) {
+  static_assert(sizeof...(Ts) > 0);
+  auto file = detail::read_mapped_file(filename);
+  if (!file)
+    return file.error();
+  try {
+    caf::charbuf sb{const_cast<char*>(file->state), file->state_size};
+    detail::arena_deserializer s{sb, std::move(file->arena)};
+    detail::read(s, xs...);
+  } catch (const std::exception& e) {
+    return make_error(ec::unspecified, e.what());
+  }
+  return {};
+}
+
+} // namespace vast
+
+#endif
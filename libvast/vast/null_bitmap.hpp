@@ -42,6 +42,10 @@ public:
 
   size_type size() const;
 
+  /// @returns An estimate of the number of bytes the bitmap occupies in
+  ///          memory.
+  size_t memusage() const;
+
   // -- modifiers ------------------------------------------------------------
 
   void append_bit(bool bit);
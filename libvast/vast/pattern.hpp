@@ -14,8 +14,12 @@
 #ifndef VAST_PATTERN_HPP
 #define VAST_PATTERN_HPP
 
+#include <memory>
 #include <string>
 
+#include <caf/error.hpp>
+#include <caf/meta/load_callback.hpp>
+
 #include "vast/detail/operators.hpp"
 
 namespace vast {
@@ -23,7 +27,14 @@ namespace vast {
 struct access;
 class json;
 
-/// A regular expression.
+namespace detail {
+
+class pattern_matcher;
+
+} // namespace detail
+
+/// A regular expression. A pattern compiles its expression on the first
+/// match or search and shares the compiled matcher with all its copies.
 class pattern : detail::totally_ordered<pattern> {
   friend access;
 
@@ -46,6 +57,14 @@ public:
   /// @param str The string containing the pattern.
   explicit pattern(std::string str);
 
+  pattern(const pattern& other);
+
+  pattern(pattern&&) = default;
+
+  pattern& operator=(const pattern& other);
+
+  pattern& operator=(pattern&&) = default;
+
   /// Matches a string against the pattern.
   /// @param str The string to match.
   /// @returns `true` if the pattern matches exactly *str*.
@@ -63,13 +82,21 @@ public:
 
   template <class Inspector>
   friend auto inspect(Inspector& f, pattern& p) {
-    return f(p.str_);
+    auto load = [&]() -> caf::error {
+      p.matcher_ = nullptr;
+      return {};
+    };
+    return f(p.str_, caf::meta::load_callback(load));
   }
 
   friend bool convert(const pattern& p, json& j);
 
 private:
+  /// @returns The compiled matcher, compiling it on first use.
+  std::shared_ptr<const detail::pattern_matcher> matcher() const;
+
   std::string str_;
+  mutable std::shared_ptr<const detail::pattern_matcher> matcher_;
 };
 
 } // namespace vast
@@ -0,0 +1,202 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#ifndef VAST_RANK_SELECT_DIRECTORY_HPP
+#define VAST_RANK_SELECT_DIRECTORY_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "vast/bits.hpp"
+#include "vast/detail/assert.hpp"
+#include "vast/ewah_bitmap.hpp"
+
+namespace vast {
+
+/// An acceleration structure for *rank* and *select* queries on an EWAH
+/// bitmap that no longer changes. Construction walks the blocks of the bitmap
+/// once and samples the block index, position, and rank at the first block
+/// and then at a marker every ::sample_rate blocks. Queries binary search the
+/// samples and scan roughly ::sample_rate blocks of the bitmap itself, rather
+/// than all of them. The samples take less than 5% of the space of the
+/// bitmap. The population
+/// counts and the last occurrences take constant time.
+/// @note The directory does not track modifications of the bitmap it was
+///       built from. Owners must rebuild it whenever they change the bitmap,
+///       and pass that very bitmap to each query.
+class rank_select_directory {
+public:
+  using block_type = ewah_bitmap::block_type;
+  using size_type = ewah_bitmap::size_type;
+  using word_type = ewah_bitmap::word_type;
+
+  /// The minimum number of blocks between two samples.
+  static constexpr size_t sample_rate = 64;
+
+  /// Constructs an empty directory.
+  rank_select_directory() = default;
+
+  /// Constructs a directory for a given bitmap.
+  /// @param bm The bitmap to construct a directory for.
+  explicit rank_select_directory(const ewah_bitmap& bm);
+
+  // -- inspectors -----------------------------------------------------------
+
+  /// @returns The number of bits of the underlying bitmap.
+  size_type size() const;
+
+  /// @returns An estimate of the number of bytes the directory occupies in
+  ///          memory.
+  size_t memusage() const;
+
+  // -- queries --------------------------------------------------------------
+
+  /// Computes the number of occurrences of a bit value in the bitmap.
+  /// @tparam Bit The bit value to count.
+  /// @returns The population count of the bitmap.
+  template <bool Bit = true>
+  size_type rank() const {
+    return Bit ? ones_ : size_ - ones_;
+  }
+
+  /// Computes the number of occurrences of a bit value in *B[0,i]*.
+  /// @tparam Bit The bit value to count.
+  /// @param bm The bitmap of the directory.
+  /// @param i The offset where to end counting.
+  /// @returns The population count of the bitmap up to and including
+  ///          position *i*.
+  /// @pre `i < size()`
+  template <bool Bit = true>
+  size_type rank(const ewah_bitmap& bm, size_type i) const {
+    VAST_ASSERT(bm.size() == size_);
+    VAST_ASSERT(i < size_);
+    // Find the last sample at or before position i.
+    auto s = std::upper_bound(samples_.begin(), samples_.end(), i,
+                              [](auto x, auto& y) { return x < y.position; });
+    VAST_ASSERT(s != samples_.begin());
+    --s;
+    auto result = size_type{0};
+    scan(bm, *s, [&](auto& cursor, auto& b) {
+      if (i >= cursor.position + b.size())
+        return false;
+      result = count<Bit>(cursor) + vast::rank<Bit>(b, i - cursor.position);
+      return true;
+    });
+    return result;
+  }
+
+  /// Computes the position of the *i*-th occurrence of a bit.
+  /// @tparam Bit the bit value to locate.
+  /// @param bm The bitmap of the directory.
+  /// @param i The position of the *i*-th occurrence of *Bit* in the bitmap.
+  ///          If `i == -1`, then select the last occurrence of *Bit*.
+  /// @returns The position of the *i*-th occurrence of *Bit* or `npos` if the
+  ///          bitmap has less than *i* occurrences of *Bit*.
+  /// @pre `i > 0`
+  template <bool Bit = true>
+  size_type select(const ewah_bitmap& bm, size_type i) const {
+    VAST_ASSERT(bm.size() == size_);
+    VAST_ASSERT(i > 0);
+    if (i == word_type::npos)
+      return last_[Bit];
+    if (i > rank<Bit>())
+      return word_type::npos;
+    // Find the last sample with fewer than i occurrences before it.
+    auto s = std::partition_point(samples_.begin(), samples_.end(),
+                                  [&](auto& x) { return count<Bit>(x) < i; });
+    VAST_ASSERT(s != samples_.begin());
+    --s;
+    auto result = word_type::npos;
+    scan(bm, *s, [&](auto& cursor, auto& b) {
+      auto n = count<Bit>(cursor);
+      if (n + vast::rank<Bit>(b) < i)
+        return false;
+      result = cursor.position + vast::select<Bit>(b, i - n);
+      return true;
+    });
+    return result;
+  }
+
+private:
+  /// A location in the bitmap.
+  struct sample {
+    size_type block;    ///< The index of the block.
+    size_type position; ///< The number of bits before the block.
+    size_type ones;     ///< The number of 1-bits before the block.
+  };
+
+  template <bool Bit>
+  static size_type count(const sample& x) {
+    return Bit ? x.ones : x.position - x.ones;
+  }
+
+  /// Walks the bit sequences of a bitmap, beginning at a marker. Stops once
+  /// *f* returns `true` for a sequence.
+  /// @param bm The bitmap to walk.
+  /// @param from The location of a marker in *bm*.
+  /// @param f The function to invoke with the location and bits of each
+  ///          sequence, where the location refers to the block in which the
+  ///          sequence begins.
+  /// @param on_marker The function to invoke with the location of each
+  ///                  marker.
+  template <class F, class G = void (*)(const sample&)>
+  void scan(const ewah_bitmap& bm, sample from, F f,
+            G on_marker = [](const sample&) {}) const {
+    auto blocks = bm.blocks();
+    auto partial = size_ % word_type::width;
+    auto last = [&](size_type i) {
+      return i + 1 == blocks.size() && partial > 0 ? partial
+                                                   : word_type::width;
+    };
+    auto cursor = from;
+    auto next = [&](bits<block_type> b) {
+      if (f(cursor, b))
+        return true;
+      ++cursor.block;
+      cursor.position += b.size();
+      cursor.ones += vast::rank<1>(b);
+      return false;
+    };
+    while (cursor.block < blocks.size()) {
+      // The last block is always dirty, even if no marker accounts for it.
+      if (cursor.block + 1 == blocks.size()) {
+        next({blocks[cursor.block], last(cursor.block)});
+        return;
+      }
+      on_marker(cursor);
+      auto marker = blocks[cursor.block];
+      auto clean = word_type::marker_num_clean(marker);
+      auto dirty = word_type::marker_num_dirty(marker);
+      if (clean > 0) {
+        auto data = word_type::marker_type(marker) ? word_type::all
+                                                   : word_type::none;
+        if (next({data, clean * word_type::width}))
+          return;
+      } else {
+        ++cursor.block;
+      }
+      for (auto i = 0u; i < dirty; ++i)
+        if (next({blocks[cursor.block], last(cursor.block)}))
+          return;
+    }
+  }
+
+  std::vector<sample> samples_;
+  size_type size_ = 0;
+  size_type ones_ = 0;
+  size_type last_[2] = {word_type::npos, word_type::npos};
+};
+
+} // namespace vast
+
+#endif
@@ -0,0 +1,222 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_ROARING_BITMAP_HPP
+#define VAST_ROARING_BITMAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "vast/bitmap_base.hpp"
+#include "vast/detail/operators.hpp"
+
+namespace vast {
+
+class roaring_bitmap_range;
+
+/// A bitmap in the spirit of *Roaring* by Chambi et al. It partitions the
+/// bit positions into chunks of 2^16 bits and only stores the chunks that
+/// contain at least one 1-bit. Each chunk picks the smallest of three
+/// containers: a sorted array of the positions of its 1-bits, an uncompressed
+/// bitset, or a sorted list of runs of 1-bits. Unlike the run-length encoded
+/// bitmaps, this representation supports membership tests in logarithmic time
+/// and intersects chunks of medium density without decoding long sequences of
+/// literal words.
+///
+/// Appending only ever modifies the last chunk, which may use a suboptimal
+/// container until appending moves past its end.
+class roaring_bitmap : public bitmap_base<roaring_bitmap>,
+                       detail::equality_comparable<roaring_bitmap> {
+  friend roaring_bitmap_range;
+
+public:
+  /// The number of bits in a chunk.
+  static constexpr size_type chunk_size = size_type{1} << 16;
+
+  /// The number of blocks of a bitset container.
+  static constexpr size_t bitset_blocks = chunk_size / word_type::width;
+
+  /// The maximum number of entries of an array container. Beyond this point,
+  /// a bitset container takes up less space.
+  static constexpr size_t max_array_size = 4096;
+
+  /// The representation of a chunk.
+  enum class container : uint8_t {
+    /// The sorted offsets of all 1-bits.
+    array,
+    /// One bit per position.
+    bitset,
+    /// Pairs of the first offset and the length minus one of each run.
+    run
+  };
+
+  /// A non-empty chunk of 2^16 bits.
+  struct chunk {
+    /// The position of the chunk, i.e., its first bit divided by the chunk
+    /// size.
+    size_type key;
+
+    /// The container type.
+    container type;
+
+    /// The entries of array and run containers.
+    std::vector<uint16_t> values;
+
+    /// The blocks of bitset containers.
+    std::vector<block_type> blocks;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, chunk& x) {
+      return f(x.key, x.type, x.values, x.blocks);
+    }
+  };
+
+  using chunk_vector = std::vector<chunk>;
+
+  roaring_bitmap() = default;
+
+  roaring_bitmap(size_type n, bool bit = false);
+
+  // -- inspectors -----------------------------------------------------------
+
+  bool empty() const;
+
+  size_type size() const;
+
+  /// @returns An estimate of the number of bytes the bitmap occupies in
+  ///          memory.
+  size_t memusage() const;
+
+  const chunk_vector& chunks() const;
+
+  // -- element access -------------------------------------------------------
+
+  /// Accesses the *i*-th bit with a binary search over the chunks and within
+  /// the container.
+  /// @param i The index into the bitmap.
+  /// @returns `true` iff bit *i* is 1.
+  /// @pre `i < size()`
+  bool operator[](size_type i) const;
+
+  // -- modifiers ------------------------------------------------------------
+
+  void append_bit(bool bit);
+
+  void append_bits(bool bit, size_type n);
+
+  void append_block(block_type bits, size_type n = word_type::width);
+
+  void flip();
+
+  // -- concepts -------------------------------------------------------------
+
+  friend bool operator==(const roaring_bitmap& x, const roaring_bitmap& y);
+
+  template <class Inspector>
+  friend auto inspect(Inspector&f, roaring_bitmap& bm) {
+    return f(bm.chunks_, bm.num_bits_);
+  }
+
+  // -- algorithms -----------------------------------------------------------
+
+  friend roaring_bitmap binary_and(const roaring_bitmap& lhs,
+                                   const roaring_bitmap& rhs);
+
+  friend roaring_bitmap binary_or(const roaring_bitmap& lhs,
+                                  const roaring_bitmap& rhs);
+
+  friend roaring_bitmap binary_xor(const roaring_bitmap& lhs,
+                                   const roaring_bitmap& rhs);
+
+  friend roaring_bitmap binary_nand(const roaring_bitmap& lhs,
+                                    const roaring_bitmap& rhs);
+
+private:
+  /// Sets *n* consecutive bits to 1, beginning at position *i*.
+  /// @pre `i >= size()` and all *n* bits reside in the same chunk.
+  void set_ones(size_type i, size_type n);
+
+  /// Chooses the smallest container for the last chunk once appending has
+  /// moved past its end.
+  /// @param old_size The bitmap size before the last append operation.
+  void seal(size_type old_size);
+
+  chunk_vector chunks_;
+  size_type num_bits_ = 0;
+};
+
+class roaring_bitmap_range
+  : public bit_range_base<roaring_bitmap_range, roaring_bitmap::block_type> {
+public:
+  using word_type = roaring_bitmap::word_type;
+
+  roaring_bitmap_range() = default;
+
+  explicit roaring_bitmap_range(const roaring_bitmap& bm);
+
+  void next();
+  bool done() const;
+
+private:
+  void scan();
+
+  /// Retrieves the block beginning at a given position.
+  /// @param i The position, which must be a multiple of the word width.
+  roaring_bitmap::block_type block_at(roaring_bitmap::size_type i);
+
+  const roaring_bitmap* bm_ = nullptr;
+  roaring_bitmap::size_type position_ = 0;
+  size_t chunk_ = 0;
+  size_t decoded_ = -1;
+  std::vector<roaring_bitmap::block_type> buffer_;
+};
+
+roaring_bitmap_range bit_range(const roaring_bitmap& bm);
+
+// -- algorithms -------------------------------------------------------------
+//
+// The following overloads take precedence over the generic algorithms when
+// both operands have the same size. They combine the bitmaps chunk by chunk
+// and skip chunks that cannot contribute to the result.
+
+roaring_bitmap binary_and(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+roaring_bitmap binary_or(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+roaring_bitmap binary_xor(const roaring_bitmap& lhs, const roaring_bitmap& rhs);
+
+roaring_bitmap binary_nand(const roaring_bitmap& lhs,
+                           const roaring_bitmap& rhs);
+
+namespace detail {
+
+/// Counts the 1-bits of a Roaring bitmap.
+roaring_bitmap::size_type count_ones(const roaring_bitmap& bm);
+
+} // namespace detail
+
+/// Computes the *rank* of a Roaring bitmap from the cardinalities of its
+/// chunks.
+/// @tparam Bit The bit value to count.
+/// @param bm The bitmap whose rank to compute.
+/// @returns The population count of *bm*.
+template <bool Bit = true>
+roaring_bitmap::size_type rank(const roaring_bitmap& bm) {
+  auto ones = detail::count_ones(bm);
+  return Bit ? ones : bm.size() - ones;
+}
+
+} // namespace vast
+
+#endif
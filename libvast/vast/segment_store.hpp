@@ -14,10 +14,15 @@
 #ifndef VAST_SEGMENT_STORE_HPP
 #define VAST_SEGMENT_STORE_HPP
 
-#include <map>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "vast/batch.hpp"
+#include "vast/chunk.hpp"
 #include "vast/filesystem.hpp"
+#include "vast/journal.hpp"
 #include "vast/store.hpp"
 #include "vast/uuid.hpp"
 
@@ -29,30 +34,69 @@ namespace vast {
 /// A store that keeps its data in terms of segments.
 class segment_store : public store {
 public:
+  /// A sequence of batches. A segment either resides in memory, or it
+  /// consists of a memory-mapped file from which it deserializes only the
+  /// batches that a lookup touches.
+  ///
+  /// The file format of a segment looks as follows, with all integers in
+  /// network byte order:
+  ///
+  ///     header:     magic (4 bytes), version (4 bytes), UUID (16 bytes),
+  ///                 number of batches N (8 bytes)
+  ///     directory:  N times first ID, last ID, offset, and size of the
+  ///                 batch (8 bytes each)
+  ///     payload:    N serialized batches with their compressed events
+  ///
   class segment {
   public:
     using magic_type = uint32_t;
     using version_type = uint32_t;
 
     static inline constexpr magic_type magic = 0x2a2a2a2a;
-    static inline constexpr version_type version = 1;
-
+    static inline constexpr version_type version = 5;
+
+    /// Describes the location of a batch in the segment.
+    struct header {
+      event_id first;      ///< The ID of the first event.
+      event_id last;       ///< One past the ID of the last event.
+      uint64_t offset = 0; ///< The file offset of the serialized batch.
+      uint64_t size = 0;   ///< The number of bytes of the serialized batch.
+    };
+
+    /// Memory-maps a segment file.
+    /// @param filename The file to map.
+    /// @returns The segment backed by the contents of *filename*.
+    static expected<segment> open(const path& filename);
+
+    /// Writes the segment into a file.
+    /// @param filename The file to write to.
+    expected<void> write(const path& filename) const;
+
+    /// Appends a batch to the segment.
+    /// @param x The batch to append.
+    /// @pre The IDs of *x* must be greater than all IDs in the segment.
     void add(batch&& x);
 
+    /// Extracts events from the segment. Walks the ID set in lock-step with
+    /// the batch headers and decompresses only batches that contain IDs from
+    /// *xs*, taking *O(N + log M)* time for *N* bits in *xs* and *M* batches.
+    /// @param xs The IDs of the events to extract.
+    /// @returns The events from *xs* that the segment contains.
     expected<std::vector<event>> extract(const ids& xs) const;
 
     const uuid& id() const;
 
-    template <class Inspector>
-    friend auto inspect(Inspector& f, segment& x) {
-      return f(x.batches_, x.bytes_, x.id_);
-    }
-
     friend uint64_t bytes(const segment& x);
 
+    friend segment_store;
+
   private:
-    // TODO: use a vector & binary_search for O(1) append and O(log N) search.
-    std::map<event_id, batch> batches_;
+    /// Sorted by ID range, with `headers_[i]` describing the i-th batch.
+    std::vector<header> headers_;
+    /// The batches of an in-memory segment.
+    std::vector<batch> batches_;
+    /// The file contents of a memory-mapped segment.
+    chunk_ptr chunk_;
     uint64_t bytes_ = 0;
     uuid id_ = uuid::random();
   };
@@ -61,8 +105,33 @@ public:
   /// @param dir The directory where to store state.
   /// @param max_segment_size The maximum segment size in bytes.
   /// @param in_memory_segments The number of semgents to cache in memory.
+  /// @param layout The encoding of new batches.
   /// @pre `max_segment_size > 0`
-  segment_store(path dir, size_t max_segment_size, size_t in_memory_segments);
+  segment_store(path dir, size_t max_segment_size, size_t in_memory_segments,
+                batch::encoding layout = batch::encoding::row);
+
+  /// A sealed segment, which no longer accepts new batches.
+  using segment_ptr = std::shared_ptr<const segment>;
+
+  /// Persists a sealed segment in the background. The function must not
+  /// block and eventually report the outcome via ::persisted.
+  using writer = std::function<void(path filename, segment_ptr seg)>;
+
+  /// Installs a writer for sealed segments. Without a writer, the store
+  /// writes a full segment synchronously as part of ::put.
+  /// @param f The function that persists sealed segments.
+  void write_behind(writer f);
+
+  /// Completes the background write of a sealed segment. On success, the
+  /// store drops the in-memory copy of the segment and journals its meta
+  /// data. Until then, lookups read the sealed segment from memory.
+  /// @param id The ID of the sealed segment.
+  /// @param result The outcome of the write.
+  /// @returns No error on success.
+  expected<void> persisted(const uuid& id, expected<void> result);
+
+  /// @returns The number of sealed segments that await their write.
+  size_t sealed() const;
 
   expected<void> put(const std::vector<event>& xs) override;
 
@@ -71,10 +140,28 @@ public:
   expected<void> flush() override;
 
 private:
+  expected<void> seal();
+
+  /// Appends the ID ranges of a written segment to the meta data journal.
+  expected<void> record(const segment& s);
+
+  /// Replaces the meta data journal with a snapshot once it grows too long.
+  expected<void> compact();
+
+  /// Replaces the meta data journal with a snapshot of all written segments.
+  expected<void> write_snapshot();
+
+  /// Moves the meta data file of older versions into the journal.
+  expected<void> import_legacy_meta();
+
   path dir_;
   uint64_t max_segment_size_;
+  batch::encoding layout_;
   detail::range_map<event_id, uuid> segments_;
+  journal meta_;
   detail::cache<uuid, segment> cache_;
+  std::unordered_map<uuid, segment_ptr> sealed_;
+  writer writer_;
   segment active_;
 };
 
@@ -0,0 +1,93 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#ifndef VAST_SYNOPSIS_HPP
+#define VAST_SYNOPSIS_HPP
+
+#include <cstdint>
+
+#include "vast/bloom_filter.hpp"
+#include "vast/data.hpp"
+#include "vast/operator.hpp"
+#include "vast/type.hpp"
+
+#include "vast/detail/operators.hpp"
+
+namespace vast {
+
+/// A compact summary of the values of a single field. A synopsis answers the
+/// question whether a predicate *may* have hits among the summarized values.
+/// Depending on the type, a synopsis tracks the minimum and maximum value
+/// (arithmetic, temporal, and port types) or inserts the values into a Bloom
+/// filter (strings and addresses). Lookups are conservative: `false` means
+/// that no value can match, whereas `true` may be a false positive.
+class synopsis : detail::equality_comparable<synopsis> {
+public:
+  /// The probability of false positives that the Bloom filter of a synopsis
+  /// exhibits after summarizing as many values as its capacity.
+  static constexpr double bloom_filter_fp_rate = 0.01;
+
+  /// The summary technique.
+  enum class kind : uint8_t {
+    none,
+    range,
+    bloom
+  };
+
+  /// Constructs a synopsis that cannot rule out any predicate.
+  synopsis() = default;
+
+  /// Constructs a synopsis for a given type.
+  /// @param t The type of the values to summarize.
+  /// @param capacity The number of values to summarize, which determines the
+  ///                 size of the Bloom filter.
+  /// @pre `capacity > 0`
+  synopsis(const type& t, size_t capacity);
+
+  /// Checks whether a type has a meaningful synopsis representation.
+  /// @param t The type to check.
+  /// @returns `true` iff a synopsis for *t* can rule out predicates.
+  static bool supports(const type& t);
+
+  /// Adds a value to the synopsis. Ignores `nil`.
+  /// @param x The value to add.
+  void add(const data& x);
+
+  /// Checks whether a predicate may have hits among the summarized values.
+  /// @param op The relational operator of the predicate.
+  /// @param x The RHS of the predicate.
+  /// @returns `false` if no summarized value can fulfill *op x*.
+  bool lookup(relational_operator op, const data& x) const;
+
+  /// @returns An estimate of the number of bytes the synopsis occupies in
+  ///          memory.
+  size_t memusage() const;
+
+  friend bool operator==(const synopsis& x, const synopsis& y);
+
+  template <class Inspector>
+  friend auto inspect(Inspector& f, synopsis& x) {
+    return f(x.kind_, x.min_, x.max_, x.bloom_);
+  }
+
+private:
+  kind kind_ = kind::none;
+  data min_;
+  data max_;
+  bloom_filter bloom_;
+};
+
+} // namespace vast
+
+#endif
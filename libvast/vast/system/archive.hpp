@@ -20,7 +20,7 @@
 
 #include "vast/event.hpp"
 #include "vast/filesystem.hpp"
-#include "vast/store.hpp"
+#include "vast/segment_store.hpp"
 
 #include "vast/system/atoms.hpp"
 
@@ -28,7 +28,12 @@ namespace vast::system {
 
 /// @relates archive
 struct archive_state {
-  std::unique_ptr<vast::store> store;
+  std::unique_ptr<segment_store> store;
+  /// The I/O worker that writes sealed segments in the background.
+  caf::actor writer;
+  /// The number of sealed segments in flight after which the archive stops
+  /// processing new messages until the I/O worker catches up.
+  size_t max_sealed = 2;
   static inline const char* name = "archive";
 };
 
@@ -39,15 +44,18 @@ using archive_type = caf::typed_actor<
   caf::replies_to<ids>::with<std::vector<event>>
 >;
 
-/// Stores event batches and answers queries for ID sets.
+/// Stores event batches and answers queries for ID sets. A dedicated I/O
+/// worker writes full segments to the file system, while the archive keeps
+/// answering queries from memory.
 /// @param self The actor handle.
 /// @param dir The root directory of the archive.
 /// @param capacity The number of segments to cache in memory.
 /// @param max_segment_size The maximum segment size in bytes.
+/// @param layout The encoding of the batches in a segment.
 /// @pre `max_segment_size > 0`
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self, path dir,
-        size_t capacity, size_t max_segment_size);
+        size_t capacity, size_t max_segment_size, batch::encoding layout);
 
 } // namespace vast::system
 
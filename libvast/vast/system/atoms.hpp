@@ -55,6 +55,7 @@ using limit_atom = caf::atom_constant<caf::atom("limit")>;
 using link_atom = caf::atom_constant<caf::atom("link")>;
 using list_atom = caf::atom_constant<caf::atom("list")>;
 using load_atom = caf::atom_constant<caf::atom("load")>;
+using memory_atom = caf::atom_constant<caf::atom("memory")>;
 using peer_atom = caf::atom_constant<caf::atom("peer")>;
 using persist_atom = caf::atom_constant<caf::atom("persist")>;
 using ping_atom = caf::atom_constant<caf::atom("ping")>;
@@ -69,6 +70,7 @@ using request_atom = caf::atom_constant<caf::atom("request")>;
 using response_atom = caf::atom_constant<caf::atom("response")>;
 using run_atom = caf::atom_constant<caf::atom("run")>;
 using schema_atom = caf::atom_constant<caf::atom("schema")>;
+using seal_atom = caf::atom_constant<caf::atom("seal")>;
 using seed_atom = caf::atom_constant<caf::atom("seed")>;
 using set_atom = caf::atom_constant<caf::atom("set")>;
 using shutdown_atom = caf::atom_constant<caf::atom("shutdown")>;
@@ -14,17 +14,28 @@
 #ifndef VAST_INDEX_HPP
 #define VAST_INDEX_HPP
 
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <caf/actor.hpp>
 #include <caf/stateful_actor.hpp>
 
 #include "vast/expression.hpp"
 #include "vast/filesystem.hpp"
-#include "vast/uuid.hpp"
+#include "vast/journal.hpp"
+#include "vast/offset.hpp"
+#include "vast/synopsis.hpp"
 #include "vast/time.hpp"
+#include "vast/type.hpp"
+#include "vast/uuid.hpp"
 
 #include "vast/detail/flat_set.hpp"
+#include "vast/detail/work_stealing_pool.hpp"
+
+#include "vast/system/accountant.hpp"
 
 namespace vast {
 
@@ -41,15 +52,47 @@ public:
     timestamp to = timestamp::min();
   };
 
+  /// The synopses of all indexed fields of a type, keyed by field offset.
+  using type_synopsis = std::map<offset, synopsis>;
+
   /// Per-partition summary statistics.
   struct partition_synopsis {
+    /// The time interval of all events.
     interval range;
+
+    /// The types of all events along with the synopses of their fields.
+    std::unordered_map<type, type_synopsis> types;
   };
 
   /// Adds a set of events to the index for a given partition.
-  void add(const std::vector<event> xs, const uuid& partition);
-
-  /// Retrieves the list of partition IDs for a given expression.
+  /// @param xs The events to add.
+  /// @param partition The ID of the partition that holds *xs*.
+  /// @param capacity The maximum number of events of *partition*, which
+  ///                 determines the size of new synopses.
+  /// @returns The number of bytes that new synopses occupy in memory.
+  size_t add(const std::vector<event> xs, const uuid& partition,
+             size_t capacity);
+
+  /// Adds the summary of a partition, replacing an existing one.
+  /// @param partition The ID of the partition.
+  /// @param ps The summary of *partition*.
+  void add(const uuid& partition, partition_synopsis ps);
+
+  /// Retrieves the summary of a partition.
+  /// @param partition The ID of the partition.
+  /// @returns The summary of *partition* or `nullptr` if unknown.
+  const partition_synopsis* find(const uuid& partition) const;
+
+  /// @returns The number of indexed partitions.
+  size_t size() const;
+
+  /// @returns An estimate of the number of bytes the synopses of all
+  ///          partitions occupy in memory.
+  size_t memusage() const;
+
+  /// Retrieves the list of partition IDs for a given expression. A partition
+  /// qualifies if its time range overlaps with the expression and if the
+  /// synopses of at least one of its types cannot rule out the expression.
   std::vector<uuid> lookup(const expression& expr) const;
 
   template <class Inspector>
@@ -59,7 +102,7 @@ public:
 
   template <class Inspector>
   friend auto inspect(Inspector& f, partition_synopsis& ps) {
-    return f(ps.range);
+    return f(ps.range, ps.types);
   }
 
   template <class Inspector>
@@ -88,13 +131,44 @@ struct lookup_state {
   std::vector<uuid> partitions;
 };
 
+/// Counters describing the effectiveness of the in-memory partition cache.
+struct partition_cache_statistics {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  uint64_t prefetches = 0;
+};
+
 struct index_state {
   partition_index part_index;
+  /// Records the summaries of all partitions that have been filled.
+  journal meta;
   active_partition_state active;
   std::unordered_map<uuid, caf::actor> loaded;
+  /// Logical timestamps of the last access to each loaded partition.
+  std::unordered_map<uuid, uint64_t> last_access;
+  uint64_t clock = 0;
+  partition_cache_statistics stats;
+  /// The memory footprint of each partition in bytes.
+  std::unordered_map<caf::actor, uint64_t> memusage;
+  /// The sum of all partition footprints in bytes.
+  uint64_t memory = 0;
+  /// The footprint of the partition synopses in bytes, which counts against
+  /// the budget as well.
+  uint64_t synopsis_memory = 0;
+  /// Former active partitions that are shutting down. Their footprint no
+  /// longer counts against the budget.
+  std::unordered_set<caf::actor> retiring;
+  /// The memory budget in bytes; 0 means unlimited.
+  size_t max_memory = 0;
+  accountant_type accountant;
   std::unordered_map<caf::actor, uuid> evicted;
   std::deque<scheduled_partition_state> scheduled;
   std::unordered_map<uuid, lookup_state> lookups;
+  /// The threads that build and query the value indexes of all partitions.
+  std::shared_ptr<detail::work_stealing_pool> pool;
+  /// The budget of each passive partition for caching predicate hits.
+  size_t cache_size = 0;
   size_t capacity;
   path dir;
   static inline const char* name = "index";
@@ -105,10 +179,20 @@ struct index_state {
 /// @param max_events The maximum number of events per partition.
 /// @param max_parts The maximum number of partitions to hold in memory.
 /// @param taste_parts The number of partitions to schedule immediately for
-///                    each query
+///                    each query, and to prefetch ahead of subsequent
+///                    requests when there is room for more partitions.
+/// @param max_memory The number of bytes that the indexes and synopses of all
+///                   partitions may occupy in memory, or 0 for no limit.
+///                   Exceeding the budget evicts passive partitions first
+///                   and eventually rolls over the active partition.
+/// @param workers The number of threads for building and querying value
+///                indexes, or 0 for one per hardware thread.
+/// @param cache_size The number of bytes that each passive partition may
+///                   spend on caching the hits of predicates.
 /// @pre `max_events > 0 && max_parts > 0`
 caf::behavior index(caf::stateful_actor<index_state>* self, const path& dir,
-                    size_t max_events, size_t max_parts, size_t taste_parts);
+                    size_t max_events, size_t max_parts, size_t taste_parts,
+                    size_t max_memory, size_t workers, size_t cache_size);
 
 } // namespace system
 } // namespace vast
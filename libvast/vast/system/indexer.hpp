@@ -11,31 +11,98 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+
 #ifndef VAST_SYSTEM_INDEXER_HPP
 #define VAST_SYSTEM_INDEXER_HPP
 
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <caf/actor.hpp>
+#include <caf/response_promise.hpp>
 #include <caf/stateful_actor.hpp>
 
+#include "vast/bitmap.hpp"
+#include "vast/data.hpp"
+#include "vast/event.hpp"
 #include "vast/filesystem.hpp"
+#include "vast/offset.hpp"
 #include "vast/type.hpp"
 
+#include "vast/detail/work_stealing_pool.hpp"
+
 namespace vast::system {
 
+/// A value index that an event indexer operates on through tasks on a pool.
+struct column_index;
+
+/// @relates event_indexer_state
+using column_index_ptr = std::shared_ptr<column_index>;
+
+/// A lookup that awaits the results of one or more value indexes.
+struct pending_lookup {
+  caf::response_promise promise;
+  size_t remaining;
+  bitmap hits;
+};
+
 struct event_indexer_state {
   path dir;
   type event_type;
-  std::unordered_map<path, caf::actor> indexers;
+  /// All loaded value indexes, keyed by their file.
+  std::unordered_map<path, column_index_ptr> indexes;
+  column_index_ptr time_index;
+  column_index_ptr type_index;
+  /// The offsets of the fields in the event data, paired with the index
+  /// for the field. When indexing a non-record type, the only entry has an
+  /// empty offset.
+  std::vector<std::pair<offset, column_index_ptr>> columns;
+  std::unordered_map<uint64_t, pending_lookup> lookups;
+  uint64_t next_lookup = 0;
+  /// The number of value indexes that have yet to finish writing to disk.
+  size_t flushing = 0;
+  std::shared_ptr<detail::work_stealing_pool> pool;
+  caf::actor parent;
   static inline const char* name = "event-indexer";
 };
 
+/// A batch of events split into one column per index of an event indexer.
+struct shredded_batch {
+  /// The IDs of all events.
+  std::vector<event_id> ids;
+  /// The timestamps of all events.
+  std::vector<data> times;
+  /// The type names of all events.
+  std::vector<data> types;
+  /// The IDs of the events that contribute to the data columns.
+  std::vector<event_id> data_ids;
+  /// The values for the event data indexes, in the order of
+  /// `event_indexer_state::columns`.
+  std::vector<std::vector<data>> columns;
+};
+
+/// Splits a batch of events into columns in a single pass.
+/// @param st The state of the event indexer that receives the events.
+/// @param events The events to split.
+/// @returns The columns of *events*.
+/// @relates event_indexer_state
+shredded_batch shred(const event_indexer_state& st,
+                     const std::vector<event>& events);
+
 /// Indexes an event.
 /// @param self The actor handle.
 /// @param dir The directory where to store the indexes in.
 /// @param type event_type The type of the event to index.
+/// @param pool The threads that append to and look up the value indexes.
+/// @param parent The actor to notify about changes of the memory footprint
+///               of the indexes, or an invalid handle.
 caf::behavior event_indexer(caf::stateful_actor<event_indexer_state>* self,
-                            path dir, type event_type);
+                            path dir, type event_type,
+                            std::shared_ptr<detail::work_stealing_pool> pool,
+                            caf::actor parent);
 
 } // namespace vast::system
 
@@ -14,14 +14,21 @@
 #ifndef VAST_SYSTEM_PARTITION_HPP
 #define VAST_SYSTEM_PARTITION_HPP
 
+#include <memory>
 #include <unordered_map>
 
+#include <caf/actor.hpp>
 #include <caf/stateful_actor.hpp>
 
 #include "vast/aliases.hpp"
+#include "vast/expression.hpp"
 #include "vast/filesystem.hpp"
+#include "vast/ids.hpp"
 #include "vast/type.hpp"
 
+#include "vast/detail/cache.hpp"
+#include "vast/detail/work_stealing_pool.hpp"
+
 namespace vast::system {
 
 /// @relates partition
@@ -36,18 +43,60 @@ auto inspect(Inspector& f, partition_meta_data& x) {
   return f(x.types);
 }
 
+/// Remembers the hits of predicates in a partition that no longer receives
+/// events.
+/// @relates partition
+struct predicate_cache {
+  predicate_cache();
+
+  detail::cache<predicate, ids> entries;
+  /// The memory footprint of all cached hits in bytes.
+  size_t size = 0;
+  /// The maximum value of *size*; 0 disables the cache.
+  size_t capacity = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
 /// @relates partition
 struct partition_state {
   std::unordered_map<type, caf::actor> indexers;
   partition_meta_data meta_data;
+  /// The memory footprint of all loaded indexes in bytes.
+  size_t memusage = 0;
+  /// Whether this partition no longer receives events, either because it
+  /// existed on disk at startup or because the INDEX sealed it. Only frozen
+  /// partitions cache predicate hits.
+  bool frozen = false;
+  predicate_cache cache;
+  std::shared_ptr<detail::work_stealing_pool> pool;
+  caf::actor parent;
   static inline const char* name = "partition";
 };
 
+/// Selects the types whose indexers can produce hits for a predicate. A type
+/// qualifies only if the predicate resolves against it, e.g., because the
+/// type has the field of a key extractor.
+/// @param types The candidate types.
+/// @param pred The predicate to route.
+/// @returns The subset of *types* to route *pred* to.
+std::vector<type> route(const std::vector<type>& types, const predicate& pred);
+
 /// A horizontal partition of the INDEX.
 /// For each event batch, PARTITION spawns one event indexer per
-/// type occurring in the batch and forwards to them the events.
+/// type occurring in the batch and forwards to them the events. Upon
+/// receiving `seal_atom`, the partition expects no further events and
+/// starts caching predicate hits.
 /// @param dir The directory where to store this partition on the file system.
-caf::behavior partition(caf::stateful_actor<partition_state>* self, path dir);
+/// @param pool The threads on which the indexers build and query their value
+///             indexes.
+/// @param cache_size The number of bytes to spend on caching predicate hits
+///                   once the partition is frozen, or 0 to disable caching.
+/// @param parent The actor to notify about changes of the memory footprint
+///               of the partition, or an invalid handle.
+caf::behavior partition(caf::stateful_actor<partition_state>* self, path dir,
+                        std::shared_ptr<detail::work_stealing_pool> pool,
+                        size_t cache_size, caf::actor parent);
 
 } // namespace vast::system
 
@@ -16,7 +16,12 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <caf/meta/load_callback.hpp>
 
 #include "vast/ewah_bitmap.hpp"
 #include "vast/ids.hpp"
@@ -34,6 +39,11 @@
 
 namespace vast {
 
+/// The bitmap type of the bit slices of string and address indexes. Lookups
+/// intersect many of these slices, which tend to have medium density, so they
+/// follow the configured default bitmap type.
+using bitslice_bitmap = bitmap::default_bitmap;
+
 /// An index for a ::value that supports appending and looking up values.
 /// @warning A lookup result does *not include* `nil` values, regardless of the
 /// relational operator. Include them requires performing an OR of the result
@@ -59,6 +69,17 @@ public:
   /// @returns `true` if appending succeeded.
   expected<void> push_back(const data& x, event_id id);
 
+  /// Appends a sequence of data values at once. This has the same effect as
+  /// invoking `push_back(xs[i], event_ids[i])` for all *i*, but allows the
+  /// concrete index to encode all values in a single pass over each bitmap.
+  /// @param xs The data to append to the index.
+  /// @param event_ids The positional identifiers of *xs*.
+  /// @pre `xs.size() == event_ids.size()`
+  /// @returns An error if *event_ids* is not strictly increasing, begins
+  ///          before the current offset, or a value has the wrong type.
+  expected<void> append(const std::vector<data>& xs,
+                        const std::vector<event_id>& event_ids);
+
   /// Looks up data under a relational operator. If the value to look up is
   /// `nil`, only `==` and `!=` are valid operations. The concrete index
   /// type determines validity of other values.
@@ -67,6 +88,18 @@ public:
   /// @returns The result of the lookup or an error upon failure.
   expected<ids> lookup(relational_operator op, const data& x) const;
 
+  /// Looks up data under a relational operator, considering only a subset of
+  /// the IDs. The lookup does not touch the index at all if *restriction*
+  /// has no IDs in common with it. Otherwise it performs the full lookup and
+  /// intersects the result with *restriction* afterwards.
+  /// @param op The relation operator.
+  /// @param x The value to lookup.
+  /// @param restriction The IDs that may occur in the result.
+  /// @returns The result of the lookup intersected with *restriction*, or an
+  ///          error upon failure.
+  expected<ids> lookup(relational_operator op, const data& x,
+                       const ids& restriction) const;
+
   /// Merges another value index with this one.
   /// @param other The value index to merge.
   /// @returns `true` on success.
@@ -76,6 +109,10 @@ public:
   /// @returns The largest ID in the index.
   size_type offset() const;
 
+  /// Estimates the memory footprint of the index.
+  /// @returns The number of bytes the index occupies in memory.
+  size_t memusage() const;
+
   template <class Inspector>
   friend auto inspect(Inspector& f, value_index& vi) {
     return f(vi.mask_, vi.none_);
@@ -84,12 +121,22 @@ public:
 protected:
   value_index() = default;
 
+  /// A sequence of non-nil values, each paired with the number of entries to
+  /// skip before it.
+  using value_batch = std::vector<std::pair<const data*, size_type>>;
+
 private:
   virtual bool push_back_impl(const data& x, size_type skip) = 0;
 
+  /// Appends a sequence of values. The default implementation calls
+  /// `push_back_impl` for each value.
+  virtual bool append_impl(const value_batch& xs);
+
   virtual expected<ids>
   lookup_impl(relational_operator op, const data& x) const = 0;
 
+  virtual size_t memusage_impl() const = 0;
+
   size_type nils_ = 0;
   ewah_bitmap mask_;
   ewah_bitmap none_;
@@ -101,32 +148,32 @@ template <class Index>
 expected<ids> container_lookup(const Index& idx, relational_operator op,
                                const data& d) {
   auto lookup = [&](auto& xs) -> expected<ids> {
-    ids result;
-    if (op == in) {
-      result = bitmap{idx.offset(), false};
-      for (auto& x : xs) {
-        auto r = idx.lookup(equal, x);
-        if (r)
-          result |= *r;
-        else
-          return r;
-        if (all<1>(result)) // short-circuit
-          return result;
-      }
-    } else if (op == not_in) {
-      result = bitmap{idx.offset(), true};
-      for (auto& x : xs) {
-        auto r = idx.lookup(equal, x);
-        if (r)
-          result -= *r;
-        else
-          return r;
-        if (all<0>(result)) // short-circuit
-          return result;
-      }
-    } else {
+    if (op != in && op != not_in)
       return make_error(ec::unsupported_operator, op);
+    // Combine the hits of several elements at once rather than growing one
+    // result per element, but stop as soon as the hits cover all IDs.
+    constexpr size_t batch_size = 16;
+    ids result = bitmap{idx.offset(), false};
+    std::vector<ids> hits;
+    hits.reserve(batch_size + 1);
+    auto merge = [&] {
+      hits.push_back(std::move(result));
+      result = nary_or(hits);
+      hits.clear();
+      return all<1>(result);
+    };
+    for (auto& x : xs) {
+      auto r = idx.lookup(equal, x);
+      if (!r)
+        return r;
+      hits.push_back(std::move(*r));
+      if (hits.size() == batch_size && merge()) // short-circuit
+        break;
     }
+    if (!hits.empty())
+      merge();
+    if (op == not_in)
+      result.flip();
     return result;
   };
   return visit(overload(
@@ -197,22 +244,41 @@ public:
   }
 
 private:
-  bool push_back_impl(const data& d, size_type skip) override {
-    auto append = [&](auto x) {
-      bmi_.push_back(x, skip);
+  // Invokes a function with the representation of data in the bitmap index.
+  template <class F>
+  static bool with_value(const data& d, F f) {
+    auto apply = [&](auto x) {
+      f(x);
       return true;
     };
     return visit(detail::overload(
       [&](auto&&) { return false; },
-      [&](boolean x) { return append(x); },
-      [&](integer x) { return append(x); },
-      [&](count x) { return append(x); },
-      [&](real x) { return append(x); },
-      [&](timespan x) { return append(x.count()); },
-      [&](timestamp x) { return append(x.time_since_epoch().count()); }
+      [&](boolean x) { return apply(x); },
+      [&](integer x) { return apply(x); },
+      [&](count x) { return apply(x); },
+      [&](real x) { return apply(x); },
+      [&](timespan x) { return apply(x.count()); },
+      [&](timestamp x) { return apply(x.time_since_epoch().count()); }
     ), d);
   }
 
+  bool push_back_impl(const data& d, size_type skip) override {
+    return with_value(d, [&](auto x) { bmi_.push_back(x, skip); });
+  }
+
+  bool append_impl(const value_batch& xs) override {
+    std::vector<std::pair<value_type, size_type>> values;
+    values.reserve(xs.size());
+    for (auto& x : xs) {
+      auto skip = x.second;
+      auto add = [&](auto y) { values.emplace_back(y, skip); };
+      if (!with_value(*x.first, add))
+        return false;
+    }
+    bmi_.append_batch(values.begin(), values.end());
+    return true;
+  }
+
   expected<ids>
   lookup_impl(relational_operator op, const data& d) const override {
     return visit(detail::overload(
@@ -232,6 +298,10 @@ private:
     ), d);
   };
 
+  size_t memusage_impl() const override {
+    return bmi_.memusage();
+  }
+
   bitmap_index_type bmi_;
 };
 
@@ -241,16 +311,26 @@ public:
   /// Constructs a string index.
   /// @param max_length The maximum string length to support. Longer strings
   ///                   will be chopped to this size.
-  explicit string_index(size_t max_length = 1024);
+  /// @param trigrams Whether to maintain an inverted index from the trigrams
+  ///                 of each string to the string IDs, which speeds up
+  ///                 substring lookups. For substrings longer than three
+  ///                 characters, the trigrams may occur in different places
+  ///                 of a string, so that lookups yield only candidates.
+  explicit string_index(size_t max_length = 1024, bool trigrams = false);
 
   template <class Inspector>
   friend auto inspect(Inspector& f, string_index& idx) {
-    return f(static_cast<value_index&>(idx), idx.length_, idx.chars_);
+    return f(static_cast<value_index&>(idx), idx.length_, idx.chars_,
+             idx.trigrams_, idx.postings_);
   }
 
 private:
+  /// Three consecutive characters packed into an integer.
+  using trigram = uint32_t;
+
   /// The index which holds each character.
-  using char_bitmap_index = bitmap_index<uint8_t, bitslice_coder<ewah_bitmap>>;
+  using char_bitmap_index =
+    bitmap_index<uint8_t, bitslice_coder<bitslice_bitmap>>;
 
   /// The index which holds the string length.
   using length_bitmap_index =
@@ -260,19 +340,92 @@ private:
 
   bool push_back_impl(const data& x, size_type skip) override;
 
+  bool append_impl(const value_batch& xs) override;
+
   expected<ids>
   lookup_impl(relational_operator op, const data& x) const override;
 
+  size_t memusage_impl() const override;
+
+  // Records the trigrams of a string at a given position.
+  void add_trigrams(const std::string& str, size_type pos);
+
+  // Looks up the strings that contain all trigrams of a substring of at
+  // least three characters, a superset of the strings containing it.
+  ids lookup_trigrams(const std::string& str) const;
+
+  // Looks up the candidates for a pattern from the literals it requires.
+  expected<ids> lookup_pattern(relational_operator op,
+                               const pattern& pat) const;
+
   size_t max_length_;
   length_bitmap_index length_;
   std::vector<char_bitmap_index> chars_;
+  bool trigrams_;
+  std::unordered_map<trigram, ewah_bitmap> postings_;
+};
+
+/// An index for strings with few distinct values. It assigns each distinct
+/// string a dense ID and maintains one bitmap per ID, so that an equality
+/// lookup touches a single bitmap. Once the number of distinct values exceeds
+/// a limit, the index replays its contents into a ::string_index and
+/// delegates all further operations to it.
+class dictionary_index : public value_index {
+public:
+  /// Constructs a dictionary index.
+  /// @param max_length The maximum string length to support. Longer strings
+  ///                   will be chopped to this size.
+  /// @param max_cardinality The number of distinct values after which the
+  ///                        index switches to positional encoding.
+  explicit dictionary_index(size_t max_length = 1024,
+                            size_t max_cardinality = 10000);
+
+  /// @returns The number of distinct values, or 0 if the index switched to
+  ///          positional encoding.
+  size_t cardinality() const;
+
+  /// @returns `true` if the index switched to positional encoding.
+  bool positional() const;
+
+  template <class Inspector>
+  friend auto inspect(Inspector& f, dictionary_index& idx) {
+    auto load = [&]() -> error {
+      idx.dictionary_.clear();
+      for (auto i = 0u; i < idx.strings_.size(); ++i)
+        idx.dictionary_.emplace(idx.strings_[i], i);
+      return {};
+    };
+    return f(static_cast<value_index&>(idx), idx.max_length_,
+             idx.max_cardinality_, idx.size_, idx.strings_, idx.postings_,
+             idx.positional_, idx.fallback_, caf::meta::load_callback(load));
+  }
+
+private:
+  bool push_back_impl(const data& x, size_type skip) override;
+
+  expected<ids>
+  lookup_impl(relational_operator op, const data& x) const override;
+
+  size_t memusage_impl() const override;
+
+  // Moves all values into the positional index.
+  bool migrate();
+
+  size_t max_length_;
+  size_t max_cardinality_;
+  size_type size_ = 0;
+  std::vector<std::string> strings_;
+  std::vector<ewah_bitmap> postings_;
+  std::unordered_map<std::string, uint32_t> dictionary_;
+  bool positional_ = false;
+  string_index fallback_;
 };
 
 /// An index for IP addresses.
 class address_index : public value_index {
 public:
-  using byte_index = bitmap_index<uint8_t, bitslice_coder<ewah_bitmap>>;
-  using type_index = bitmap_index<bool, singleton_coder<ewah_bitmap>>;
+  using byte_index = bitmap_index<uint8_t, bitslice_coder<bitslice_bitmap>>;
+  using type_index = bitmap_index<bool, singleton_coder<bitslice_bitmap>>;
 
   address_index() = default;
 
@@ -289,6 +442,8 @@ private:
   expected<ids>
   lookup_impl(relational_operator op, const data& x) const override;
 
+  size_t memusage_impl() const override;
+
   std::array<byte_index, 16> bytes_;
   type_index v4_;
 };
@@ -313,6 +468,8 @@ private:
   expected<ids>
   lookup_impl(relational_operator op, const data& x) const override;
 
+  size_t memusage_impl() const override;
+
   address_index network_;
   prefix_index length_;
 };
@@ -344,9 +501,13 @@ private:
 
   bool push_back_impl(const data& x, size_type skip) override;
 
+  bool append_impl(const value_batch& xs) override;
+
   expected<ids>
   lookup_impl(relational_operator op, const data& x) const override;
 
+  size_t memusage_impl() const override;
+
   number_index num_;
   protocol_index proto_;
 };
@@ -397,6 +558,8 @@ private:
   expected<ids>
   lookup_impl(relational_operator op, const data& x) const override;
 
+  size_t memusage_impl() const override;
+
   std::vector<std::unique_ptr<value_index>> elements_;
   size_bitmap_index size_;
   size_t max_size_;
@@ -405,6 +568,12 @@ private:
 
 namespace detail {
 
+/// Decides whether strings of a given type go into a ::string_index instead
+/// of a ::dictionary_index.
+/// @param t The string type.
+/// @returns `true` if *t* requires a ::string_index.
+bool uses_string_index(const string_type& t);
+
 struct value_index_inspect_helper {
   const vast::type& type;
   std::unique_ptr<value_index>& idx;
@@ -446,8 +615,10 @@ struct value_index_inspect_helper {
       return f_(static_cast<arithmetic_index<timestamp>&>(idx_));
     }
 
-    result_type operator()(const string_type&) const {
-      return f_(static_cast<string_index&>(idx_));
+    result_type operator()(const string_type& t) const {
+      if (uses_string_index(t))
+        return f_(static_cast<string_index&>(idx_));
+      return f_(static_cast<dictionary_index&>(idx_));
     }
 
     result_type operator()(const address_type&) const {
@@ -510,8 +681,10 @@ struct value_index_inspect_helper {
       return std::make_unique<arithmetic_index<timestamp>>();
     }
 
-    result_type operator()(const string_type&) const {
-      return std::make_unique<string_index>();
+    result_type operator()(const string_type& t) const {
+      if (uses_string_index(t))
+        return std::make_unique<string_index>();
+      return std::make_unique<dictionary_index>();
     }
 
     result_type operator()(const address_type&) const {
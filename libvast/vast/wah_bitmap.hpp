@@ -94,6 +94,10 @@ public:
 
   size_type size() const;
 
+  /// @returns An estimate of the number of bytes the bitmap occupies in
+  ///          memory.
+  size_t memusage() const;
+
   const block_vector& blocks() const;
 
   // -- modifiers ------------------------------------------------------------
@@ -0,0 +1,135 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <caf/all.hpp>
+
+#include "vast/bitmap.hpp"
+#include "vast/bitmap_algorithms.hpp"
+
+#include "vast/detail/block_kernels.hpp"
+
+using namespace caf;
+using namespace std::chrono;
+using namespace vast;
+
+namespace {
+
+// Generates an EWAH bitmap of alternating clean runs and dirty runs, where
+// *density* is the probability of a 1 in a dirty run and *clean* is the
+// fraction of bits in clean runs.
+ewah_bitmap generate(std::mt19937_64& gen, size_t size, double density,
+                     double clean) {
+  std::bernoulli_distribution bit{density};
+  std::bernoulli_distribution run{clean};
+  std::uniform_int_distribution<size_t> length{64, 64 * 64};
+  ewah_bitmap result;
+  while (result.size() < size) {
+    auto n = std::min(length(gen), size - result.size());
+    if (run(gen))
+      result.append_bits(bit(gen), n);
+    else
+      for (auto i = 0u; i < n; ++i)
+        result.append_bit(bit(gen));
+  }
+  return result;
+}
+
+// Runs a function repeatedly and returns the average time per run.
+template <class F>
+double measure(size_t repetitions, F f) {
+  auto start = steady_clock::now();
+  for (auto i = 0u; i < repetitions; ++i)
+    f();
+  auto elapsed = duration_cast<duration<double, std::micro>>(
+    steady_clock::now() - start);
+  return elapsed.count() / repetitions;
+}
+
+void report(const std::string& name, double generic, double specialized) {
+  std::cout << name << ": " << generic << " us -> " << specialized << " us ("
+            << generic / specialized << "x)" << std::endl;
+}
+
+} // namespace <anonymous>
+
+// Compares the generic bitmap algorithms against the specialized EWAH
+// algorithms on bitmaps that consist mostly of dirty blocks.
+int main(int argc, char** argv) {
+  size_t size = 1 << 24;
+  size_t bitmaps = 16;
+  size_t repetitions = 10;
+  double density = 0.5;
+  double clean = 0.1;
+  auto r = message_builder{argv + 1, argv + argc}.extract_opts({
+    {"size,s", "number of bits per bitmap", size},
+    {"bitmaps,b", "number of bitmaps for n-ary OR", bitmaps},
+    {"repetitions,r", "number of runs per measurement", repetitions},
+    {"density,d", "probability of a 1 in dirty runs", density},
+    {"clean,c", "fraction of clean runs", clean}
+  });
+  if (!r.error.empty() || r.opts.count("help") > 0 || !r.remainder.empty()) {
+    std::cerr << r.error << "\n\n" << r.helptext;
+    return 1;
+  }
+  std::cerr << "generating " << bitmaps << " bitmaps of " << size << " bits"
+            << std::endl;
+  std::mt19937_64 gen{42};
+  std::vector<ewah_bitmap> xs;
+  for (auto i = 0u; i < std::max(bitmaps, size_t{2}); ++i)
+    xs.push_back(generate(gen, size, density, clean));
+  auto& x = xs[0];
+  auto& y = xs[1];
+  std::cout << "kernels: " << detail::block_kernels_isa() << std::endl;
+  // Prevents the compiler from discarding the results.
+  size_t sink = 0;
+  auto generic = [&](auto op, auto fill_lhs, auto fill_rhs) {
+    return measure(repetitions, [&] {
+      auto result = binary_eval<decltype(fill_lhs)::value,
+                                decltype(fill_rhs)::value>(x, y, op);
+      sink += result.size();
+    });
+  };
+  auto specialized = [&](auto f) {
+    return measure(repetitions, [&] { sink += f(x, y).size(); });
+  };
+  std::true_type yes;
+  std::false_type no;
+  report("and", generic(detail::and_op{}, no, no),
+         specialized([](auto& l, auto& r) { return l & r; }));
+  report("or", generic(detail::or_op{}, yes, yes),
+         specialized([](auto& l, auto& r) { return l | r; }));
+  report("xor", generic(detail::xor_op{}, yes, yes),
+         specialized([](auto& l, auto& r) { return l ^ r; }));
+  report("nand", generic(detail::nand_op{}, yes, no),
+         specialized([](auto& l, auto& r) { return l - r; }));
+  report("rank",
+         measure(repetitions, [&] { sink += rank<true>(x, size - 1); }),
+         measure(repetitions, [&] { sink += rank(x); }));
+  std::vector<bitmap> ys(xs.begin(), xs.end());
+  report("n-ary or",
+         measure(repetitions, [&] {
+           auto result = ys.front();
+           for (auto i = 1u; i < ys.size(); ++i)
+             result = binary_eval<true, true>(result, ys[i], detail::or_op{});
+           sink += result.size();
+         }),
+         measure(repetitions, [&] { sink += nary_or(ys).size(); }));
+  return sink > 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <caf/all.hpp>
+
+#include "vast/event.hpp"
+#include "vast/filesystem.hpp"
+#include "vast/type.hpp"
+
+#include "vast/system/atoms.hpp"
+#include "vast/system/indexer.hpp"
+
+using namespace caf;
+using namespace std::chrono;
+using namespace vast;
+
+// Measures the rate at which an event indexer ingests events of a record type
+// with many fields, including the final flush of all indexes to disk.
+int main(int argc, char** argv) {
+  size_t fields = 40;
+  size_t events = 10000;
+  size_t batches = 10;
+  size_t workers = 0;
+  std::string dir = "bench-ingest";
+  auto r = message_builder{argv + 1, argv + argc}.extract_opts({
+    {"fields,f", "number of fields per event", fields},
+    {"events,e", "number of events per batch", events},
+    {"batches,b", "number of batches", batches},
+    {"workers,w", "indexing threads (0 = all cores)", workers},
+    {"directory,d", "scratch directory for the indexes", dir}
+  });
+  if (!r.error.empty() || r.opts.count("help") > 0 || !r.remainder.empty()) {
+    std::cerr << r.error << "\n\n" << r.helptext;
+    return 1;
+  }
+  // Generate a wide record type that cycles through a few value types.
+  std::vector<record_field> xs;
+  for (auto i = 0u; i < fields; ++i) {
+    auto name = "f" + std::to_string(i);
+    switch (i % 3) {
+      case 0:
+        xs.emplace_back(name, count_type{});
+        break;
+      case 1:
+        xs.emplace_back(name, integer_type{});
+        break;
+      default:
+        xs.emplace_back(name, string_type{});
+    }
+  }
+  auto t = type{record_type{std::move(xs)}}.name("bench");
+  std::cerr << "generating " << batches << " batches of " << events
+            << " events with " << fields << " fields" << std::endl;
+  std::vector<std::vector<event>> input(batches);
+  auto id = event_id{0};
+  for (auto& batch : input) {
+    batch.reserve(events);
+    for (auto i = 0u; i < events; ++i, ++id) {
+      vector v;
+      v.reserve(fields);
+      for (auto j = 0u; j < fields; ++j)
+        switch (j % 3) {
+          case 0:
+            v.emplace_back(count{id % 1000});
+            break;
+          case 1:
+            v.emplace_back(integer(id % 7) - 3);
+            break;
+          default:
+            v.emplace_back("s" + std::to_string(id % 100));
+        }
+      batch.push_back(event::make(std::move(v), t));
+      batch.back().id(id);
+      batch.back().timestamp(timestamp{} + seconds(id));
+    }
+  }
+  auto p = path{dir};
+  if (exists(p) && !rm(p)) {
+    std::cerr << "failed to remove " << p.str() << std::endl;
+    return 1;
+  }
+  actor_system_config cfg;
+  actor_system sys{cfg};
+  scoped_actor self{sys};
+  auto start = steady_clock::now();
+  auto pool = std::make_shared<detail::work_stealing_pool>(workers);
+  auto indexer = self->spawn(system::event_indexer, p, t, pool, actor{});
+  for (auto& batch : input)
+    self->send(indexer, std::move(batch));
+  self->send(indexer, system::shutdown_atom::value);
+  self->wait_for(indexer);
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start);
+  auto total = batches * events;
+  auto rate = static_cast<size_t>(total / elapsed.count());
+  std::cout << total << " events in " << elapsed.count() << " s (" << rate
+            << " events/s)" << std::endl;
+  rm(p);
+}
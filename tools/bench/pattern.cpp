@@ -0,0 +1,125 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <caf/all.hpp>
+
+#include "vast/pattern.hpp"
+
+using namespace caf;
+using namespace std::chrono;
+using namespace vast;
+
+namespace {
+
+// Extracts a column from a Bro log.
+std::vector<std::string> read_column(std::istream& in,
+                                     const std::string& name) {
+  std::vector<std::string> result;
+  auto column = size_t{0};
+  auto found = false;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields;
+    size_t i = 0;
+    size_t j;
+    while ((j = line.find('\t', i)) != std::string::npos) {
+      fields.push_back(line.substr(i, j - i));
+      i = j + 1;
+    }
+    fields.push_back(line.substr(i));
+    if (fields[0] == "#fields") {
+      for (auto k = 1u; k < fields.size(); ++k)
+        if (fields[k] == name) {
+          column = k - 1;
+          found = true;
+        }
+    } else if (found && !line.empty() && line[0] != '#'
+               && column < fields.size()) {
+      result.push_back(std::move(fields[column]));
+    }
+  }
+  return result;
+}
+
+// Runs a function repeatedly and returns the average time per run.
+template <class F>
+double measure(size_t repetitions, F f) {
+  auto start = steady_clock::now();
+  for (auto i = 0u; i < repetitions; ++i)
+    f();
+  auto elapsed = duration_cast<duration<double, std::micro>>(
+    steady_clock::now() - start);
+  return elapsed.count() / repetitions;
+}
+
+} // namespace <anonymous>
+
+// Compares searching patterns in the URIs of a Bro HTTP log with a freshly
+// constructed regex per string against the precompiled matcher of a pattern.
+int main(int argc, char** argv) {
+  std::string input = "http.log";
+  std::string column = "uri";
+  size_t repetitions = 10;
+  auto r = message_builder{argv + 1, argv + argc}.extract_opts({
+    {"input,i", "path to a Bro HTTP log", input},
+    {"column,c", "name of the column to match", column},
+    {"repetitions,r", "number of runs per measurement", repetitions}
+  });
+  if (!r.error.empty() || r.opts.count("help") > 0 || !r.remainder.empty()) {
+    std::cerr << r.error << "\n\n" << r.helptext;
+    return 1;
+  }
+  std::ifstream in{input};
+  if (!in) {
+    std::cerr << "failed to open " << input << std::endl;
+    return 1;
+  }
+  auto xs = read_column(in, column);
+  if (xs.empty()) {
+    std::cerr << "no values in column " << column << std::endl;
+    return 1;
+  }
+  std::cerr << "matching " << xs.size() << " values" << std::endl;
+  std::vector<std::pair<std::string, pattern>> patterns{
+    {"literal", pattern{"/"}},
+    {"prefix", pattern{"^/images/"}},
+    {"suffix", pattern{"\\.js$"}},
+    {"substring", pattern{"google"}},
+    {"glob", pattern::glob("/*/*.gif")},
+    {"regex", pattern{"/[a-z]+/[0-9]+\\.(html|php)"}}
+  };
+  // Prevents the compiler from discarding the results.
+  size_t sink = 0;
+  for (auto& [name, p] : patterns) {
+    auto& rx = p.string();
+    auto uncached = measure(repetitions, [&] {
+      for (auto& x : xs)
+        sink += std::regex_search(x.begin(), x.end(), std::regex{rx});
+    });
+    auto cached = measure(repetitions, [&] {
+      for (auto& x : xs)
+        sink += p.search(x);
+    });
+    std::cout << name << ": " << uncached << " us -> " << cached << " us ("
+              << uncached / cached << "x)" << std::endl;
+  }
+  return sink > 0 ? 0 : 1;
+}